@@ -0,0 +1,148 @@
+//
+//  main.cpp
+//  AudioRenderer
+//
+//  Runs a ROM or NSF headlessly, as fast as possible, and writes the APU's
+//  output to a WAV file. No audio device is opened.
+//
+//  Usage: AudioRenderer --rom <file> [--movie <file>] [--frames <n>]
+//                       [--sample-rate <hz>] <output.wav>
+//         AudioRenderer --nsf <file> [--song <n>] --frames <n>
+//                       [--sample-rate <hz>] <output.wav>
+//
+//  Without --frames, a movie is rendered to its end. NSF frames are calls
+//  to the play routine.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "APU.h"
+#include "Emulator.h"
+#include "NsfPlayer.h"
+#include "WavWriter.h"
+
+static void print_speed(long frames, uint64_t samples, int sample_rate,
+                        double elapsed) {
+  double emulated = static_cast<double>(samples) / sample_rate;
+  printf("%ld frames, %.2fs of audio (%llu samples) in %.2fs: %.1fx real "
+         "time\n",
+         frames, emulated, static_cast<unsigned long long>(samples), elapsed,
+         elapsed > 0 ? emulated / elapsed : 0);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static void render_nsf(std::string filename, int song, long frames,
+                       int sample_rate, std::string output) {
+  NsfPlayer player(filename);
+  player.set_audio_sample_rate(sample_rate);
+  if (song > 0) {
+    player.start_song(song);
+  }
+
+  const NsfHeader& header = player.get_header();
+  printf("%s - %s, song %d of %d\n", header.name.c_str(),
+         header.artist.c_str(), player.get_song(), header.songs);
+
+  WavWriter wav(output, sample_rate);
+
+  auto start = std::chrono::steady_clock::now();
+  for (long frame = 0; frame < frames; frame++) {
+    player.play_frame();
+    const std::vector<int16_t>& samples = player.get_audio_samples();
+    wav.write(samples.data(), samples.size());
+  }
+  wav.close();
+
+  print_speed(frames, wav.get_samples_written(), sample_rate,
+              seconds_since(start));
+}
+
+int main(int argc, const char* argv[]) {
+  std::string rom, nsf, movie, output;
+  long frames = -1;
+  int song = 0;
+  int sample_rate = APU::kDefaultSampleRate;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--rom") && has_value) {
+      rom = argv[++i];
+    } else if (!strcmp(argv[i], "--nsf") && has_value) {
+      nsf = argv[++i];
+    } else if (!strcmp(argv[i], "--song") && has_value) {
+      song = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--movie") && has_value) {
+      movie = argv[++i];
+    } else if (!strcmp(argv[i], "--frames") && has_value) {
+      frames = atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--sample-rate") && has_value) {
+      sample_rate = atoi(argv[++i]);
+    } else if (argv[i][0] == '-' || !output.empty()) {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    } else {
+      output = argv[i];
+    }
+  }
+
+  bool valid_source =
+      nsf.empty() ? !rom.empty() && (frames >= 0 || !movie.empty())
+                  : rom.empty() && frames >= 0;
+  if (!valid_source || output.empty() || sample_rate <= 0 ||
+      sample_rate > APU::kMaxSampleRate) {
+    std::cerr << "Usage: AudioRenderer --rom <file> [--movie <file>] "
+                 "[--frames <n>] [--sample-rate <hz>] <output.wav>\n"
+                 "       AudioRenderer --nsf <file> [--song <n>] --frames <n> "
+                 "[--sample-rate <hz>] <output.wav>\n"
+                 "Sample rates go up to "
+              << APU::kMaxSampleRate << " Hz." << std::endl;
+    return 1;
+  }
+
+  try {
+    if (!nsf.empty()) {
+      render_nsf(nsf, song, frames, sample_rate, output);
+      return 0;
+    }
+
+    Emulator emulator(true);
+    emulator.load_rom(rom);
+    emulator.set_audio_sample_rate(sample_rate);
+    if (!movie.empty()) {
+      emulator.start_playback(movie);
+    }
+
+    WavWriter wav(output, sample_rate);
+
+    auto start = std::chrono::steady_clock::now();
+    long frame = 0;
+    for (; frames < 0 || frame < frames; frame++) {
+      if (frames < 0 && !emulator.is_playing_movie()) {
+        break;
+      }
+
+      emulator.emulate_frame();
+      const std::vector<int16_t>& samples = emulator.get_audio_samples();
+      wav.write(samples.data(), samples.size());
+    }
+    wav.close();
+
+    print_speed(frame, wav.get_samples_written(), sample_rate,
+                seconds_since(start));
+  } catch (const char* error) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
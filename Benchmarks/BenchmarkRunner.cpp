@@ -0,0 +1,133 @@
+//
+//  BenchmarkRunner.cpp
+//  EmulatorBenchmarks
+//
+
+#include "BenchmarkRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+typedef std::chrono::steady_clock Clock;
+
+static const double kMinSampleSeconds = 0.01;
+static const long kMaxIterations = 1L << 30;
+
+static double seconds_for(const std::function<void(long)>& body,
+                          long iterations) {
+  Clock::time_point start = Clock::now();
+  body(iterations);
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+BenchmarkRunner::BenchmarkRunner(std::string filter, int sample_count)
+    : filter(filter), sample_count(sample_count) {}
+
+// Find an iteration count that makes one sample last at least
+// kMinSampleSeconds, so timer resolution doesn't dominate.
+long BenchmarkRunner::calibrate(const std::function<void(long)>& body) {
+  long iterations = 1;
+
+  while (iterations < kMaxIterations) {
+    double seconds = seconds_for(body, iterations);
+    if (seconds >= kMinSampleSeconds) {
+      break;
+    }
+
+    // Grow towards the target, but never by more than 10x at a time
+    double scale = seconds > 0 ? kMinSampleSeconds * 1.2 / seconds : 10;
+    iterations =
+        static_cast<long>(iterations * std::min(10.0, std::max(scale, 2.0)));
+  }
+
+  return iterations;
+}
+
+void BenchmarkRunner::run(std::string name,
+                          std::function<void(long iterations)> body) {
+  if (name.find(filter) == std::string::npos) {
+    return;
+  }
+
+  BenchmarkResult result;
+  result.name = name;
+  result.iterations = calibrate(body);
+
+  for (int i = 0; i < sample_count; i++) {
+    double seconds = seconds_for(body, result.iterations);
+    result.samples.push_back(seconds * 1e9 / result.iterations);
+  }
+
+  std::vector<double> sorted = result.samples;
+  std::sort(sorted.begin(), sorted.end());
+
+  double sum = 0;
+  for (double sample : sorted) {
+    sum += sample;
+  }
+  result.mean = sum / sorted.size();
+
+  double squares = 0;
+  for (double sample : sorted) {
+    squares += (sample - result.mean) * (sample - result.mean);
+  }
+  result.stddev =
+      sorted.size() > 1 ? std::sqrt(squares / (sorted.size() - 1)) : 0;
+  result.min = sorted.front();
+  result.median = sorted.size() % 2
+                      ? sorted[sorted.size() / 2]
+                      : (sorted[sorted.size() / 2 - 1] +
+                         sorted[sorted.size() / 2]) / 2;
+
+  char line[160];
+  snprintf(line, sizeof(line), "%-44s %12.2f ns/op  +/- %6.2f%%  (min %.2f)",
+           name.c_str(), result.mean,
+           result.mean > 0 ? result.stddev * 100 / result.mean : 0,
+           result.min);
+  std::cout << line << std::endl;
+
+  results.push_back(result);
+}
+
+void BenchmarkRunner::print_summary() {
+  std::cout << std::endl
+            << results.size() << " benchmarks, " << sample_count
+            << " samples each" << std::endl;
+}
+
+void BenchmarkRunner::write_json(std::string filename) {
+  std::ofstream file(filename, std::ios::out | std::ios::trunc);
+
+  if (!file.is_open()) {
+    throw "Could not open benchmark output for writing.";
+  }
+
+  file << "{\n  \"timestamp\": " << std::time(nullptr) << ",\n"
+       << "  \"unit\": \"ns/op\",\n"
+       << "  \"benchmarks\": [\n";
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& result = results[i];
+
+    file << "    {\"name\": \"" << result.name << "\", "
+         << "\"iterations\": " << result.iterations << ", "
+         << "\"mean\": " << result.mean << ", "
+         << "\"stddev\": " << result.stddev << ", "
+         << "\"min\": " << result.min << ", "
+         << "\"median\": " << result.median << ", "
+         << "\"samples\": [";
+
+    for (size_t j = 0; j < result.samples.size(); j++) {
+      file << (j ? ", " : "") << result.samples[j];
+    }
+
+    file << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+
+  file << "  ]\n}\n";
+}
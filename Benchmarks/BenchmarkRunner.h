@@ -0,0 +1,45 @@
+//
+//  BenchmarkRunner.h
+//  EmulatorBenchmarks
+//
+//  Times small benchmark bodies and reports nanoseconds per operation.
+//
+
+#ifndef __EmulatorBenchmarks__BenchmarkRunner__
+#define __EmulatorBenchmarks__BenchmarkRunner__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+  std::string name;
+  long iterations;  // Operations per sample
+  std::vector<double> samples;  // ns/op of each sample
+
+  double mean;
+  double stddev;
+  double min;
+  double median;
+};
+
+class BenchmarkRunner {
+ private:
+  std::string filter;
+  int sample_count;
+  std::vector<BenchmarkResult> results;
+
+  long calibrate(const std::function<void(long)>& body);
+
+ public:
+  BenchmarkRunner(std::string filter, int sample_count);
+
+  // Runs body(iterations) repeatedly; body must perform `iterations`
+  // operations. Benchmarks whose name doesn't contain the filter are skipped.
+  void run(std::string name, std::function<void(long iterations)> body);
+
+  void print_summary();
+  void write_json(std::string filename);
+};
+
+#endif /* defined(__EmulatorBenchmarks__BenchmarkRunner__) */
@@ -0,0 +1,377 @@
+//
+//  main.cpp
+//  EmulatorBenchmarks
+//
+//  Microbenchmarks for the CPU, PPU and bus hot paths.
+//
+//  Usage: EmulatorBenchmarks [--filter <substring>] [--samples <n>]
+//                            [--json <output file>] [--rom <file>]
+//                            [--movie <file>]
+//
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BenchmarkRunner.h"
+#include "ControllerPad.h"
+#include "Debugger.h"
+#include "Emulator.h"
+#include "GuestProfiler.h"
+#include "PPU.h"
+#include "Processor.h"
+#include "defines.h"
+
+static const int kPRGROMSize = 0x8000;
+static const dbyte kResetAddress = 0x8000;
+static const dbyte kSubroutineAddress = 0xFF00;  // Holds a lone RTS / RTI
+
+// Keeps the compiler from discarding benchmarked reads
+static volatile byte sink;
+
+//
+// Builds a 32 KB PRG ROM that runs `prologue` once and then executes
+// `instruction` over and over, jumping back to the start of the run at the
+// end of the ROM.
+//
+static std::unique_ptr<byte[]> make_program(
+    const std::vector<byte>& prologue, const std::vector<byte>& instruction) {
+  auto rom = std::make_unique<byte[]>(kPRGROMSize);
+  dbyte end = kSubroutineAddress - 3;
+
+  size_t position = 0;
+  for (byte value : prologue) {
+    rom[position++] = value;
+  }
+
+  dbyte loop = kResetAddress + position;
+  while (kResetAddress + position + instruction.size() <= end) {
+    for (byte value : instruction) {
+      rom[position++] = value;
+    }
+  }
+
+  rom[position++] = 0x4C;  // JMP loop
+  rom[position++] = loop & 0xFF;
+  rom[position++] = loop >> 8;
+
+  rom[kSubroutineAddress - kResetAddress] = 0x60;  // RTS
+  rom[kSubroutineAddress - kResetAddress + 1] = 0x40;  // RTI
+
+  // NMI, reset and IRQ vectors
+  dbyte vectors[] = {kSubroutineAddress + 1, kResetAddress,
+                     kSubroutineAddress + 1};
+  for (int i = 0; i < 3; i++) {
+    rom[0x7FFA + i * 2] = vectors[i] & 0xFF;
+    rom[0x7FFB + i * 2] = vectors[i] >> 8;
+  }
+
+  return rom;
+}
+
+// Has access to the internals of the classes being measured
+class Benchmarks {
+ private:
+  BenchmarkRunner& runner;
+
+ public:
+  Benchmarks(BenchmarkRunner& runner) : runner(runner) {}
+
+  void execute(std::string name, std::vector<byte> prologue,
+               std::vector<byte> instruction) {
+    PPU ppu(true);
+    ControllerPad controller_pad;
+    Processor processor(&ppu, &controller_pad);
+
+    std::unique_ptr<byte[]> prg_rom = make_program(prologue, instruction);
+    processor.map_prg_rom(0x8000, 0x8000, prg_rom.get());
+    processor.power_on();
+
+    // Run the prologue and warm up
+    for (int i = 0; i < 1000; i++) {
+      processor.execute();
+    }
+
+    runner.run("execute/" + name, [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        processor.execute();
+      }
+    });
+  }
+
+  void execute_all() {
+    // Addressing modes, using LDA where it has the mode
+    execute("immediate/LDA", {}, {0xA9, 0x01});
+    execute("zeropage/LDA", {}, {0xA5, 0x10});
+    execute("zeropage_x/LDA", {0xA2, 0x01}, {0xB5, 0x10});
+    execute("absolute/LDA", {}, {0xAD, 0x00, 0x03});
+    execute("absolute_x/LDA", {0xA2, 0x01}, {0xBD, 0x00, 0x03});
+    execute("absolute_y/LDA", {0xA0, 0x01}, {0xB9, 0x00, 0x03});
+    execute("indirect_pre_x/LDA", {0xA2, 0x01}, {0xA1, 0x10});
+    execute("indirect_post_y/LDA", {0xA0, 0x01}, {0xB1, 0x20});
+    execute("implied/INX", {}, {0xE8});
+    execute("accumulator/ASL", {}, {0x0A});
+    execute("relative/BNE_taken", {0xA2, 0x01}, {0xD0, 0x00});
+    execute("relative/BEQ_not_taken", {0xA2, 0x01}, {0xF0, 0x00});
+
+    // Opcode families
+    execute("alu/ADC", {}, {0x69, 0x01});
+    execute("alu/CMP", {}, {0xC9, 0x01});
+    execute("rmw/INC_zeropage", {}, {0xE6, 0x10});
+    execute("rmw/ROL_absolute", {}, {0x2E, 0x00, 0x03});
+    execute("store/STA_absolute", {}, {0x8D, 0x00, 0x03});
+    execute("stack/PHA_PLA", {}, {0x48, 0x68});
+    execute("flags/SEC_CLC", {}, {0x38, 0x18});
+    execute("jump/JSR_RTS", {},
+            {0x20, kSubroutineAddress & 0xFF, kSubroutineAddress >> 8});
+
+    // JMP ($0300) pointing at itself
+    dbyte jump = kResetAddress + 10;
+    execute("indirect/JMP", {0xA9, static_cast<byte>(jump & 0xFF), 0x8D, 0x00,
+                             0x03, 0xA9, static_cast<byte>(jump >> 8), 0x8D,
+                             0x01, 0x03},
+            {0x6C, 0x00, 0x03});
+  }
+
+  void memory_all() {
+    PPU ppu(true);
+    ControllerPad controller_pad;
+    Processor processor(&ppu, &controller_pad);
+
+    std::unique_ptr<byte[]> prg_rom = make_program({}, {0xEA});
+    processor.map_prg_rom(0x8000, 0x8000, prg_rom.get());
+    processor.power_on();
+
+    struct Region {
+      const char* name;
+      dbyte address;
+      bool writable;
+    };
+    Region regions[] = {
+        {"cpu_ram", 0x0010, true},    {"cpu_ram_mirror", 0x1810, true},
+        {"ppu_status", 0x2002, false}, {"ppu_data", 0x2007, true},
+        {"controller", 0x4016, true},  {"sram", 0x6010, true},
+        {"prg_rom", 0x8010, false},
+    };
+
+    for (const Region& region : regions) {
+      runner.run(std::string("read_memory/") + region.name,
+                 [&](long iterations) {
+                   for (long i = 0; i < iterations; i++) {
+                     sink = processor.read_memory(region.address);
+                   }
+                 });
+
+      if (region.writable) {
+        runner.run(std::string("store_memory/") + region.name,
+                   [&](long iterations) {
+                     for (long i = 0; i < iterations; i++) {
+                       processor.store_memory(region.address, i);
+                     }
+                   });
+      }
+    }
+  }
+
+  void ppu_address_all() {
+    PPU ppu(true);
+
+    struct Region {
+      const char* name;
+      dbyte address;
+    };
+    Region regions[] = {
+        {"pattern", 0x0123},
+        {"nametable", 0x2123},
+        {"nametable_mirror", 0x3123},
+        {"palette", 0x3F13},
+    };
+
+    for (const Region& region : regions) {
+      runner.run(std::string("ppu_read_memory/") + region.name,
+                 [&](long iterations) {
+                   for (long i = 0; i < iterations; i++) {
+                     // Vary the low bits so the result can't be hoisted
+                     sink = ppu.read_memory(region.address + (i & 0x0F));
+                   }
+                 });
+    }
+
+    runner.run("ppu_read_memory/sweep", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        sink = ppu.read_memory(i & 0x3FFF);
+      }
+    });
+  }
+
+  void render_all() {
+    PPU ppu(true);
+
+    // Noisy pattern tables so that most pixels are opaque
+    for (int i = 0; i < kPatternTableSize; i++) {
+      ppu.vram[i] = (i * 0x9E3779B1u) >> 24;
+    }
+    for (int i = 0; i < 32; i++) {
+      ppu.store_memory(kPaletteTableStart + i, i + 1);
+    }
+
+    ppu.write_control_2(0x08);  // Background only
+    runner.run("render_scanline/background", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        ppu.renderer->render_scanline(static_cast<int>(i % kScreenHeight));
+      }
+    });
+
+    // All 64 sprites on scanlines 1-8, spread across the screen, so every
+    // line evaluates the whole table and draws the maximum of 8 sprites
+    for (int i = 0; i < 64; i++) {
+      ppu.spr_ram[i * 4] = 0;
+      ppu.spr_ram[i * 4 + 1] = i;
+      ppu.spr_ram[i * 4 + 2] = i & 0x23;
+      ppu.spr_ram[i * 4 + 3] = i * 4;
+    }
+
+    ppu.write_control_2(0x18);  // Background and sprites
+    runner.run("render_scanline/sprites", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        ppu.renderer->render_scanline(static_cast<int>(1 + i % 8));
+      }
+    });
+  }
+
+  void frame(std::string rom, std::string movie) {
+    std::string filename = rom;
+
+    if (filename.empty()) {
+      // Write a small NROM image that turns on rendering and NMIs and then
+      // spins in a loop of typical instructions
+      const char* directory = getenv("TMPDIR");
+      filename = std::string(directory ? directory : "/tmp") +
+                 "/EmulatorBenchmarks.XXXXXX";
+      int fd = mkstemp(&filename[0]);
+      if (fd < 0) {
+        throw "Could not create the benchmark ROM.";
+      }
+      close(fd);
+
+      std::unique_ptr<byte[]> prg = make_program(
+          {0xA9, 0x80, 0x8D, 0x00, 0x20, 0xA9, 0x1E, 0x8D, 0x01, 0x20},
+          {0xA5, 0x10, 0x69, 0x03, 0x85, 0x10, 0xE8, 0xBD, 0x00, 0x03});
+
+      byte header[16] = {'N', 'E', 'S', 0x1A, 2, 1};
+      std::vector<byte> chr(0x2000);
+      for (size_t i = 0; i < chr.size(); i++) {
+        chr[i] = (i * 0x9E3779B1u) >> 24;
+      }
+
+      std::ofstream file(filename, std::ios::out | std::ios::binary);
+      file.write(reinterpret_cast<const char*>(header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(prg.get()), kPRGROMSize);
+      file.write(reinterpret_cast<const char*>(chr.data()), chr.size());
+    }
+
+    Emulator emulator(true);
+    emulator.load_rom(filename);
+    if (rom.empty()) {
+      unlink(filename.c_str());
+    }
+
+    if (!movie.empty()) {
+      emulator.start_playback(movie);
+    }
+
+    runner.run("emulate_frame", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        emulator.emulate_frame();
+      }
+    });
+
+    // Dot-by-dot rendering took about 1.9x emulate_frame when it was added
+    // (1.40 ms against 0.74 ms per frame)
+    emulator.set_ppu_accuracy(kPPUAccurate);
+    runner.run("emulate_frame/accurate_ppu", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        emulator.emulate_frame();
+      }
+    });
+    emulator.set_ppu_accuracy(kPPUFast);
+
+    // What debugging costs while it's in use; attaching alone costs nothing
+    Debugger debugger;
+    emulator.set_debugger(&debugger);
+    debugger.add_breakpoint(0x0000);  // Never executed
+    runner.run("emulate_frame/breakpoint", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        emulator.emulate_frame();
+      }
+    });
+
+    debugger.clear();
+    debugger.add_watchpoint(0x07FF, true, true);  // A page of RAM, unused
+    runner.run("emulate_frame/watchpoint", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        emulator.emulate_frame();
+      }
+    });
+    emulator.set_debugger(nullptr);
+
+    GuestProfiler profiler;
+    emulator.set_profiler(&profiler);
+    runner.run("emulate_frame/profiler", [&](long iterations) {
+      for (long i = 0; i < iterations; i++) {
+        emulator.emulate_frame();
+      }
+    });
+    emulator.set_profiler(nullptr);
+  }
+};
+
+int main(int argc, const char* argv[]) {
+  std::string filter, json, rom, movie;
+  int samples = 10;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--filter")) {
+      filter = argv[i + 1];
+    } else if (!strcmp(argv[i], "--samples")) {
+      samples = atoi(argv[i + 1]);
+    } else if (!strcmp(argv[i], "--json")) {
+      json = argv[i + 1];
+    } else if (!strcmp(argv[i], "--rom")) {
+      rom = argv[i + 1];
+    } else if (!strcmp(argv[i], "--movie")) {
+      movie = argv[i + 1];
+    } else {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  try {
+    BenchmarkRunner runner(filter, samples > 0 ? samples : 1);
+    Benchmarks benchmarks(runner);
+
+    benchmarks.execute_all();
+    benchmarks.memory_all();
+    benchmarks.ppu_address_all();
+    benchmarks.render_all();
+    benchmarks.frame(rom, movie);
+
+    runner.print_summary();
+    if (!json.empty()) {
+      runner.write_json(json);
+    }
+  } catch (const char* error) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
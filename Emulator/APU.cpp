@@ -0,0 +1,564 @@
+//
+//  APU.cpp
+//  Emulator
+//
+
+#include "APU.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Processor.h"
+#include "Tracer.h"
+
+static const double kCPUClockRate = 39375000.0 / 22;  // NTSC
+
+// Linear approximation of the mixer's output per unit of each channel
+static const float kPulseWeight = 0.00752f;
+static const float kTriangleWeight = 0.00851f;
+static const float kNoiseWeight = 0.00494f;
+static const float kDMCWeight = 0.00335f;
+
+static const byte kLengthTable[32] = {
+    10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+    12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30};
+
+static const byte kDutyTable[4][8] = {{0, 1, 0, 0, 0, 0, 0, 0},
+                                      {0, 1, 1, 0, 0, 0, 0, 0},
+                                      {0, 1, 1, 1, 1, 0, 0, 0},
+                                      {1, 0, 0, 1, 1, 1, 1, 1}};
+
+static const byte kTriangleSequence[32] = {
+    15, 14, 13, 12, 11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15};
+
+// Timer periods in CPU cycles
+static const int kNoisePeriods[16] = {4,   8,   16,  32,  64,  96,
+                                      128, 160, 202, 254, 380, 508,
+                                      762, 1016, 2034, 4068};
+static const int kDMCPeriods[16] = {428, 380, 340, 320, 286, 254, 226, 214,
+                                    190, 160, 142, 128, 106, 84,  72,  54};
+
+// CPU cycles of each frame sequencer step after the sequence starts, and the
+// length of each sequence
+static const int kFourStepSequence[] = {7457, 14913, 22371, 29829};
+static const int kFourStepLength = 29830;
+static const int kFiveStepSequence[] = {7457, 14913, 22371, 29829, 37281};
+static const int kFiveStepLength = 37282;
+
+void Envelope::clock() {
+  if (start) {
+    start = false;
+    decay = 15;
+    divider = volume;
+  } else if (divider == 0) {
+    divider = volume;
+    if (decay > 0) {
+      decay--;
+    } else if (loop) {
+      decay = 15;
+    }
+  } else {
+    divider--;
+  }
+}
+
+//
+// Pulse 1 negates with one's complement, pulse 2 with two's complement.
+//
+int PulseChannel::sweep_target(bool ones_complement) const {
+  int change = timer_period >> sweep_shift;
+  if (sweep_negate) {
+    return std::max(0, timer_period - change - (ones_complement ? 1 : 0));
+  }
+  return timer_period + change;
+}
+
+bool PulseChannel::muted(bool ones_complement) const {
+  return timer_period < 8 ||
+         (!sweep_negate && sweep_target(ones_complement) > 0x7FF);
+}
+
+APU::APU(Processor* processor)
+    : processor(processor),
+      blip(kCPUClockRate, kDefaultSampleRate,
+           static_cast<size_t>(kMaxSampleRate / 30)) {
+  power_on();
+}
+
+void APU::power_on() {
+  pulse[0] = PulseChannel();
+  pulse[1] = PulseChannel();
+  triangle = TriangleChannel();
+  noise = NoiseChannel();
+  dmc = DMCChannel();
+
+  noise.shift_register = 1;
+  noise.timer_period = kNoisePeriods[0];
+  dmc.timer_period = kDMCPeriods[0];
+  dmc.sample_address = 0xC000;
+  dmc.sample_length = 1;
+  dmc.sample_buffer_empty = true;
+  dmc.bits_remaining = 8;
+  dmc.silence = true;
+
+  channel_enables = 0;
+  five_step_mode = false;
+  frame_irq_inhibit = false;
+  frame_irq = false;
+  dmc_irq = false;
+  frame_step = 0;
+  frame_sequence_start = 0;
+
+  cycle = 0;
+  frame_start = 0;
+  blip.clear();
+  update_irq();
+}
+
+void APU::set_sample_rate(double sample_rate) {
+  blip.set_sample_rate(
+      std::min(sample_rate, static_cast<double>(kMaxSampleRate)));
+}
+
+double APU::get_sample_rate() { return blip.get_sample_rate(); }
+
+void APU::write_register(dbyte address, byte value, uint64_t cpu_cycle) {
+  run_until(cpu_cycle);
+
+  if (address < 0x4008) {
+    PulseChannel& p = pulse[(address >> 2) & 0x01];
+    switch (address & 0x03) {
+      case 0:
+        p.duty = value >> 6;
+        p.envelope.loop = value & 0x20;
+        p.envelope.constant_volume = value & 0x10;
+        p.envelope.volume = value & 0x0F;
+        break;
+      case 1:
+        p.sweep_enabled = value & 0x80;
+        p.sweep_period = (value >> 4) & 0x07;
+        p.sweep_negate = value & 0x08;
+        p.sweep_shift = value & 0x07;
+        p.sweep_reload = true;
+        break;
+      case 2:
+        p.timer_period = (p.timer_period & 0x700) | value;
+        break;
+      case 3:
+        p.timer_period = (p.timer_period & 0xFF) | (value & 0x07) << 8;
+        if (channel_enables & (1 << ((address >> 2) & 0x01))) {
+          p.length_counter = kLengthTable[value >> 3];
+        }
+        p.sequence_step = 0;
+        p.envelope.start = true;
+        break;
+    }
+    return;
+  }
+
+  switch (address) {
+    case 0x4008:
+      triangle.control = value & 0x80;
+      triangle.linear_reload_value = value & 0x7F;
+      break;
+    case 0x400A:
+      triangle.timer_period = (triangle.timer_period & 0x700) | value;
+      break;
+    case 0x400B:
+      triangle.timer_period =
+          (triangle.timer_period & 0xFF) | (value & 0x07) << 8;
+      if (channel_enables & 0x04) {
+        triangle.length_counter = kLengthTable[value >> 3];
+      }
+      triangle.linear_reload = true;
+      break;
+
+    case 0x400C:
+      noise.envelope.loop = value & 0x20;
+      noise.envelope.constant_volume = value & 0x10;
+      noise.envelope.volume = value & 0x0F;
+      break;
+    case 0x400E:
+      noise.mode = value & 0x80;
+      noise.timer_period = kNoisePeriods[value & 0x0F];
+      break;
+    case 0x400F:
+      if (channel_enables & 0x08) {
+        noise.length_counter = kLengthTable[value >> 3];
+      }
+      noise.envelope.start = true;
+      break;
+
+    case 0x4010:
+      dmc.irq_enabled = value & 0x80;
+      dmc.loop = value & 0x40;
+      dmc.timer_period = kDMCPeriods[value & 0x0F];
+      if (!dmc.irq_enabled) {
+        dmc_irq = false;
+        update_irq();
+      }
+      break;
+    case 0x4011:
+      dmc.output_level = value & 0x7F;
+      break;
+    case 0x4012:
+      dmc.sample_address = 0xC000 + value * 64;
+      break;
+    case 0x4013:
+      dmc.sample_length = value * 16 + 1;
+      break;
+
+    case 0x4015:
+      channel_enables = value;
+      if (!(value & 0x01)) {
+        pulse[0].length_counter = 0;
+      }
+      if (!(value & 0x02)) {
+        pulse[1].length_counter = 0;
+      }
+      if (!(value & 0x04)) {
+        triangle.length_counter = 0;
+      }
+      if (!(value & 0x08)) {
+        noise.length_counter = 0;
+      }
+
+      if (!(value & 0x10)) {
+        dmc.bytes_remaining = 0;
+      } else if (dmc.bytes_remaining == 0) {
+        dmc.current_address = dmc.sample_address;
+        dmc.bytes_remaining = dmc.sample_length;
+        fill_dmc_sample_buffer();
+      }
+
+      dmc_irq = false;
+      update_irq();
+      break;
+
+    case 0x4017:
+      five_step_mode = value & 0x80;
+      frame_irq_inhibit = value & 0x40;
+      if (frame_irq_inhibit) {
+        frame_irq = false;
+        update_irq();
+      }
+
+      frame_sequence_start = cpu_cycle;
+      frame_step = 0;
+      if (five_step_mode) {
+        clock_quarter_frame();
+        clock_half_frame();
+      }
+      break;
+  }
+}
+
+byte APU::read_status(uint64_t cpu_cycle) {
+  run_until(cpu_cycle);
+
+  byte status = (pulse[0].length_counter > 0) |
+                (pulse[1].length_counter > 0) << 1 |
+                (triangle.length_counter > 0) << 2 |
+                (noise.length_counter > 0) << 3 |
+                (dmc.bytes_remaining > 0) << 4 | frame_irq << 6 |
+                dmc_irq << 7;
+
+  // Reading acknowledges the frame interrupt
+  frame_irq = false;
+  update_irq();
+
+  return status;
+}
+
+void APU::run_until(uint64_t cpu_cycle) {
+  while (cycle < cpu_cycle) {
+    uint64_t event = next_frame_event();
+    run(std::min(cpu_cycle, event));
+
+    if (cycle == event) {
+      clock_frame_sequencer();
+    }
+  }
+}
+
+void APU::end_frame(uint64_t cpu_cycle) {
+  TRACE_SCOPE("apu");
+  run_until(cpu_cycle);
+
+  blip.end_frame(static_cast<uint32_t>(cycle - frame_start));
+  frame_start = cycle;
+}
+
+size_t APU::samples_available() { return blip.samples_available(); }
+
+size_t APU::read_samples(int16_t* destination, size_t count) {
+  return blip.read_samples(destination, count);
+}
+
+void APU::run(uint64_t end) {
+  run_pulse(0, end);
+  run_pulse(1, end);
+  run_triangle(end);
+  run_noise(end);
+  run_dmc(end);
+  cycle = end;
+}
+
+uint64_t APU::next_frame_event() {
+  const int* sequence = five_step_mode ? kFiveStepSequence : kFourStepSequence;
+  return frame_sequence_start + sequence[frame_step];
+}
+
+void APU::clock_frame_sequencer() {
+  if (five_step_mode) {
+    // Step 3 does nothing in five step mode
+    if (frame_step != 3) {
+      clock_quarter_frame();
+    }
+    if (frame_step == 1 || frame_step == 4) {
+      clock_half_frame();
+    }
+  } else {
+    clock_quarter_frame();
+    if (frame_step == 1 || frame_step == 3) {
+      clock_half_frame();
+    }
+    if (frame_step == 3 && !frame_irq_inhibit) {
+      frame_irq = true;
+      update_irq();
+    }
+  }
+
+  frame_step++;
+  if (frame_step == (five_step_mode ? 5 : 4)) {
+    frame_step = 0;
+    frame_sequence_start += five_step_mode ? kFiveStepLength : kFourStepLength;
+  }
+}
+
+void APU::clock_quarter_frame() {
+  pulse[0].envelope.clock();
+  pulse[1].envelope.clock();
+  noise.envelope.clock();
+
+  if (triangle.linear_reload) {
+    triangle.linear_counter = triangle.linear_reload_value;
+  } else if (triangle.linear_counter > 0) {
+    triangle.linear_counter--;
+  }
+  if (!triangle.control) {
+    triangle.linear_reload = false;
+  }
+}
+
+void APU::clock_half_frame() {
+  for (int i = 0; i < 2; i++) {
+    PulseChannel& p = pulse[i];
+    if (!p.envelope.loop && p.length_counter > 0) {
+      p.length_counter--;
+    }
+
+    if (p.sweep_divider == 0 && p.sweep_enabled && p.sweep_shift > 0 &&
+        !p.muted(i == 0)) {
+      p.timer_period = p.sweep_target(i == 0);
+    }
+    if (p.sweep_divider == 0 || p.sweep_reload) {
+      p.sweep_divider = p.sweep_period;
+      p.sweep_reload = false;
+    } else {
+      p.sweep_divider--;
+    }
+  }
+
+  if (!triangle.control && triangle.length_counter > 0) {
+    triangle.length_counter--;
+  }
+  if (!noise.envelope.loop && noise.length_counter > 0) {
+    noise.length_counter--;
+  }
+}
+
+//
+// Each channel steps from one timer expiry to the next; silent channels only
+// advance their timers.
+//
+void APU::run_pulse(int index, uint64_t end) {
+  PulseChannel& p = pulse[index];
+  uint64_t period = (p.timer_period + 1) * 2;
+  uint64_t time = cycle + p.timer;
+
+  int volume = p.length_counter > 0 && !p.muted(index == 0)
+                   ? p.envelope.output()
+                   : 0;
+  update_amplitude(p.amplitude, kDutyTable[p.duty][p.sequence_step] * volume,
+                   kPulseWeight, cycle);
+
+  if (volume == 0) {
+    if (time < end) {
+      uint64_t steps = (end - time + period - 1) / period;
+      p.sequence_step = (p.sequence_step + steps) & 0x07;
+      time += steps * period;
+    }
+  } else {
+    for (; time < end; time += period) {
+      p.sequence_step = (p.sequence_step + 1) & 0x07;
+      update_amplitude(p.amplitude,
+                       kDutyTable[p.duty][p.sequence_step] * volume,
+                       kPulseWeight, time);
+    }
+  }
+
+  p.timer = static_cast<int>(time - end);
+}
+
+void APU::run_triangle(uint64_t end) {
+  TriangleChannel& t = triangle;
+  uint64_t period = t.timer_period + 1;
+  uint64_t time = cycle + t.timer;
+
+  // Ultrasonic periods are silenced instead of being emulated as noise
+  bool active = t.length_counter > 0 && t.linear_counter > 0 &&
+                t.timer_period >= 2;
+
+  if (!active) {
+    if (time < end) {
+      time += (end - time + period - 1) / period * period;
+    }
+  } else {
+    for (; time < end; time += period) {
+      t.sequence_step = (t.sequence_step + 1) & 0x1F;
+      update_amplitude(t.amplitude, kTriangleSequence[t.sequence_step],
+                       kTriangleWeight, time);
+    }
+  }
+
+  t.timer = static_cast<int>(time - end);
+}
+
+void APU::run_noise(uint64_t end) {
+  NoiseChannel& n = noise;
+  uint64_t time = cycle + n.timer;
+  int volume = n.length_counter > 0 ? n.envelope.output() : 0;
+  int tap = n.mode ? 6 : 1;
+
+  update_amplitude(n.amplitude, n.shift_register & 1 ? 0 : volume,
+                   kNoiseWeight, cycle);
+
+  for (; time < end; time += n.timer_period) {
+    int feedback = (n.shift_register ^ (n.shift_register >> tap)) & 1;
+    n.shift_register = (n.shift_register >> 1) | feedback << 14;
+    update_amplitude(n.amplitude, n.shift_register & 1 ? 0 : volume,
+                     kNoiseWeight, time);
+  }
+
+  n.timer = static_cast<int>(time - end);
+}
+
+void APU::run_dmc(uint64_t end) {
+  DMCChannel& d = dmc;
+  uint64_t time = cycle + d.timer;
+
+  update_amplitude(d.amplitude, d.output_level, kDMCWeight, cycle);
+
+  for (; time < end; time += d.timer_period) {
+    if (!d.silence) {
+      if (d.shift_register & 1) {
+        if (d.output_level <= 125) {
+          d.output_level += 2;
+        }
+      } else if (d.output_level >= 2) {
+        d.output_level -= 2;
+      }
+      update_amplitude(d.amplitude, d.output_level, kDMCWeight, time);
+    }
+
+    d.shift_register >>= 1;
+    if (--d.bits_remaining == 0) {
+      d.bits_remaining = 8;
+      d.silence = d.sample_buffer_empty;
+      if (!d.sample_buffer_empty) {
+        d.shift_register = d.sample_buffer;
+        d.sample_buffer_empty = true;
+        fill_dmc_sample_buffer();
+      }
+    }
+  }
+
+  d.timer = static_cast<int>(time - end);
+}
+
+void APU::fill_dmc_sample_buffer() {
+  DMCChannel& d = dmc;
+  if (!d.sample_buffer_empty || d.bytes_remaining == 0) {
+    return;
+  }
+
+  d.sample_buffer = processor->read_memory(d.current_address);
+  d.sample_buffer_empty = false;
+  d.current_address =
+      d.current_address == 0xFFFF ? 0x8000 : d.current_address + 1;
+
+  if (--d.bytes_remaining == 0) {
+    if (d.loop) {
+      d.current_address = d.sample_address;
+      d.bytes_remaining = d.sample_length;
+    } else if (d.irq_enabled) {
+      dmc_irq = true;
+      update_irq();
+    }
+  }
+}
+
+void APU::update_amplitude(int& amplitude, int level, float weight,
+                           uint64_t time) {
+  if (level != amplitude) {
+    blip.add_delta(static_cast<uint32_t>(time - frame_start),
+                   (level - amplitude) * weight);
+    amplitude = level;
+  }
+}
+
+void APU::update_irq() {
+  processor->set_irq_line(kIRQFrameCounter, frame_irq);
+  processor->set_irq_line(kIRQDMC, dmc_irq);
+}
+
+void APU::save_state(StateWriter& writer) {
+  writer.write(pulse);
+  writer.write(triangle);
+  writer.write(noise);
+  writer.write(dmc);
+
+  writer.write(channel_enables);
+  writer.write(five_step_mode);
+  writer.write(frame_irq_inhibit);
+  writer.write(frame_irq);
+  writer.write(dmc_irq);
+  writer.write(frame_step);
+  writer.write(frame_sequence_start);
+  writer.write(cycle);
+}
+
+void APU::load_state(StateReader& reader) {
+  reader.read(pulse);
+  reader.read(triangle);
+  reader.read(noise);
+  reader.read(dmc);
+
+  reader.read(channel_enables);
+  reader.read(five_step_mode);
+  reader.read(frame_irq_inhibit);
+  reader.read(frame_irq);
+  reader.read(dmc_irq);
+  reader.read(frame_step);
+  reader.read(frame_sequence_start);
+  reader.read(cycle);
+
+  // Restart the audio stream from silence at the restored time
+  frame_start = cycle;
+  blip.clear();
+  pulse[0].amplitude = pulse[1].amplitude = 0;
+  triangle.amplitude = noise.amplitude = dmc.amplitude = 0;
+  update_irq();
+}
@@ -0,0 +1,165 @@
+//
+//  APU.h
+//  Emulator
+//
+//  The audio processing unit: two pulse channels, a triangle, noise and the
+//  delta modulation channel (DMC). The APU runs lazily. Register accesses
+//  and the emulator's per-scanline and end-of-frame calls catch it up to the
+//  CPU's cycle count, and each channel steps straight from one output change
+//  to the next, adding the change to a band-limited buffer.
+//
+
+#ifndef __Emulator__APU__
+#define __Emulator__APU__
+
+#include <cstdint>
+
+#include "BlipBuffer.h"
+#include "SaveState.h"
+#include "defines.h"
+
+class Processor;
+
+struct Envelope {
+  bool start;
+  bool loop;  // Also halts the length counter
+  bool constant_volume;
+  byte volume;  // Constant volume, or the envelope's divider period
+  byte divider;
+  byte decay;
+
+  void clock();
+  int output() const { return constant_volume ? volume : decay; }
+};
+
+struct PulseChannel {
+  Envelope envelope;
+  byte duty;
+  byte sequence_step;
+  int timer_period;   // 11 bits
+  int timer;          // CPU cycles until the next sequencer step
+  int length_counter;
+
+  bool sweep_enabled;
+  bool sweep_negate;
+  bool sweep_reload;
+  byte sweep_period;
+  byte sweep_shift;
+  byte sweep_divider;
+
+  int amplitude;  // Last output level
+
+  int sweep_target(bool ones_complement) const;
+  bool muted(bool ones_complement) const;
+};
+
+struct TriangleChannel {
+  bool control;  // Halts the length counter, holds the linear counter
+  byte linear_reload_value;
+  byte linear_counter;
+  bool linear_reload;
+  byte sequence_step;
+  int timer_period;
+  int timer;
+  int length_counter;
+
+  int amplitude;
+};
+
+struct NoiseChannel {
+  Envelope envelope;
+  bool mode;  // Short (93-step) sequence
+  int timer_period;
+  int timer;
+  int length_counter;
+  uint16_t shift_register;
+
+  int amplitude;
+};
+
+struct DMCChannel {
+  bool irq_enabled;
+  bool loop;
+  int timer_period;
+  int timer;
+
+  dbyte sample_address;
+  int sample_length;
+  dbyte current_address;
+  int bytes_remaining;
+
+  byte sample_buffer;
+  bool sample_buffer_empty;
+  byte shift_register;
+  int bits_remaining;
+  bool silence;
+  byte output_level;  // 7 bits
+
+  int amplitude;
+};
+
+class APU {
+ private:
+  Processor* processor;
+  BlipBuffer blip;
+
+  PulseChannel pulse[2];
+  TriangleChannel triangle;
+  NoiseChannel noise;
+  DMCChannel dmc;
+
+  byte channel_enables;  // $4015
+
+  // Frame sequencer, which clocks envelopes, sweeps and length counters
+  bool five_step_mode;
+  bool frame_irq_inhibit;
+  bool frame_irq;
+  bool dmc_irq;
+  int frame_step;
+  uint64_t frame_sequence_start;  // CPU cycle the current sequence began
+
+  uint64_t cycle;        // CPU cycle the APU has run up to
+  uint64_t frame_start;  // CPU cycle the current audio frame began
+
+  void run(uint64_t end);
+  uint64_t next_frame_event();
+  void clock_frame_sequencer();
+  void clock_quarter_frame();
+  void clock_half_frame();
+
+  void run_pulse(int index, uint64_t end);
+  void run_triangle(uint64_t end);
+  void run_noise(uint64_t end);
+  void run_dmc(uint64_t end);
+  void fill_dmc_sample_buffer();
+
+  void update_amplitude(int& amplitude, int level, float weight,
+                        uint64_t time);
+  void update_irq();
+
+ public:
+  static const int kDefaultSampleRate = 48000;
+  static const int kMaxSampleRate = 96000;  // Higher rates are clamped
+
+  APU(Processor* processor);
+
+  void power_on();
+  void set_sample_rate(double sample_rate);  // At most kMaxSampleRate
+  double get_sample_rate();
+
+  void write_register(dbyte address, byte value, uint64_t cpu_cycle);
+  byte read_status(uint64_t cpu_cycle);
+
+  // Catches up to `cpu_cycle`
+  void run_until(uint64_t cpu_cycle);
+
+  // Catches up and makes the frame's samples available
+  void end_frame(uint64_t cpu_cycle);
+  size_t samples_available();
+  size_t read_samples(int16_t* destination, size_t count);
+
+  void save_state(StateWriter& writer);
+  void load_state(StateReader& reader);
+};
+
+#endif /* defined(__Emulator__APU__) */
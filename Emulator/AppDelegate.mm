@@ -8,14 +8,100 @@
 
 #import "AppDelegate.h"
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
 
 #include "SDL.h"
 
+#include "AudioRateControl.h"
+#include "CpuTrace.h"
+#include "Debugger.h"
 #include "Emulator.h"
+#include "FramePacer.h"
+#include "GuestProfiler.h"
+#include "InputEventQueue.h"
+#include "NetplayTransport.h"
+#include "NsfPlayer.h"
+#include "RollbackSession.h"
+#include "SDLAudio.h"
+#include "Tracer.h"
+#include "VideoCapture.h"
+
+struct InputWatch {
+  InputEventQueue* queue;
+  uint64_t clock_offset;  // steady_clock nanoseconds at SDL tick 0
+};
+
+// Called by SDL for each event as it's pumped, so controller keys reach the
+// queue even when events are pumped mid-frame
+static int push_input_event(void* userdata, SDL_Event* event) {
+  if ((event->type != SDL_KEYDOWN && event->type != SDL_KEYUP) ||
+      event->key.repeat) {
+    return 0;
+  }
+
+  byte button = ControllerPad::button_for_scancode(event->key.keysym.scancode);
+  if (button) {
+    InputWatch* watch = static_cast<InputWatch*>(userdata);
+    uint64_t time = std::min(
+        watch->clock_offset + event->key.timestamp * 1000000ULL,
+        InputEventQueue::now());
+    watch->queue->push({time, 0, button, event->type == SDL_KEYDOWN});
+  }
+
+  return 0;
+}
 
 @implementation AppDelegate
 
+// Plays an NSF file until quit. Left and right switch songs.
+- (void)playNSF:(const char*)filename {
+  try {
+    NsfPlayer player(filename);
+    SDLAudio audio(APU::kDefaultSampleRate);
+    player.set_audio_sample_rate(audio.get_sample_rate());
+
+    const NsfHeader& header = player.get_header();
+    std::cout << header.name << " - " << header.artist << " ("
+              << header.songs << " songs)" << std::endl;
+
+    FramePacer pacer(header.ntsc_speed * 1000ULL, 1);
+
+    while (true) {
+      SDL_Event event;
+      while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+          SDL_Quit();
+          [NSApp terminate:self];
+        } else if (event.type == SDL_KEYDOWN) {
+          int song = player.get_song();
+          if (event.key.keysym.sym == SDLK_RIGHT) {
+            player.start_song(song % header.songs + 1);
+          } else if (event.key.keysym.sym == SDLK_LEFT) {
+            player.start_song(song > 1 ? song - 1 : header.songs);
+          }
+          if (player.get_song() != song) {
+            std::cout << "Song " << player.get_song() << std::endl;
+          }
+        }
+      }
+
+      player.play_frame();
+      const std::vector<int16_t>& samples = player.get_audio_samples();
+      audio.queue_samples(samples.data(), samples.size());
+
+      pacer.wait_for_next_frame();
+    }
+  } catch (const char* error) {
+    std::cout << error << std::endl;
+    SDL_Quit();
+    [NSApp terminate:self];
+  }
+}
+
 - (void)applicationWillTerminate:(NSNotification*)notification {
   SDL_Event event;
   event.type = SDL_QUIT;
@@ -37,34 +123,319 @@
   std::cout << "Emulator - Tyler Kieft - SDL Version " << (int)version.major << "."
             << (int)version.minor << "." << (int)version.patch << std::endl;
 
+  // Set EMULATOR_NSF to an .nsf file to play music instead of a game
+  const char* nsf_filename = getenv("EMULATOR_NSF");
+  if (nsf_filename) {
+    [self playNSF:nsf_filename];
+    return;
+  }
+
   // initialize the engine
   Emulator emulator;
   emulator.load_rom("/Users/tkieft/code/NES Emulator Dev Resources/Super Mario Bros. (JU) [!].nes");
   // emulator.load_rom("/Users/tkieft/code/NES Emulator Dev Resources/NEStress/NEStress.nes");
 
+  // Set EMULATOR_PPU_ACCURACY to "accurate" for ROMs that need the
+  // dot-based PPU
+  const char* accuracy_setting = getenv("EMULATOR_PPU_ACCURACY");
+  if (accuracy_setting && std::string(accuracy_setting) == "accurate") {
+    emulator.set_ppu_accuracy(kPPUAccurate);
+  }
+
+  // Set EMULATOR_CHEATS to a comma-separated list of Game Genie codes or
+  // raw patches (AAAA:VV or AAAA?CC:VV)
+  const char* cheat_setting = getenv("EMULATOR_CHEATS");
+  if (cheat_setting) {
+    std::stringstream codes(cheat_setting);
+    std::string code;
+    while (std::getline(codes, code, ',')) {
+      try {
+        emulator.add_cheat(code);
+      } catch (const char* error) {
+        std::cout << error << " " << code << std::endl;
+      }
+    }
+  }
+
+  // Set EMULATOR_TRACE to a file name to record a Chrome trace-event timeline
+  const char* trace_filename = getenv("EMULATOR_TRACE");
+  if (trace_filename) {
+    Tracer::instance().start(trace_filename);
+  }
+
+  // Set EMULATOR_CPU_TRACE to a file name to record every instruction; turn
+  // it into text with TraceDisassembler
+  const char* cpu_trace_filename = getenv("EMULATOR_CPU_TRACE");
+  if (cpu_trace_filename) {
+    CpuTrace::instance().start(cpu_trace_filename);
+  }
+
+  // Run silently if there is no audio device
+  std::unique_ptr<SDLAudio> audio;
+  try {
+    audio = std::make_unique<SDLAudio>(APU::kDefaultSampleRate);
+    emulator.set_audio_sample_rate(audio->get_sample_rate());
+  } catch (const char* error) {
+    std::cout << error << std::endl;
+  }
+
+  FramePacer pacer;
+
+  // Set EMULATOR_NETPLAY_PEER to host:port to play against another copy of
+  // the emulator, listening on EMULATOR_NETPLAY_PORT (default 7000) as
+  // EMULATOR_NETPLAY_PLAYER 1 or 2. Both sides must load the same ROM.
+  const char* netplay_peer = getenv("EMULATOR_NETPLAY_PEER");
+  std::unique_ptr<UdpTransport> netplay_transport;
+  std::unique_ptr<RollbackSession> netplay;
+  byte netplay_buttons = 0;
+  if (netplay_peer) {
+    const char* port_setting = getenv("EMULATOR_NETPLAY_PORT");
+    const char* player_setting = getenv("EMULATOR_NETPLAY_PLAYER");
+    std::string peer = netplay_peer;
+    size_t colon = peer.rfind(':');
+    try {
+      netplay_transport = std::make_unique<UdpTransport>(
+          port_setting ? atoi(port_setting) : 7000, peer.substr(0, colon),
+          colon == std::string::npos ? 7000 : atoi(peer.c_str() + colon + 1));
+      netplay = std::make_unique<RollbackSession>(
+          &emulator, netplay_transport.get(),
+          player_setting && atoi(player_setting) == 2 ? 1 : 0, 2);
+    } catch (const char* error) {
+      std::cout << error << std::endl;
+      SDL_Quit();
+      [NSApp terminate:self];
+    }
+  }
+
+  // Controller input is timestamped as SDL receives it and applied when the
+  // game next reads the controller. Emulation runs on this thread, so the
+  // controller pumps SDL's events itself each time the game strobes it.
+  // Netplay input has to be fixed per frame instead.
+  InputEventQueue input_queue;
+  InputWatch input_watch = {
+      &input_queue, InputEventQueue::now() - SDL_GetTicks() * 1000000ULL};
+  if (!netplay) {
+    input_queue.set_poll_callback([] { SDL_PumpEvents(); });
+    SDL_AddEventWatch(push_input_event, &input_watch);
+    emulator.set_input_queue(&input_queue);
+  }
+
+  // Set EMULATOR_AUDIO_SYNC to steer the audio rate so the device's queue
+  // holds EMULATOR_AUDIO_LATENCY_MS of audio (default 40)
+  const char* latency_setting = getenv("EMULATOR_AUDIO_LATENCY_MS");
+  std::unique_ptr<AudioRateControl> rate_control;
+  if (audio && getenv("EMULATOR_AUDIO_SYNC")) {
+    rate_control = std::make_unique<AudioRateControl>(
+        audio->get_sample_rate(),
+        latency_setting ? atof(latency_setting) : 40);
+  }
+
+  // Set EMULATOR_VIDEO_CAPTURE to a file, or to "|command" to pipe into an
+  // encoder, to record every frame. EMULATOR_VIDEO_FORMAT picks yuv (Y4M,
+  // the default), index (monochrome Y4M of NES color indices) or rgb (raw
+  // RGB24).
+  const char* capture_destination = getenv("EMULATOR_VIDEO_CAPTURE");
+  const char* capture_format_setting = getenv("EMULATOR_VIDEO_FORMAT");
+  std::unique_ptr<VideoCapture> capture;
+  if (capture_destination) {
+    std::string format_name =
+        capture_format_setting ? capture_format_setting : "yuv";
+    VideoFormat format = format_name == "index" ? kVideoPaletteIndex
+                         : format_name == "rgb" ? kVideoRGB24
+                                                : kVideoYUV420;
+    try {
+      capture = std::make_unique<VideoCapture>(capture_destination, format,
+                                               format != kVideoRGB24);
+    } catch (const char* error) {
+      std::cout << error << std::endl;
+    }
+  }
+
+  // Set EMULATOR_BREAKPOINT to a PC in hex to stop there. While stopped, F5
+  // continues, F10 steps over and F11 steps into. Not available in netplay.
+  const char* breakpoint_setting = getenv("EMULATOR_BREAKPOINT");
+  Debugger debugger;
+  if (breakpoint_setting && !netplay) {
+    emulator.set_debugger(&debugger);
+    debugger.add_breakpoint(strtol(breakpoint_setting, nullptr, 16));
+  }
+
+  // Set EMULATOR_PROFILE to a path prefix to profile the game. On exit it
+  // writes <prefix>.txt (hot PCs and routines), <prefix>.folded (for
+  // flamegraph.pl) and <prefix>.cdl (the code/data log).
+  const char* profile_prefix = getenv("EMULATOR_PROFILE");
+  GuestProfiler profiler;
+  if (profile_prefix) {
+    emulator.set_profiler(&profiler);
+  }
+
+  // Holding ` (backquote) fast-forwards, uncapped unless
+  // EMULATOR_FAST_FORWARD_SPEED sets a multiple of normal speed
+  const char* fast_forward_setting = getenv("EMULATOR_FAST_FORWARD_SPEED");
+  double fast_forward_speed = 0;
+  if (fast_forward_setting) {
+    char* end;
+    double speed = strtod(fast_forward_setting, &end);
+    if (end == fast_forward_setting || *end != '\0' || !(speed >= 0)) {
+      std::cout << "Invalid EMULATOR_FAST_FORWARD_SPEED "
+                << fast_forward_setting << "; fast-forward is uncapped"
+                << std::endl;
+    } else {
+      fast_forward_speed = speed;
+    }
+  }
+
   // main loop
   while (true) {
-    Uint32 ticks = SDL_GetTicks();
+    TRACE_INSTANT("frame");
 
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
       if (event.type == SDL_QUIT) {
+        if (kPerfCountersEnabled) {
+          NSString* path = [NSTemporaryDirectory()
+              stringByAppendingPathComponent:@"emulator_perf_counters.json"];
+          emulator.write_perf_counters(path.UTF8String);
+          std::cout << "Performance counters written to " << path.UTF8String
+                    << std::endl;
+        }
+
+        if (profile_prefix) {
+          std::string prefix = profile_prefix;
+          try {
+            profiler.write_report(prefix + ".txt", 40);
+            profiler.write_folded_stacks(prefix + ".folded");
+            profiler.write_code_log(prefix + ".cdl");
+          } catch (const char* error) {
+            std::cout << error << std::endl;
+          }
+        }
+
+        FramePacerStats stats = pacer.get_stats();
+        std::cout << "Frames: " << stats.frames
+                  << ", missed deadlines: " << stats.missed_deadlines
+                  << ", frame time p50 " << stats.p50_ms << " ms, p99 "
+                  << stats.p99_ms << " ms" << std::endl;
+
+        if (audio) {
+          std::cout << "Audio underruns: " << audio->get_underruns();
+          if (rate_control) {
+            AudioRateControlStats audio_stats = rate_control->get_stats();
+            std::cout << ", latency mean " << audio_stats.mean_latency_ms
+                      << " ms, max " << audio_stats.max_latency_ms
+                      << " ms, rate ratio " << audio_stats.min_ratio << "-"
+                      << audio_stats.max_ratio;
+          }
+          std::cout << std::endl;
+        }
+
+        InputLatencyStats input_stats = emulator.get_input_latency();
+        std::cout << "Input events: " << input_stats.events
+                  << ", latency to read mean " << input_stats.mean_ms
+                  << " ms, max " << input_stats.max_ms << " ms" << std::endl;
+
+        if (netplay) {
+          NetplayStats netplay_stats = netplay->get_stats();
+          std::cout << "Netplay rollbacks: " << netplay_stats.rollbacks
+                    << ", re-simulated " << netplay_stats.resimulated_frames
+                    << " frames (" << netplay_stats.resimulated_per_second
+                    << "/s, max " << netplay_stats.max_resimulated_per_second
+                    << "/s), stalled " << netplay_stats.stalled_frames
+                    << " frames" << std::endl;
+        }
+
+        if (capture) {
+          try {
+            capture->close();
+          } catch (const char* error) {
+            std::cout << error << std::endl;
+          }
+
+          VideoCaptureStats capture_stats = capture->get_stats();
+          std::cout << "Video frames written: " << capture_stats.frames_written
+                    << ", dropped: " << capture_stats.frames_dropped
+                    << ", max queued: " << capture_stats.max_queued_frames
+                    << std::endl;
+        }
+
+        if (CpuTrace::is_enabled()) {
+          try {
+            CpuTrace::instance().stop();
+            std::cout << "CPU trace: "
+                      << CpuTrace::instance().get_records_written()
+                      << " instructions" << std::endl;
+          } catch (const char* error) {
+            std::cout << error << std::endl;
+          }
+        }
+
+        SDL_DelEventWatch(push_input_event, &input_watch);
+        Tracer::instance().stop();
         SDL_Quit();
         [NSApp terminate:self];
+      } else if (netplay) {
+        // No fast-forward in netplay
+        if (event.type == SDL_KEYDOWN) {
+          netplay_buttons |=
+              ControllerPad::button_for_scancode(event.key.keysym.scancode);
+        } else if (event.type == SDL_KEYUP) {
+          netplay_buttons &=
+              ~ControllerPad::button_for_scancode(event.key.keysym.scancode);
+        }
       } else if (event.type == SDL_KEYDOWN) {
-        emulator.handle_key_down(event.key.keysym);
+        if (event.key.keysym.sym == SDLK_BACKQUOTE && !event.key.repeat) {
+          pacer.set_speed(fast_forward_speed);
+        } else if (debugger.is_stopped()) {
+          if (event.key.keysym.sym == SDLK_F5) {
+            debugger.resume();
+          } else if (event.key.keysym.sym == SDLK_F10) {
+            debugger.step_over();
+          } else if (event.key.keysym.sym == SDLK_F11) {
+            debugger.step();
+          }
+        }
       } else if (event.type == SDL_KEYUP) {
-        emulator.handle_key_up(event.key.keysym);
+        if (event.key.keysym.sym == SDLK_BACKQUOTE) {
+          pacer.set_speed(1);
+        }
       }
     }
 
-    emulator.emulate_frame();
+    bool emulated = true;
+    if (netplay) {
+      // A stalled frame repeats the last picture and plays no audio
+      emulated = netplay->advance_frame(netplay_buttons);
+    } else {
+      // Skipping presentation keeps fast-forward from being throttled by
+      // SDL_UpdateWindowSurface
+      emulator.set_present_frames(pacer.should_present_frame());
+      bool was_stopped = debugger.is_stopped();
+      emulated = emulator.emulate_frame();
+
+      if (debugger.is_stopped() && !was_stopped) {
+        std::cout << "Stopped (reason " << debugger.get_stop_reason()
+                  << ") at $" << std::hex << debugger.get_stop_address()
+                  << std::dec << std::endl;
+      }
+    }
+
+    if (capture && emulated) {
+      capture->write_frame(emulator.get_framebuffer());
+    }
+
+    if (audio && emulated) {
+      const std::vector<int16_t>& samples = emulator.get_audio_samples();
+      audio->queue_samples(samples.data(), samples.size());
+    }
+
+    pacer.wait_for_next_frame();
 
-    // subtract the # of ms it took us to render this frame from
-    // the # of ms we have to render each frame
-    int ms_to_sleep = 1000 / kFPS - static_cast<int>(SDL_GetTicks() - ticks);
-    if (ms_to_sleep > 0) {
-      SDL_Delay(static_cast<Uint32>(ms_to_sleep));
+    // Fast-forward leaves the queue to overflow
+    if (rate_control && pacer.get_speed() == 1) {
+      TRACE_SCOPE("audio_sync");
+      audio->wait_for_queued_below(rate_control->get_ceiling_samples());
+      emulator.set_audio_sample_rate(rate_control->update(
+          emulator.get_audio_samples().size(), audio->get_queued_samples()));
     }
   }
 }
@@ -0,0 +1,81 @@
+//
+//  AudioRateControl.cpp
+//  Emulator
+//
+
+#include "AudioRateControl.h"
+
+#include <algorithm>
+
+static const double kFrameRate = 39375000.0 / 22 / 29780.5;  // NTSC
+
+// Weight of each new fill measurement. The device drains the queue in
+// bursts, so single readings jitter by up to a callback's worth of samples.
+static const double kSmoothing = 0.1;
+
+// Frames of headroom above the target before the loop waits on the device
+static const double kCeilingFrames = 3;
+
+// Frames only round to whole samples, so the length estimate moves slowly
+static const double kBaseSmoothing = 0.02;
+
+AudioRateControl::AudioRateControl(double sample_rate,
+                                   double target_latency_ms,
+                                   double max_adjustment)
+    : sample_rate(sample_rate),
+      target_samples(sample_rate * target_latency_ms / 1000),
+      max_adjustment(max_adjustment),
+      smoothed_samples(target_samples),
+      ratio(1),
+      base(1),
+      frames(0),
+      latency_ms(0),
+      total_latency_ms(0),
+      max_latency_ms(0),
+      min_ratio(1),
+      max_ratio(1) {}
+
+size_t AudioRateControl::get_ceiling_samples() {
+  return static_cast<size_t>(target_samples +
+                             kCeilingFrames * sample_rate / kFrameRate);
+}
+
+double AudioRateControl::update(size_t frame_samples, size_t queued_samples) {
+  // How many samples a frame yields per unit of output rate, compared with
+  // how many a real frame period needs
+  if (frame_samples > 0) {
+    double samples_per_rate = frame_samples / (base * ratio);
+    double needed = sample_rate / kFrameRate / samples_per_rate;
+    base += (needed - base) * kBaseSmoothing;
+  }
+
+  smoothed_samples += (queued_samples - smoothed_samples) * kSmoothing;
+
+  // Proportional control: full adjustment at an empty queue or at twice the
+  // target, none at the target
+  double error = (target_samples - smoothed_samples) / target_samples;
+  error = std::max(-1.0, std::min(1.0, error));
+  ratio = 1 + error * max_adjustment;
+
+  frames++;
+  latency_ms = queued_samples * 1000 / sample_rate;
+  total_latency_ms += latency_ms;
+  max_latency_ms = std::max(max_latency_ms, latency_ms);
+  min_ratio = std::min(min_ratio, ratio);
+  max_ratio = std::max(max_ratio, ratio);
+
+  return sample_rate * base * ratio;
+}
+
+double AudioRateControl::get_ratio() { return ratio; }
+
+AudioRateControlStats AudioRateControl::get_stats() {
+  AudioRateControlStats stats;
+  stats.frames = frames;
+  stats.latency_ms = latency_ms;
+  stats.mean_latency_ms = frames ? total_latency_ms / frames : 0;
+  stats.max_latency_ms = max_latency_ms;
+  stats.min_ratio = min_ratio;
+  stats.max_ratio = max_ratio;
+  return stats;
+}
@@ -0,0 +1,65 @@
+//
+//  AudioRateControl.h
+//  Emulator
+//
+//  Dynamic rate control, which keeps the audio queue at a target latency
+//  while frames stay on the frame pacer's smooth schedule. Once per frame
+//  the queue's fill level nudges the APU's output sample rate by at most
+//  +/-0.5%: a little high when the queue is short of the target, a little
+//  low when it's long. The pitch change is inaudible, and the queue settles
+//  at the target without underrunning or the loop having to drop frames.
+//  Should the queue still pass its ceiling, the main loop waits for the
+//  device to drain it.
+//
+
+#ifndef __Emulator__AudioRateControl__
+#define __Emulator__AudioRateControl__
+
+#include <cstddef>
+#include <cstdint>
+
+struct AudioRateControlStats {
+  uint64_t frames;
+  double latency_ms;  // Queued audio when the last frame's samples went in
+  double mean_latency_ms;
+  double max_latency_ms;
+  double min_ratio;  // Range of the resampling adjustments
+  double max_ratio;
+};
+
+class AudioRateControl {
+ private:
+  double sample_rate;  // Nominal rate of the audio device
+  double target_samples;
+  double max_adjustment;
+
+  double smoothed_samples;
+  double ratio;  // Fill level adjustment to the output rate
+  double base;   // Corrects for emulated frames not being exactly NTSC length
+
+  uint64_t frames;
+  double latency_ms;
+  double total_latency_ms;
+  double max_latency_ms;
+  double min_ratio;
+  double max_ratio;
+
+ public:
+  static constexpr double kDefaultMaxAdjustment = 0.005;
+
+  AudioRateControl(double sample_rate, double target_latency_ms,
+                   double max_adjustment = kDefaultMaxAdjustment);
+
+  // The queue should never need to grow past the target plus a few frames
+  size_t get_ceiling_samples();
+
+  // Call once per frame with the samples the frame produced and the samples
+  // queued for the device (including any the device itself holds). Returns
+  // the sample rate the next frame's audio should be produced at.
+  double update(size_t frame_samples, size_t queued_samples);
+
+  double get_ratio();
+  AudioRateControlStats get_stats();
+};
+
+#endif /* defined(__Emulator__AudioRateControl__) */
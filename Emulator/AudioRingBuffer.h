@@ -0,0 +1,18 @@
+//
+//  AudioRingBuffer.h
+//  Emulator
+//
+//  Hands audio samples from the emulation thread to the audio device's
+//  callback without locking. Exactly one thread may write and one may read.
+//
+
+#ifndef __Emulator__AudioRingBuffer__
+#define __Emulator__AudioRingBuffer__
+
+#include <cstdint>
+
+#include "SPSCRing.h"
+
+typedef SPSCRing<int16_t> AudioRingBuffer;
+
+#endif /* defined(__Emulator__AudioRingBuffer__) */
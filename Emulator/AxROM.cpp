@@ -0,0 +1,37 @@
+//
+//  AxROM.cpp
+//  Emulator
+//
+
+#include "AxROM.h"
+
+static const byte kPRGBankMask = 0x07;
+static const byte kNameTableSelectMask = 0x10;
+
+void AxROM::reset() {
+  bank_register = 0;
+  Mapper::reset();
+}
+
+void AxROM::update_banks() {
+  // The 32 KB bank as two 16 KB halves, which mirror on a 16 KB ROM
+  int bank = (bank_register & kPRGBankMask) * 2;
+  map_prg_bank(0x8000, 0x4000, bank);
+  map_prg_bank(0xC000, 0x4000, bank + 1);
+  map_chr_bank(0x0000, 0x2000, 0);
+  set_mirroring(bank_register & kNameTableSelectMask
+                    ? kMirroringSingleScreenHigh
+                    : kMirroringSingleScreenLow);
+}
+
+void AxROM::write_register(dbyte address, byte value) {
+  bank_register = value;
+  update_banks();
+}
+
+void AxROM::save_state(StateWriter& writer) { writer.write(bank_register); }
+
+void AxROM::load_state(StateReader& reader) {
+  reader.read(bank_register);
+  Mapper::load_state(reader);
+}
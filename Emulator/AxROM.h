@@ -0,0 +1,30 @@
+//
+//  AxROM.h
+//  Emulator
+//
+//  Mapper 7: a switchable 32 KB PRG bank and single-screen mirroring selected
+//  by the same register.
+//
+
+#ifndef __Emulator__AxROM__
+#define __Emulator__AxROM__
+
+#include "Mapper.h"
+
+class AxROM : public Mapper {
+ private:
+  byte bank_register;
+
+  void update_banks() override;
+
+ public:
+  using Mapper::Mapper;
+
+  void reset() override;
+  void write_register(dbyte address, byte value) override;
+
+  void save_state(StateWriter& writer) override;
+  void load_state(StateReader& reader) override;
+};
+
+#endif /* defined(__Emulator__AxROM__) */
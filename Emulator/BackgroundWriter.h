@@ -0,0 +1,117 @@
+//
+//  BackgroundWriter.h
+//  Emulator
+//
+//  A thread that takes items off a bounded queue and writes them, so the
+//  threads producing them don't wait on the disk. Any number of threads may
+//  push. Items are written in the order they were pushed.
+//
+
+#ifndef __Emulator__BackgroundWriter__
+#define __Emulator__BackgroundWriter__
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+template <typename T>
+class BackgroundWriter {
+ private:
+  std::function<bool(T&)> write_item;  // Returns false if the write failed
+  size_t max_items;
+
+  std::mutex mutex;
+  std::condition_variable items_changed;
+  std::deque<T> items;
+  bool closing;
+  bool write_failed;
+  size_t max_queued;
+  uint64_t waits;
+  std::thread writer;
+
+  void write_loop() {
+    while (true) {
+      T item;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        items_changed.wait(lock, [this] { return closing || !items.empty(); });
+        if (items.empty()) {
+          return;  // Closing, and everything is written
+        }
+
+        item = std::move(items.front());
+        items.pop_front();
+        items_changed.notify_all();
+      }
+
+      bool failed = !write_item(item);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      write_failed |= failed;
+    }
+  }
+
+ public:
+  // Starts the thread. `write_item` runs on it, one item at a time.
+  BackgroundWriter(size_t max_items, std::function<bool(T&)> write_item)
+      : write_item(write_item),
+        max_items(max_items),
+        closing(false),
+        write_failed(false),
+        max_queued(0),
+        waits(0),
+        writer(&BackgroundWriter::write_loop, this) {}
+
+  ~BackgroundWriter() { close(); }
+
+  // Queues `item`, first waiting for the writer if `max_items` are queued
+  void push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (items.size() >= max_items) {
+      waits++;
+      items_changed.wait(lock, [this] { return items.size() < max_items; });
+    }
+
+    items.push_back(std::move(item));
+    max_queued = std::max(max_queued, items.size());
+    items_changed.notify_all();
+  }
+
+  // Waits for everything queued to be written and stops the thread. Returns
+  // false if any write failed.
+  bool close() {
+    if (writer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+        items_changed.notify_all();
+      }
+      writer.join();
+    }
+
+    return !write_failed;
+  }
+
+  size_t get_queued() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return items.size();
+  }
+
+  size_t get_max_queued() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_queued;
+  }
+
+  // Times a push had to wait for the writer
+  uint64_t get_waits() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return waits;
+  }
+};
+
+#endif /* defined(__Emulator__BackgroundWriter__) */
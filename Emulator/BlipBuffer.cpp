@@ -0,0 +1,128 @@
+//
+//  BlipBuffer.cpp
+//  Emulator
+//
+
+#include "BlipBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const double kPi = 3.14159265358979323846;
+
+// Pass band as a fraction of the output Nyquist frequency
+static const double kCutoff = 0.9;
+
+// Per-sample coefficient of the DC-removing high-pass filter
+static const float kHighPassRate = 1.0f / 2048;
+
+namespace {
+
+//
+// Band-limited impulses (windowed sinc), one row per sub-sample phase. A
+// delta added to the difference buffer through a row becomes a band-limited
+// step once the buffer is integrated.
+//
+template <int kPhases, int kWidth>
+struct Kernel {
+  float taps[kPhases][kWidth];
+
+  Kernel() {
+    for (int phase = 0; phase < kPhases; phase++) {
+      double sum = 0;
+      for (int i = 0; i < kWidth; i++) {
+        double x = i - kWidth / 2 - static_cast<double>(phase) / kPhases;
+        double sinc =
+            x == 0 ? 1 : std::sin(kPi * kCutoff * x) / (kPi * kCutoff * x);
+        double w = (x + kWidth / 2) / kWidth;  // 0..1 across the kernel
+        double blackman = 0.42 - 0.5 * std::cos(2 * kPi * w) +
+                          0.08 * std::cos(4 * kPi * w);
+        taps[phase][i] = static_cast<float>(sinc * blackman);
+        sum += taps[phase][i];
+      }
+
+      for (int i = 0; i < kWidth; i++) {
+        taps[phase][i] = static_cast<float>(taps[phase][i] / sum);
+      }
+    }
+  }
+};
+
+}  // namespace
+
+static const Kernel<1 << 5, 16> kernel;
+
+BlipBuffer::BlipBuffer(double clock_rate, double sample_rate,
+                       size_t max_frame_samples)
+    : deltas(max_frame_samples * 2 + kKernelWidth + 1),
+      offset(0),
+      available(0),
+      clock_rate(clock_rate),
+      sum(0),
+      high_pass(0) {
+  set_sample_rate(sample_rate);
+}
+
+void BlipBuffer::set_sample_rate(double sample_rate) {
+  this->sample_rate = sample_rate;
+  factor = static_cast<uint64_t>(sample_rate / clock_rate *
+                                 static_cast<double>(1ULL << kTimeBits));
+}
+
+void BlipBuffer::add_delta(uint32_t time, float delta) {
+  uint64_t sample_time = offset + time * factor;
+  size_t index = static_cast<size_t>(sample_time >> kTimeBits);
+  int phase = (sample_time >> (kTimeBits - kPhaseBits)) & (kPhases - 1);
+
+  if (index + kKernelWidth > deltas.size()) {
+    return;  // Frame longer than the buffer was sized for
+  }
+
+  const float* taps = kernel.taps[phase];
+  float* out = &deltas[index];
+  for (int i = 0; i < kKernelWidth; i++) {
+    out[i] += delta * taps[i];
+  }
+}
+
+void BlipBuffer::end_frame(uint32_t duration) {
+  offset += duration * factor;
+
+  // A frame longer than the buffer loses its end rather than every frame
+  // after it
+  uint64_t max_offset = static_cast<uint64_t>(deltas.size() - kKernelWidth)
+                        << kTimeBits;
+  offset = std::min(offset, max_offset);
+  available = static_cast<size_t>(offset >> kTimeBits);
+}
+
+size_t BlipBuffer::read_samples(int16_t* destination, size_t count) {
+  count = std::min(count, available);
+
+  for (size_t i = 0; i < count; i++) {
+    sum += deltas[i];
+    high_pass += (sum - high_pass) * kHighPassRate;
+
+    float sample = (sum - high_pass) * 32767;
+    destination[i] = static_cast<int16_t>(
+        std::max(-32768.0f, std::min(32767.0f, sample)));
+  }
+
+  // Shift the rest (including the tail of the kernels) to the front
+  size_t remaining = deltas.size() - count;
+  std::memmove(deltas.data(), deltas.data() + count, remaining * sizeof(float));
+  std::fill(deltas.begin() + remaining, deltas.end(), 0.0f);
+
+  available -= count;
+  offset -= static_cast<uint64_t>(count) << kTimeBits;
+  return count;
+}
+
+void BlipBuffer::clear() {
+  std::fill(deltas.begin(), deltas.end(), 0.0f);
+  offset = 0;
+  available = 0;
+  sum = 0;
+  high_pass = 0;
+}
@@ -0,0 +1,58 @@
+//
+//  BlipBuffer.h
+//  Emulator
+//
+//  Band-limited resampling of a square-edged signal. Instead of stepping
+//  every channel at the CPU clock rate and filtering, callers add the
+//  amplitude changes (deltas) at their clock times. Each delta is spread
+//  over a few output samples with a band-limited step, which removes the
+//  aliasing naive point sampling would cause.
+//
+
+#ifndef __Emulator__BlipBuffer__
+#define __Emulator__BlipBuffer__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BlipBuffer {
+ private:
+  static const int kPhaseBits = 5;
+  static const int kPhases = 1 << kPhaseBits;  // Sub-sample step positions
+  static const int kKernelWidth = 16;          // Samples touched per delta
+  static const int kTimeBits = 32;             // Fraction bits of sample times
+
+  std::vector<float> deltas;  // Unread samples, then the current frame
+
+  uint64_t factor;  // Output samples per clock, fixed point
+  uint64_t offset;  // Sample time of the start of the current frame
+  size_t available;
+
+  double clock_rate;
+  double sample_rate;
+
+  float sum;         // Integrator
+  float high_pass;   // DC estimate removed from the output
+
+ public:
+  // `max_frame_samples` bounds the samples produced by one frame
+  BlipBuffer(double clock_rate, double sample_rate, size_t max_frame_samples);
+
+  // `sample_rate` may be changed between frames to adjust the ratio
+  void set_sample_rate(double sample_rate);
+  double get_sample_rate() { return sample_rate; }
+
+  // `time` is in clocks since the start of the frame
+  void add_delta(uint32_t time, float delta);
+
+  // Ends the current frame `duration` clocks after it started, making its
+  // samples available
+  void end_frame(uint32_t duration);
+
+  size_t samples_available() { return available; }
+  size_t read_samples(int16_t* destination, size_t count);
+  void clear();
+};
+
+#endif /* defined(__Emulator__BlipBuffer__) */
@@ -0,0 +1,29 @@
+//
+//  CNROM.cpp
+//  Emulator
+//
+
+#include "CNROM.h"
+
+void CNROM::reset() {
+  chr_bank = 0;
+  Mapper::reset();
+}
+
+void CNROM::update_banks() {
+  map_prg_bank(0x8000, 0x4000, 0);
+  map_prg_bank(0xC000, 0x4000, -1);
+  map_chr_bank(0x0000, 0x2000, chr_bank);
+}
+
+void CNROM::write_register(dbyte address, byte value) {
+  chr_bank = value;
+  map_chr_bank(0x0000, 0x2000, chr_bank);
+}
+
+void CNROM::save_state(StateWriter& writer) { writer.write(chr_bank); }
+
+void CNROM::load_state(StateReader& reader) {
+  reader.read(chr_bank);
+  Mapper::load_state(reader);
+}
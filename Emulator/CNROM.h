@@ -0,0 +1,29 @@
+//
+//  CNROM.h
+//  Emulator
+//
+//  Mapper 3: fixed PRG, one switchable 8 KB CHR bank.
+//
+
+#ifndef __Emulator__CNROM__
+#define __Emulator__CNROM__
+
+#include "Mapper.h"
+
+class CNROM : public Mapper {
+ private:
+  byte chr_bank;
+
+  void update_banks() override;
+
+ public:
+  using Mapper::Mapper;
+
+  void reset() override;
+  void write_register(dbyte address, byte value) override;
+
+  void save_state(StateWriter& writer) override;
+  void load_state(StateReader& reader) override;
+};
+
+#endif /* defined(__Emulator__CNROM__) */
@@ -0,0 +1,101 @@
+//
+//  CheatTable.cpp
+//  Emulator
+//
+//  Game Genie letters each encode 4 bits, which the code scrambles across
+//  the address, value and compare bytes:
+//  http://wiki.nesdev.com/w/index.php/Game_Genie
+//
+
+#include "CheatTable.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+static const char kGameGenieLetters[] = "APZLGITYEOXUKSVN";
+
+static bool parse_hex(const std::string& text, unsigned long maximum,
+                      unsigned long* value) {
+  if (text.empty() || text.size() > 4) {
+    return false;
+  }
+
+  char* end;
+  *value = strtoul(text.c_str(), &end, 16);
+  return *end == '\0' && *value <= maximum;
+}
+
+static Cheat parse_game_genie(const std::string& code) {
+  int n[8];
+  for (size_t i = 0; i < code.size(); i++) {
+    const char* letter =
+        strchr(kGameGenieLetters, toupper(static_cast<unsigned char>(code[i])));
+    if (!letter || !*letter) {
+      throw "Invalid cheat code.";
+    }
+    n[i] = static_cast<int>(letter - kGameGenieLetters);
+  }
+
+  Cheat cheat;
+  cheat.code = code;
+  cheat.address = 0x8000 | (n[3] & 7) << 12 | (n[5] & 7) << 8 |
+                  (n[4] & 8) << 8 | (n[2] & 7) << 4 | (n[1] & 8) << 4 |
+                  (n[4] & 7) | (n[3] & 8);
+  cheat.enabled = true;
+
+  if (code.size() == 6) {
+    cheat.value = (n[1] & 7) << 4 | (n[0] & 8) << 4 | (n[0] & 7) | (n[5] & 8);
+    cheat.compare = -1;
+  } else {
+    cheat.value = (n[1] & 7) << 4 | (n[0] & 8) << 4 | (n[0] & 7) | (n[7] & 8);
+    cheat.compare =
+        (n[7] & 7) << 4 | (n[6] & 8) << 4 | (n[6] & 7) | (n[5] & 8);
+  }
+
+  return cheat;
+}
+
+Cheat CheatTable::parse(std::string code) {
+  size_t colon = code.find(':');
+  if (colon == std::string::npos) {
+    if (code.size() != 6 && code.size() != 8) {
+      throw "Invalid cheat code.";
+    }
+    return parse_game_genie(code);
+  }
+
+  // AAAA:VV or AAAA?CC:VV
+  size_t question = code.find('?');
+  unsigned long address, value, compare;
+  bool compared = question != std::string::npos && question < colon;
+  if (!parse_hex(code.substr(0, compared ? question : colon), 0xFFFF,
+                 &address) ||
+      !parse_hex(code.substr(colon + 1), 0xFF, &value) ||
+      (compared && !parse_hex(code.substr(question + 1, colon - question - 1),
+                              0xFF, &compare))) {
+    throw "Invalid cheat code.";
+  }
+
+  Cheat cheat;
+  cheat.code = code;
+  cheat.address = address;
+  cheat.value = value;
+  cheat.compare = compared ? static_cast<int>(compare) : -1;
+  cheat.enabled = true;
+  return cheat;
+}
+
+void CheatTable::add(std::string code) { cheats.push_back(parse(code)); }
+
+void CheatTable::remove(size_t index) {
+  cheats.erase(cheats.begin() + index);
+}
+
+void CheatTable::set_enabled(size_t index, bool enabled) {
+  cheats[index].enabled = enabled;
+}
+
+void CheatTable::clear() { cheats.clear(); }
+
+const std::vector<Cheat>& CheatTable::get_cheats() { return cheats; }
@@ -0,0 +1,44 @@
+//
+//  CheatTable.h
+//  Emulator
+//
+//  Game Genie codes and raw patches. Cheats on PRG ROM ($8000 and up)
+//  change what the CPU reads there; the processor maps patched copies of
+//  just the affected pages. Cheats below $8000 are written to RAM at the
+//  start of every frame.
+//
+
+#ifndef __Emulator__CheatTable__
+#define __Emulator__CheatTable__
+
+#include <string>
+#include <vector>
+
+#include "defines.h"
+
+struct Cheat {
+  std::string code;  // As entered
+  dbyte address;
+  byte value;
+  int compare;  // ROM cheats only apply where the ROM holds this; -1 for any
+  bool enabled;
+};
+
+class CheatTable {
+ private:
+  std::vector<Cheat> cheats;
+
+ public:
+  // Accepts 6 and 8 letter Game Genie codes, and raw patches written as
+  // AAAA:VV or AAAA?CC:VV (hex address, value and compare value). Throws if
+  // the code is malformed.
+  static Cheat parse(std::string code);
+
+  void add(std::string code);
+  void remove(size_t index);
+  void set_enabled(size_t index, bool enabled);
+  void clear();
+  const std::vector<Cheat>& get_cheats();
+};
+
+#endif /* defined(__Emulator__CheatTable__) */
@@ -0,0 +1,165 @@
+//
+//  Checksums.cpp
+//  Emulator
+//
+//  CRC32 uses slicing-by-8: eight table lookups per 8-byte word, which
+//  removes the byte-at-a-time dependency chain of the classic algorithm and
+//  runs several times faster.
+//
+
+#include "Checksums.h"
+
+#include <cstring>
+
+static const uint32_t kCRC32Polynomial = 0xEDB88320;
+
+namespace {
+
+struct CRC32Tables {
+  uint32_t table[8][256];
+
+  CRC32Tables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = crc & 1 ? (crc >> 1) ^ kCRC32Polynomial : crc >> 1;
+      }
+      table[0][i] = crc;
+    }
+
+    for (int slice = 1; slice < 8; slice++) {
+      for (int i = 0; i < 256; i++) {
+        uint32_t previous = table[slice - 1][i];
+        table[slice][i] = (previous >> 8) ^ table[0][previous & 0xFF];
+      }
+    }
+  }
+};
+
+const CRC32Tables crc32_tables;
+
+inline uint32_t load_le32(const byte* data) {
+  return data[0] | data[1] << 8 | data[2] << 16 |
+         static_cast<uint32_t>(data[3]) << 24;
+}
+
+inline uint32_t load_be32(const byte* data) {
+  return static_cast<uint32_t>(data[0]) << 24 | data[1] << 16 | data[2] << 8 |
+         data[3];
+}
+
+inline uint32_t rotate_left(uint32_t value, int bits) {
+  return value << bits | value >> (32 - bits);
+}
+
+}  // namespace
+
+uint32_t crc32(const byte* data, size_t length, uint32_t crc) {
+  const uint32_t(*table)[256] = crc32_tables.table;
+  crc = ~crc;
+
+  for (; length >= 8; data += 8, length -= 8) {
+    uint32_t low = load_le32(data) ^ crc;
+    uint32_t high = load_le32(data + 4);
+    crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+          table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+          table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+          table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+  }
+
+  for (; length; data++, length--) {
+    crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+  }
+
+  return ~crc;
+}
+
+static void sha1_block(uint32_t state[5], const byte* block) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = load_be32(block + i * 4);
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+           e = state[4];
+
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+
+    uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotate_left(b, 30);
+    b = a;
+    a = temp;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+SHA1Digest sha1(const byte* data, size_t length) {
+  uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                       0xC3D2E1F0};
+
+  size_t full_blocks = length / 64;
+  for (size_t i = 0; i < full_blocks; i++) {
+    sha1_block(state, data + i * 64);
+  }
+
+  // Pad with a 1 bit, zeros, and the message length in bits
+  byte tail[128] = {};
+  size_t remaining = length - full_blocks * 64;
+  ::memcpy(tail, data + full_blocks * 64, remaining);
+  tail[remaining] = 0x80;
+
+  size_t tail_length = remaining < 56 ? 64 : 128;
+  uint64_t bits = static_cast<uint64_t>(length) * 8;
+  for (int i = 0; i < 8; i++) {
+    tail[tail_length - 1 - i] = static_cast<byte>(bits >> (i * 8));
+  }
+
+  sha1_block(state, tail);
+  if (tail_length == 128) {
+    sha1_block(state, tail + 64);
+  }
+
+  SHA1Digest digest;
+  for (int i = 0; i < 5; i++) {
+    digest[i * 4] = state[i] >> 24;
+    digest[i * 4 + 1] = state[i] >> 16;
+    digest[i * 4 + 2] = state[i] >> 8;
+    digest[i * 4 + 3] = state[i];
+  }
+  return digest;
+}
+
+std::string to_hex(const SHA1Digest& digest) {
+  static const char kHexDigits[] = "0123456789abcdef";
+
+  std::string hex;
+  for (byte value : digest) {
+    hex += kHexDigits[value >> 4];
+    hex += kHexDigits[value & 0x0F];
+  }
+  return hex;
+}
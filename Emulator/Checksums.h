@@ -0,0 +1,27 @@
+//
+//  Checksums.h
+//  Emulator
+//
+//  CRC32 and SHA-1, for identifying ROMs against compatibility databases.
+//
+
+#ifndef __Emulator__Checksums__
+#define __Emulator__Checksums__
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "defines.h"
+
+typedef std::array<byte, 20> SHA1Digest;
+
+// CRC-32 (the zlib / PNG polynomial). Pass a previous result as `crc` to
+// continue a checksum across several buffers.
+uint32_t crc32(const byte* data, size_t length, uint32_t crc = 0);
+
+SHA1Digest sha1(const byte* data, size_t length);
+
+std::string to_hex(const SHA1Digest& digest);
+
+#endif /* defined(__Emulator__Checksums__) */
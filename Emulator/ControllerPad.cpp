@@ -8,7 +8,20 @@
 
 #include "ControllerPad.h"
 
-ControllerPad::ControllerPad() {
+#include <algorithm>
+
+ControllerPad::ControllerPad()
+    : input_queue(nullptr),
+      sub_frame_input(true),
+      input_events(0),
+      total_latency(0),
+      max_latency(0) {
+  reset();
+}
+
+void ControllerPad::reset() {
+  current_read_key = 0;
+  previous_value = 0;
   controller_1_select = false;
   controller_1_start = false;
   controller_1_a = false;
@@ -17,6 +30,8 @@ ControllerPad::ControllerPad() {
   controller_1_up = false;
   controller_1_right = false;
   controller_1_down = false;
+  controller_2_buttons = 0;
+  controller_2_read_key = 0;
 }
 
 byte ControllerPad::read_controller_1_state() {
@@ -45,18 +60,118 @@ byte ControllerPad::read_controller_1_state() {
 }
 
 byte ControllerPad::read_controller_2_state() {
-  // TODO
-  return 0;
+  if (controller_2_read_key >= 8) {
+    return 0x01;
+  }
+
+  return (controller_2_buttons >> controller_2_read_key++) & 0x01;
 }
 
 void ControllerPad::write_value(byte value) {
   if (value == 0x00 && previous_value == 0x01) {
+    // The controller latches its buttons as the strobe falls; bring them up
+    // to date first
+    if (input_queue && sub_frame_input) {
+      drain_input_events(true);
+    }
     current_read_key = 0;
+    controller_2_read_key = 0;
   }
 
   previous_value = value;
 }
 
+byte ControllerPad::get_controller_1_buttons() {
+  return (controller_1_a ? 0x01 : 0x00) | (controller_1_b ? 0x02 : 0x00) |
+         (controller_1_select ? 0x04 : 0x00) |
+         (controller_1_start ? 0x08 : 0x00) | (controller_1_up ? 0x10 : 0x00) |
+         (controller_1_down ? 0x20 : 0x00) | (controller_1_left ? 0x40 : 0x00) |
+         (controller_1_right ? 0x80 : 0x00);
+}
+
+void ControllerPad::set_controller_1_buttons(byte buttons) {
+  controller_1_a = buttons & 0x01;
+  controller_1_b = buttons & 0x02;
+  controller_1_select = buttons & 0x04;
+  controller_1_start = buttons & 0x08;
+  controller_1_up = buttons & 0x10;
+  controller_1_down = buttons & 0x20;
+  controller_1_left = buttons & 0x40;
+  controller_1_right = buttons & 0x80;
+}
+
+byte ControllerPad::get_controller_2_buttons() { return controller_2_buttons; }
+
+void ControllerPad::set_controller_2_buttons(byte buttons) {
+  controller_2_buttons = buttons;
+}
+
+void ControllerPad::set_input_queue(InputEventQueue* queue) {
+  input_queue = queue;
+}
+
+void ControllerPad::set_sub_frame_input(bool enabled) {
+  sub_frame_input = enabled;
+}
+
+void ControllerPad::drain_input_events(bool apply) {
+  if (!input_queue) {
+    return;
+  }
+
+  input_queue->run_poll_callback();
+
+  uint64_t now = InputEventQueue::now();
+  InputEvent event;
+  while (input_queue->pop(now, event)) {
+    if (!apply) {
+      continue;
+    }
+
+    if (event.controller == 0) {
+      set_button(event.button, event.pressed);
+    } else {
+      controller_2_buttons = event.pressed
+                                 ? controller_2_buttons | event.button
+                                 : controller_2_buttons & ~event.button;
+    }
+
+    uint64_t latency = now - event.time;
+    input_events++;
+    total_latency += latency;
+    max_latency = std::max(max_latency, latency);
+  }
+}
+
+InputLatencyStats ControllerPad::get_input_latency() {
+  InputLatencyStats stats;
+  stats.events = input_events;
+  stats.mean_ms = input_events ? total_latency / 1e6 / input_events : 0;
+  stats.max_ms = max_latency / 1e6;
+  return stats;
+}
+
+void ControllerPad::set_button(byte button, bool pressed) {
+  byte buttons = get_controller_1_buttons();
+  set_controller_1_buttons(pressed ? buttons | button : buttons & ~button);
+}
+
+void ControllerPad::save_state(StateWriter& writer) {
+  writer.write(current_read_key);
+  writer.write(previous_value);
+  writer.write(get_controller_1_buttons());
+  writer.write(controller_2_buttons);
+  writer.write(controller_2_read_key);
+}
+
+void ControllerPad::load_state(StateReader& reader) {
+  reader.read(current_read_key);
+  reader.read(previous_value);
+  set_controller_1_buttons(reader.read<byte>());
+  reader.read(controller_2_buttons);
+  reader.read(controller_2_read_key);
+}
+
 bool ControllerPad::record_key_down(SDL_Keysym sym) {
   return record_key_private(sym, true);
 }
@@ -66,40 +181,34 @@ bool ControllerPad::record_key_up(SDL_Keysym sym) {
 }
 
 bool ControllerPad::record_key_private(SDL_Keysym sym, bool value) {
-  switch (sym.scancode) {
-    case SDL_SCANCODE_TAB:
-      controller_1_select = value;
-      return true;
-
-    case SDL_SCANCODE_RETURN:
-      controller_1_start = value;
-      return true;
-
-    case SDL_SCANCODE_LEFT:
-      controller_1_left = value;
-      return true;
-
-    case SDL_SCANCODE_RIGHT:
-      controller_1_right = value;
-      return true;
-
-    case SDL_SCANCODE_UP:
-      controller_1_up = value;
-      return true;
+  byte button = button_for_scancode(sym.scancode);
+  if (!button) {
+    return false;
+  }
 
-    case SDL_SCANCODE_DOWN:
-      controller_1_down = value;
-      return true;
+  set_button(button, value);
+  return true;
+}
 
+byte ControllerPad::button_for_scancode(SDL_Scancode scancode) {
+  switch (scancode) {
     case SDL_SCANCODE_Z:
-      controller_1_a = value;
-      return true;
-
+      return 0x01;  // A
     case SDL_SCANCODE_X:
-      controller_1_b = value;
-      return true;
-
+      return 0x02;  // B
+    case SDL_SCANCODE_TAB:
+      return 0x04;  // Select
+    case SDL_SCANCODE_RETURN:
+      return 0x08;  // Start
+    case SDL_SCANCODE_UP:
+      return 0x10;
+    case SDL_SCANCODE_DOWN:
+      return 0x20;
+    case SDL_SCANCODE_LEFT:
+      return 0x40;
+    case SDL_SCANCODE_RIGHT:
+      return 0x80;
     default:
-      return false;
+      return 0;
   }
 }
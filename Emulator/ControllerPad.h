@@ -9,9 +9,20 @@
 #ifndef __Emulator__ControllerPad__
 #define __Emulator__ControllerPad__
 
+#include <cstdint>
+
+#include "InputEventQueue.h"
 #include "SDL.h"
+#include "SaveState.h"
 #include "defines.h"
 
+// Time from an input event to the game strobing the controller after it
+struct InputLatencyStats {
+  uint64_t events;
+  double mean_ms;
+  double max_ms;
+};
+
 class ControllerPad {
  private:
   int current_read_key;
@@ -26,13 +37,53 @@ class ControllerPad {
   bool controller_1_right;
   bool controller_1_down;
 
+  // Controller 2 has no keyboard mapping; netplay drives it
+  byte controller_2_buttons;
+  int controller_2_read_key;
+
+  InputEventQueue* input_queue;
+  bool sub_frame_input;  // Whether strobes drain the queue
+
+  uint64_t input_events;
+  uint64_t total_latency;  // Nanoseconds
+  uint64_t max_latency;
+
   bool record_key_private(SDL_Keysym sym, bool value);
+  void set_button(byte button, bool pressed);
 
  public:
   ControllerPad();
+
+  // Clears the controller, but keeps the input queue and its statistics
+  void reset();
+
   bool record_key_down(SDL_Keysym sym);
   bool record_key_up(SDL_Keysym sym);
 
+  // The controller 1 button a key is mapped to, or 0 if none
+  static byte button_for_scancode(SDL_Scancode scancode);
+
+  // Events from `queue` are applied when the game strobes the controller,
+  // or when drain_input_events is called. Pass nullptr to go back to
+  // record_key_down / record_key_up.
+  void set_input_queue(InputEventQueue* queue);
+  void set_sub_frame_input(bool enabled);
+
+  // Takes every event that has happened so far off the queue, applying
+  // them unless `apply` is false
+  void drain_input_events(bool apply);
+  InputLatencyStats get_input_latency();
+
+  // Controller 1 buttons packed one bit per button, in the order the NES
+  // reads them: bit 0 = A, B, Select, Start, Up, Down, Left, bit 7 = Right.
+  byte get_controller_1_buttons();
+  void set_controller_1_buttons(byte buttons);
+  byte get_controller_2_buttons();
+  void set_controller_2_buttons(byte buttons);
+
+  void save_state(StateWriter& writer);
+  void load_state(StateReader& reader);
+
   byte read_controller_1_state();
   byte read_controller_2_state();
   void write_value(byte value);
@@ -0,0 +1,122 @@
+//
+//  CpuTrace.cpp
+//  Emulator
+//
+
+#include "CpuTrace.h"
+
+static const size_t kBlockRecords = 1 << 16;  // 1.5 MB
+
+// Blocks a thread may get ahead of the disk by before it waits
+static const size_t kMaxQueuedBlocks = 8;
+
+std::atomic<bool> CpuTrace::enabled(false);
+
+CpuTrace::CpuTrace()
+    : next_thread_id(1), session(0), file(nullptr), records_written(0) {}
+
+CpuTrace& CpuTrace::instance() {
+  static CpuTrace trace;
+  return trace;
+}
+
+void CpuTrace::start(std::string filename) {
+  if (is_enabled()) {
+    stop();
+  }
+
+  file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    throw "Could not open CPU trace file for writing.";
+  }
+
+  uint32_t record_size = sizeof(CpuTraceRecord);
+  fwrite(kCpuTraceMagic, 1, sizeof(kCpuTraceMagic), file);
+  fwrite(&kCpuTraceVersion, sizeof(kCpuTraceVersion), 1, file);
+  fwrite(&record_size, sizeof(record_size), 1, file);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    thread_blocks.clear();
+    session++;
+  }
+
+  records_written = 0;
+  writer = std::make_unique<BackgroundWriter<Block>>(
+      kMaxQueuedBlocks, [this](Block& block) { return write_block(block); });
+  enabled = true;
+}
+
+void CpuTrace::stop() {
+  if (!is_enabled()) {
+    return;
+  }
+  enabled = false;
+
+  std::vector<std::shared_ptr<Block>> blocks;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    blocks.swap(thread_blocks);
+  }
+  for (auto& block : blocks) {
+    if (!block->records.empty()) {
+      writer->push(std::move(*block));
+    }
+  }
+
+  bool written = writer->close();
+  bool failed = fclose(file) != 0 || !written;
+  file = nullptr;
+  if (failed) {
+    throw "Could not write CPU trace.";
+  }
+}
+
+CpuTrace::Block* CpuTrace::block_for_current_thread() {
+  thread_local std::shared_ptr<Block> block;
+  thread_local uint64_t block_session = 0;
+
+  if (!block || block_session != session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    block = std::make_shared<Block>();
+    block->thread_id = next_thread_id++;
+    block->records.reserve(kBlockRecords);
+    thread_blocks.push_back(block);
+    block_session = session;
+  }
+
+  return block.get();
+}
+
+void CpuTrace::record(const CpuTraceRecord& record) {
+  Block* block = block_for_current_thread();
+  block->records.push_back(record);
+
+  if (block->records.size() == kBlockRecords) {
+    flush_block(block);
+  }
+}
+
+void CpuTrace::flush_block(Block* block) {
+  writer->push({block->thread_id, std::move(block->records)});
+  block->records = std::vector<CpuTraceRecord>();
+  block->records.reserve(kBlockRecords);
+}
+
+bool CpuTrace::write_block(Block& block) {
+  uint32_t header[2] = {block.thread_id,
+                        static_cast<uint32_t>(block.records.size())};
+  bool written =
+      fwrite(header, sizeof(header), 1, file) == 1 &&
+      fwrite(block.records.data(), sizeof(CpuTraceRecord),
+             block.records.size(), file) == block.records.size();
+
+  records_written += block.records.size();
+  return written;
+}
+
+uint64_t CpuTrace::get_records_written() { return records_written; }
+
+uint64_t CpuTrace::get_writer_waits() {
+  return writer ? writer->get_waits() : 0;
+}
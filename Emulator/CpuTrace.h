@@ -0,0 +1,91 @@
+//
+//  CpuTrace.h
+//  Emulator
+//
+//  Records every instruction the CPU executes as a fixed-size binary record.
+//  Each thread fills its own block of records; full blocks go to a
+//  background thread that writes them, so tracing costs a copy per
+//  instruction rather than formatted output. When tracing is off, the
+//  processor runs an execute loop with the recording compiled out.
+//
+//  File format: "NESTRACE", a uint32 version and a uint32 record size, then
+//  blocks of a uint32 thread id, a uint32 record count and the records.
+//  Everything is in host byte order, like save states.
+//
+
+#ifndef __Emulator__CpuTrace__
+#define __Emulator__CpuTrace__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BackgroundWriter.h"
+#include "defines.h"
+
+// The state before the instruction at `pc` runs
+struct CpuTraceRecord {
+  uint64_t cycle;  // CPU cycles since power on
+  dbyte pc;
+  byte opcode;
+  byte operands[2];  // Whether they're used depends on the opcode
+  byte a;
+  byte x;
+  byte y;
+  byte p;
+  byte s;
+  byte reserved[3];
+};
+
+static_assert(sizeof(CpuTraceRecord) == 24, "Trace records are 24 bytes");
+
+const char kCpuTraceMagic[8] = {'N', 'E', 'S', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t kCpuTraceVersion = 1;
+
+class CpuTrace {
+ private:
+  struct Block {
+    uint32_t thread_id;
+    std::vector<CpuTraceRecord> records;
+  };
+
+  static std::atomic<bool> enabled;
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Block>> thread_blocks;  // Being filled
+  uint32_t next_thread_id;
+  uint64_t session;  // Tells threads their block is from an earlier trace
+
+  FILE* file;
+  std::unique_ptr<BackgroundWriter<Block>> writer;
+  std::atomic<uint64_t> records_written;
+
+  CpuTrace();
+
+  Block* block_for_current_thread();
+  void flush_block(Block* block);
+  bool write_block(Block& block);
+
+ public:
+  static CpuTrace& instance();
+
+  static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+  // Throws if the file can't be created
+  void start(std::string filename);
+
+  // Writes what every thread has recorded. Call it once the threads that
+  // trace have stopped running instructions. Throws if a write failed.
+  void stop();
+
+  void record(const CpuTraceRecord& record);
+
+  uint64_t get_records_written();
+  uint64_t get_writer_waits();
+};
+
+#endif /* defined(__Emulator__CpuTrace__) */
@@ -0,0 +1,265 @@
+//
+//  Debugger.cpp
+//  Emulator
+//
+
+#include "Debugger.h"
+
+#include "Processor.h"
+
+static const byte kJSR = 0x20;
+
+// The address that `address` mirrors: CPU RAM repeats every 2 KB up to
+// $2000 and the PPU registers every 8 bytes up to $4000
+static dbyte canonical_address(dbyte address) {
+  if (address < 0x2000) {
+    return address & 0x07FF;
+  } else if (address < 0x4000) {
+    return 0x2000 | (address & 0x07);
+  }
+  return address;
+}
+
+Debugger::Debugger()
+    : processor(nullptr),
+      breakpoint_count(0),
+      watch_count(0),
+      mode(kRun),
+      step_over_return(0),
+      step_over_stack(0),
+      target_scanline(0),
+      stopped(false),
+      skip_breakpoint(false),
+      stop_reason(kStopNone),
+      stop_address(0) {}
+
+void Debugger::attach(Processor* processor) {
+  if (this->processor) {
+    for (int page = 0; page < 256; page++) {
+      this->processor->watch_page(page, false);
+    }
+    this->processor->watcher = nullptr;
+  }
+
+  // Watchpoints set before attaching take effect now
+  this->processor = processor;
+  for (int page = 0; processor && page < 256; page++) {
+    update_watches(page);
+  }
+}
+
+void Debugger::stop(StopReason reason, dbyte address) {
+  stopped = true;
+  stop_reason = reason;
+  stop_address = address;
+  mode = kRun;
+
+  // Watchpoints fire in the fast execute loop, which ends its run once the
+  // current instruction finishes
+  if (processor) {
+    processor->end_run();
+  }
+}
+
+// Unmaps `page` from the processor's fast path while any address in it, or
+// any address it mirrors, is watched
+void Debugger::update_watches(dbyte page) {
+  if (!processor) {
+    return;
+  }
+
+  bool watched = false;
+  for (int address = page << 8; address < (page + 1) << 8; address++) {
+    dbyte watch = canonical_address(address);
+    watched |= cpu_read_watches[watch] || cpu_write_watches[watch];
+  }
+
+  processor->watch_page(page, watched);
+  update_hooks();
+}
+
+// Updates every page that holds a mirror of `address`
+void Debugger::update_mirrored_watches(dbyte address) {
+  if (address < 0x2000) {
+    for (int page = (address >> 8) & 0x07; page < 0x20; page += 0x08) {
+      update_watches(page);
+    }
+  } else if (address < 0x4000) {
+    for (int page = 0x20; page < 0x40; page++) {
+      update_watches(page);
+    }
+  } else {
+    update_watches(address >> 8);
+  }
+}
+
+// The processor reports accesses only while something is watched
+void Debugger::update_hooks() {
+  if (processor) {
+    processor->watcher = watch_count > 0 ? this : nullptr;
+  }
+}
+
+void Debugger::add_breakpoint(dbyte address) {
+  if (!breakpoints[address]) {
+    breakpoints[address] = true;
+    breakpoint_count++;
+  }
+}
+
+void Debugger::remove_breakpoint(dbyte address) {
+  if (breakpoints[address]) {
+    breakpoints[address] = false;
+    breakpoint_count--;
+  }
+}
+
+void Debugger::add_watchpoint(dbyte address, bool reads, bool writes) {
+  address = canonical_address(address);
+  remove_watchpoint(address);
+  if (reads || writes) {
+    cpu_read_watches[address] = reads;
+    cpu_write_watches[address] = writes;
+    watch_count++;
+  }
+  update_mirrored_watches(address);
+}
+
+void Debugger::remove_watchpoint(dbyte address) {
+  address = canonical_address(address);
+  if (cpu_read_watches[address] || cpu_write_watches[address]) {
+    cpu_read_watches[address] = false;
+    cpu_write_watches[address] = false;
+    watch_count--;
+  }
+  update_mirrored_watches(address);
+}
+
+void Debugger::add_ppu_watchpoint(dbyte address, bool reads, bool writes) {
+  address &= kPPUAddressSpace - 1;
+  remove_ppu_watchpoint(address);
+  if (reads || writes) {
+    ppu_read_watches[address] = reads;
+    ppu_write_watches[address] = writes;
+    watch_count++;
+  }
+  update_hooks();
+}
+
+void Debugger::remove_ppu_watchpoint(dbyte address) {
+  address &= kPPUAddressSpace - 1;
+  if (ppu_read_watches[address] || ppu_write_watches[address]) {
+    ppu_read_watches[address] = false;
+    ppu_write_watches[address] = false;
+    watch_count--;
+  }
+  update_hooks();
+}
+
+void Debugger::clear() {
+  breakpoints.reset();
+  cpu_read_watches.reset();
+  cpu_write_watches.reset();
+  ppu_read_watches.reset();
+  ppu_write_watches.reset();
+  breakpoint_count = 0;
+  watch_count = 0;
+
+  for (int page = 0; page < 256; page++) {
+    update_watches(page);
+  }
+}
+
+void Debugger::resume() {
+  // A stop before an instruction mustn't stop again on the same one
+  skip_breakpoint = stopped && (stop_reason == kStopBreakpoint ||
+                                stop_reason == kStopStep);
+  stopped = false;
+  stop_reason = kStopNone;
+}
+
+void Debugger::step() {
+  resume();
+  mode = kStepInto;
+}
+
+void Debugger::step_over() {
+  resume();
+  if (processor->peek_memory(processor->pc) == kJSR) {
+    mode = kStepOver;
+    step_over_return = processor->pc + 3;
+    step_over_stack = processor->s;
+  } else {
+    mode = kStepInto;
+  }
+}
+
+void Debugger::run_to_scanline(int scanline) {
+  resume();
+  mode = kRunToScanline;
+  target_scanline = scanline;
+}
+
+bool Debugger::is_stopped() { return stopped; }
+
+StopReason Debugger::get_stop_reason() { return stop_reason; }
+
+dbyte Debugger::get_stop_address() { return stop_address; }
+
+// Watchpoints alone don't need it: their pages are unmapped, so accesses to
+// them are checked on the I/O path
+bool Debugger::is_active() {
+  return stopped || mode != kRun || breakpoint_count > 0;
+}
+
+bool Debugger::should_stop_before(dbyte pc, byte s) {
+  if (stopped) {
+    return true;
+  }
+
+  if (skip_breakpoint) {
+    skip_breakpoint = false;
+    return false;
+  }
+
+  if (mode == kStepInto ||
+      (mode == kStepOver && pc == step_over_return && s == step_over_stack)) {
+    stop(kStopStep, pc);
+  } else if (breakpoints[pc]) {
+    stop(kStopBreakpoint, pc);
+  }
+
+  return stopped;
+}
+
+bool Debugger::should_stop_at_scanline(int scanline) {
+  if (mode == kRunToScanline && scanline == target_scanline) {
+    stop(kStopScanline, processor->pc);
+  }
+
+  return stopped;
+}
+
+void Debugger::check_cpu_read(dbyte address) {
+  if (cpu_read_watches[canonical_address(address)]) {
+    stop(kStopCPURead, address);
+  }
+}
+
+void Debugger::check_cpu_write(dbyte address) {
+  if (cpu_write_watches[canonical_address(address)]) {
+    stop(kStopCPUWrite, address);
+  }
+}
+
+void Debugger::check_ppu_read(dbyte address) {
+  if (ppu_read_watches[address & (kPPUAddressSpace - 1)]) {
+    stop(kStopPPURead, address);
+  }
+}
+
+void Debugger::check_ppu_write(dbyte address) {
+  if (ppu_write_watches[address & (kPPUAddressSpace - 1)]) {
+    stop(kStopPPUWrite, address);
+  }
+}
@@ -0,0 +1,104 @@
+//
+//  Debugger.h
+//  Emulator
+//
+//  Breakpoints, watchpoints and stepping for the CPU. Nothing here costs
+//  anything until it's used: PC breakpoints and stepping switch the emulator
+//  to a separately compiled execute loop, and watchpoints only unmap the
+//  pages they cover (with their mirrors), so accesses to those pages (and
+//  only those) take the slow I/O path where they are checked.
+//
+//  A stop takes effect between instructions. Breakpoints and steps stop
+//  before the instruction at the PC runs; watchpoints stop after the
+//  instruction that made the access. emulate_frame returns early when the
+//  debugger stops and picks up mid-frame once it is resumed.
+//
+
+#ifndef __Emulator__Debugger__
+#define __Emulator__Debugger__
+
+#include <bitset>
+
+#include "defines.h"
+
+class Processor;
+
+enum StopReason {
+  kStopNone,
+  kStopBreakpoint,
+  kStopStep,
+  kStopScanline,
+  kStopCPURead,
+  kStopCPUWrite,
+  kStopPPURead,  // Through $2007
+  kStopPPUWrite,
+};
+
+class Debugger {
+ private:
+  enum RunMode { kRun, kStepInto, kStepOver, kRunToScanline };
+
+  static const int kPPUAddressSpace = 0x4000;
+
+  Processor* processor;
+
+  std::bitset<0x10000> breakpoints;
+  std::bitset<0x10000> cpu_read_watches;
+  std::bitset<0x10000> cpu_write_watches;
+  std::bitset<kPPUAddressSpace> ppu_read_watches;
+  std::bitset<kPPUAddressSpace> ppu_write_watches;
+  int breakpoint_count;
+  int watch_count;  // CPU and PPU addresses with any watch
+
+  RunMode mode;
+  dbyte step_over_return;  // Where the stepped-over JSR returns to
+  byte step_over_stack;
+  int target_scanline;
+
+  bool stopped;
+  bool skip_breakpoint;  // Resuming from a stop before this PC
+  StopReason stop_reason;
+  dbyte stop_address;
+
+  void stop(StopReason reason, dbyte address);
+  void update_watches(dbyte page);
+  void update_mirrored_watches(dbyte address);
+  void update_hooks();
+
+ public:
+  Debugger();
+
+  // Called by Emulator::set_debugger
+  void attach(Processor* processor);
+
+  void add_breakpoint(dbyte address);
+  void remove_breakpoint(dbyte address);
+  void add_watchpoint(dbyte address, bool reads, bool writes);
+  void remove_watchpoint(dbyte address);
+  void add_ppu_watchpoint(dbyte address, bool reads, bool writes);
+  void remove_ppu_watchpoint(dbyte address);
+  void clear();
+
+  // Each of these resumes a stopped emulator
+  void resume();
+  void step();       // Runs one instruction
+  void step_over();  // Runs a JSR until it returns; otherwise like step
+  void run_to_scanline(int scanline);  // Stops at the scanline's start
+
+  bool is_stopped();
+  StopReason get_stop_reason();
+  dbyte get_stop_address();  // The PC or the watched address
+
+  // Whether the emulator must use the checking execute loop
+  bool is_active();
+
+  // Hooks called by the processor and the emulator's frame loop
+  bool should_stop_before(dbyte pc, byte s);
+  bool should_stop_at_scanline(int scanline);
+  void check_cpu_read(dbyte address);
+  void check_cpu_write(dbyte address);
+  void check_ppu_read(dbyte address);
+  void check_ppu_write(dbyte address);
+};
+
+#endif /* defined(__Emulator__Debugger__) */
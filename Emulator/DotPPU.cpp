@@ -0,0 +1,328 @@
+//
+//  DotPPU.cpp
+//  Emulator
+//
+//  Lines are numbered as the hardware numbers them: 0-239 are visible, 240
+//  is the post-render line, 241-260 are vblank and 261 is the pre-render
+//  line. The emulator's frames start at line 241.
+//
+//  The timing follows http://wiki.nesdev.com/w/index.php/PPU_rendering.
+//  Not emulated: the skipped dot on odd frames, the sprite overflow flag's
+//  false positives, and $2007 accesses during rendering bumping the scroll.
+//
+
+#include "DotPPU.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Mapper.h"
+#include "PPU.h"
+
+// The emulator runs each scanline for this many CPU cycles (see
+// Emulator::emulate_frame), so CPU time is scaled by lines, not by 3 dots a
+// cycle, to keep the two in step
+static const int kCPUCyclesPerLine = 113;
+
+static const int kFirstLine = 241;
+static const int kPostRenderLine = 240;
+static const int kPreRenderLine = 261;
+
+// std::min takes its arguments by reference, which needs these defined
+const int DotPPU::kDotsPerLine;
+const int DotPPU::kLinesPerFrame;
+
+static const int kControl1SpriteSizeMask = 0x20;
+static const int kControl2BackgroundLeftMask = 0x02;
+static const int kControl2SpritesLeftMask = 0x04;
+
+// Sprite pixel bits
+static const byte kSpriteColorMask = 0x0F;  // Palette and pattern bits
+static const byte kSpriteBehindBackground = 0x20;
+static const byte kSpriteZero = 0x40;
+
+DotPPU::DotPPU(PPU* ppu)
+    : ppu(ppu),
+      position(0),
+      frame_start_cycle(0),
+      next_tile(0),
+      next_attribute(0),
+      next_pattern_low(0),
+      next_pattern_high(0),
+      pattern_low(0),
+      pattern_high(0),
+      attribute_low(0),
+      attribute_high(0),
+      sprite_pixels(),
+      next_sprite_pixels() {}
+
+void DotPPU::begin_frame(uint64_t cpu_cycle) {
+  frame_start_cycle = cpu_cycle;
+  position = 0;
+}
+
+bool DotPPU::finish_scanline(int scanline) {
+  run_to((scanline + 1) * kDotsPerLine);
+
+  if ((scanline + kFirstLine) % kLinesPerFrame == kScreenHeight - 1) {
+    ppu->renderer->end_frame();
+  }
+
+  // Vblank starts at the first dot of the next frame
+  if (scanline == kLinesPerFrame - 1) {
+    ppu->set_vblank_flag();
+    return ppu->vblank_interrupt_enabled();
+  }
+
+  return false;
+}
+
+void DotPPU::catch_up(uint64_t cpu_cycle) {
+  uint64_t dots = (cpu_cycle - frame_start_cycle) * kDotsPerLine /
+                  kCPUCyclesPerLine;
+  run_to(static_cast<int>(
+      std::min<uint64_t>(dots, kLinesPerFrame * kDotsPerLine)));
+}
+
+void DotPPU::run_to(int target) {
+  while (position < target) {
+    int frame_line = position / kDotsPerLine;
+    int line = (frame_line + kFirstLine) % kLinesPerFrame;
+    int dot = position % kDotsPerLine;
+    int end = std::min(target - frame_line * kDotsPerLine, kDotsPerLine);
+
+    if (line >= kPostRenderLine && line < kPreRenderLine) {
+      // Nothing happens outside the rendered lines
+    } else if (!ppu->is_screen_enabled()) {
+      skip_line(line, dot, end);
+    } else {
+      for (int d = dot; d < end; d++) {
+        step(line, d);
+      }
+    }
+
+    position = frame_line * kDotsPerLine + end;
+  }
+}
+
+// Dots [start, end) of a rendered line with rendering off: only the
+// backdrop is drawn
+void DotPPU::skip_line(int line, int start, int end) {
+  if (line == kPreRenderLine && start <= 1 && end > 1) {
+    ppu->reset_vblank_flag();
+    ppu->reset_sprite_0_flag();
+    ppu->reset_more_than_8_sprites_flag();
+  }
+
+  if (line < kScreenHeight) {
+    int first = std::max(start, 1) - 1;
+    int last = std::min(end, kScreenWidth + 1) - 1;
+    if (first < last) {
+      ::memset(ppu->renderer->get_scanline(line) + first,
+               ppu->read_memory(kPaletteTableStart), last - first);
+    }
+  }
+
+  // No sprites were evaluated for the next line
+  if (end == kDotsPerLine) {
+    ::memset(sprite_pixels, 0, kScreenWidth);
+  }
+}
+
+void DotPPU::step(int line, int dot) {
+  if (line == kPreRenderLine && dot == 1) {
+    ppu->reset_vblank_flag();
+    ppu->reset_sprite_0_flag();
+    ppu->reset_more_than_8_sprites_flag();
+  }
+
+  if ((dot >= 2 && dot <= 257) || (dot >= 321 && dot <= 337)) {
+    pattern_low <<= 1;
+    pattern_high <<= 1;
+    attribute_low <<= 1;
+    attribute_high <<= 1;
+    fetch_background(dot);
+  }
+
+  if (dot == 256) {
+    increment_y();
+  } else if (dot == 257) {
+    copy_x();
+
+    if (line < kScreenHeight) {
+      evaluate_sprites(line);
+    } else {
+      ::memset(next_sprite_pixels, 0, kScreenWidth);  // No sprites on line 0
+    }
+  } else if (dot == 260 && ppu->mapper) {
+    // Sprite pattern fetches raise A12 about here, which the MMC3 counts
+    ppu->mapper->clock_scanline();
+  } else if (dot >= 280 && dot <= 304 && line == kPreRenderLine) {
+    copy_y();
+  } else if (dot == kDotsPerLine - 1) {
+    ::memcpy(sprite_pixels, next_sprite_pixels, kScreenWidth);
+  }
+
+  if (line < kScreenHeight && dot >= 1 && dot <= kScreenWidth) {
+    draw_pixel(line, dot - 1);
+  }
+}
+
+// Each tile takes eight dots: name table byte, attribute byte, then the
+// two pattern bytes, and the coarse X scroll moves on to the next tile.
+// The fetched tile is loaded into the shift registers as the next one
+// starts, and is drawn 16 dots after its fetch began.
+void DotPPU::fetch_background(int dot) {
+  switch ((dot - 1) & 0x07) {
+    case 0:
+      load_background();
+      next_tile = ppu->read_page(ppu->nametable_address());
+      break;
+
+    case 2: {
+      byte attribute = ppu->read_page(ppu->attributetable_address());
+      int shift = ((ppu->cntVT & 0x02) << 1) | (ppu->cntHT & 0x02);
+      next_attribute = (attribute >> shift) & 0x03;
+      break;
+    }
+
+    case 4:
+      next_pattern_low =
+          ppu->read_page(ppu->regS << 12 | next_tile << 4 | ppu->cntFV);
+      break;
+
+    case 6:
+      next_pattern_high =
+          ppu->read_page((ppu->regS << 12 | next_tile << 4 | ppu->cntFV) + 8);
+      break;
+
+    case 7:
+      increment_x();
+      break;
+  }
+}
+
+void DotPPU::load_background() {
+  pattern_low = (pattern_low & 0xFF00) | next_pattern_low;
+  pattern_high = (pattern_high & 0xFF00) | next_pattern_high;
+  attribute_low =
+      (attribute_low & 0xFF00) | (next_attribute & 0x01 ? 0xFF : 0x00);
+  attribute_high =
+      (attribute_high & 0xFF00) | (next_attribute & 0x02 ? 0xFF : 0x00);
+}
+
+void DotPPU::increment_x() { ppu->increment_horizontal_scroll_counter(); }
+
+// Unlike the counters for $2007, coarse Y wraps at 30 into the next name
+// table; set out of range by a write, it wraps at 32 without switching
+void DotPPU::increment_y() {
+  if (++ppu->cntFV < 0x08) {
+    return;
+  }
+
+  ppu->cntFV = 0;
+  if (ppu->cntVT == 29) {
+    ppu->cntVT = 0;
+    ppu->cntV ^= 1;
+  } else if (ppu->cntVT == 31) {
+    ppu->cntVT = 0;
+  } else {
+    ppu->cntVT++;
+  }
+}
+
+void DotPPU::copy_x() {
+  ppu->cntH = ppu->regH;
+  ppu->cntHT = ppu->regHT;
+}
+
+void DotPPU::copy_y() {
+  ppu->cntFV = ppu->regFV;
+  ppu->cntV = ppu->regV;
+  ppu->cntVT = ppu->regVT;
+}
+
+// Finds the sprites on the line after `line` and draws them into
+// next_sprite_pixels; lower numbered sprites are in front
+void DotPPU::evaluate_sprites(int line) {
+  ::memset(next_sprite_pixels, 0, kScreenWidth);
+
+  int height = ppu->control_1 & kControl1SpriteSizeMask ? 16 : 8;
+  int count = 0;
+
+  for (int i = 0; i < 64; i++) {
+    const byte* sprite = ppu->spr_ram + i * 4;
+    int row = line - sprite[0];
+    if (row < 0 || row >= height) {
+      continue;
+    }
+
+    if (++count > 8) {
+      ppu->set_more_than_8_sprites_flag();
+      break;
+    }
+
+    byte tile = sprite[1];
+    byte attributes = sprite[2];
+    if (attributes & 0x80) {
+      row = height - 1 - row;  // Flipped vertically
+    }
+
+    dbyte address;
+    if (height == 16) {
+      address = (tile & 0x01) << 12 | (tile & 0xFE) << 4 |
+                (row & 0x08) << 1 | (row & 0x07);
+    } else {
+      address = ppu->sprite_pattern_table_address() | tile << 4 | row;
+    }
+    byte low = ppu->read_page(address);
+    byte high = ppu->read_page(address + 8);
+
+    for (int x = 0; x < 8 && sprite[3] + x < kScreenWidth; x++) {
+      int bit = attributes & 0x40 ? x : 7 - x;
+      byte pixel = ((low >> bit) & 0x01) | ((high >> bit) & 0x01) << 1;
+      byte& target = next_sprite_pixels[sprite[3] + x];
+
+      if (pixel && !target) {
+        target = pixel | (attributes & 0x03) << 2 |
+                 (attributes & 0x20 ? kSpriteBehindBackground : 0) |
+                 (i == 0 ? kSpriteZero : 0);
+      }
+    }
+  }
+
+  ppu->counters.count_sprites_evaluated(std::min(count, 8));
+}
+
+void DotPPU::draw_pixel(int line, int x) {
+  byte background = 0;
+  if (ppu->enable_background() &&
+      (x >= 8 || ppu->control_2 & kControl2BackgroundLeftMask)) {
+    dbyte bit = 0x8000 >> ppu->regFH;
+    background = (pattern_low & bit ? 0x01 : 0) |
+                 (pattern_high & bit ? 0x02 : 0);
+    if (background) {
+      background |= (attribute_low & bit ? 0x04 : 0) |
+                    (attribute_high & bit ? 0x08 : 0);
+    }
+  }
+
+  byte sprite = 0;
+  if (ppu->enable_sprites() &&
+      (x >= 8 || ppu->control_2 & kControl2SpritesLeftMask)) {
+    sprite = sprite_pixels[x];
+  }
+
+  if (background && (sprite & kSpriteZero) && x != kScreenWidth - 1) {
+    ppu->set_sprite_0_flag();
+  }
+
+  dbyte palette_address = kPaletteTableStart;
+  if (sprite && (!background || !(sprite & kSpriteBehindBackground))) {
+    palette_address += kPaletteTableSpriteOffset + (sprite & kSpriteColorMask);
+  } else if (background) {
+    palette_address += background;
+  }
+
+  ppu->renderer->get_scanline(line)[x] = ppu->read_memory(palette_address);
+}
@@ -0,0 +1,78 @@
+//
+//  DotPPU.h
+//  Emulator
+//
+//  The accurate PPU engine. It steps one dot (PPU clock) at a time through
+//  the NTSC frame of 262 lines of 341 dots: background tiles are fetched
+//  into shift registers eight dots ahead of where they're drawn, the scroll
+//  counters increment and reload at the dots the hardware uses, sprites are
+//  evaluated at the end of the previous line, and sprite 0 hits happen at
+//  the pixel that causes them. Register writes therefore take effect at the
+//  dot the CPU makes them.
+//
+//  Nothing runs between catch-ups: the engine only steps when the CPU is
+//  about to access the PPU, since nothing it could observe changes
+//  otherwise. Idle lines, and lines with rendering off, are skipped as a
+//  whole.
+//
+
+#ifndef __Emulator__DotPPU__
+#define __Emulator__DotPPU__
+
+#include "PPUEngine.h"
+#include "defines.h"
+
+class PPU;
+
+class DotPPU : public PPUEngine {
+ private:
+  static const int kDotsPerLine = 341;
+  static const int kLinesPerFrame = 262;
+
+  PPU* ppu;
+
+  // Dots since the frame started, which is at the first line of vblank
+  int position;
+  uint64_t frame_start_cycle;
+
+  // The tile being fetched
+  byte next_tile;
+  byte next_attribute;
+  byte next_pattern_low;
+  byte next_pattern_high;
+
+  // Two tiles of background: the one being drawn in the high bytes, the
+  // next one in the low bytes
+  dbyte pattern_low;
+  dbyte pattern_high;
+  dbyte attribute_low;
+  dbyte attribute_high;
+
+  // Sprite pixels for this line and the next, as evaluated at the end of
+  // the previous line: pattern bits, palette, priority and sprite 0
+  byte sprite_pixels[kScreenWidth];
+  byte next_sprite_pixels[kScreenWidth];
+
+  void run_to(int target);
+  void skip_line(int line, int start, int end);
+  void step(int line, int dot);
+
+  void fetch_background(int dot);
+  void load_background();
+  void increment_x();
+  void increment_y();
+  void copy_x();
+  void copy_y();
+
+  void evaluate_sprites(int line);
+  void draw_pixel(int line, int x);
+
+ public:
+  DotPPU(PPU* ppu);
+
+  void begin_frame(uint64_t cpu_cycle) override;
+  bool finish_scanline(int scanline) override;
+  void catch_up(uint64_t cpu_cycle) override;
+};
+
+#endif /* defined(__Emulator__DotPPU__) */
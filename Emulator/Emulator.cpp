@@ -9,20 +9,79 @@
 
 #include "Emulator.h"
 
+#include <cstring>
+#include <fstream>
+
 #include "ControllerPad.h"
 #include "RomReader.h"
+#include "Tracer.h"
+
+static const uint64_t kHashSeed = 0xCBF29CE484222325;
+static const uint64_t kHashMultiplier = 0x100000001B3;
+
+// FNV-1a style hash that consumes eight bytes per step
+static uint64_t hash_bytes(uint64_t hash, const byte* data, size_t length) {
+  size_t i = 0;
+
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t word;
+    ::memcpy(&word, data + i, sizeof(uint64_t));
+    hash = (hash ^ word) * kHashMultiplier;
+    hash ^= hash >> 32;
+  }
+
+  for (; i < length; i++) {
+    hash = (hash ^ data[i]) * kHashMultiplier;
+  }
 
-Emulator::Emulator()
-    : processor(std::make_unique<Processor>(&ppu, &controller_pad)) {}
+  return hash;
+}
+
+Emulator::Emulator() : Emulator(false) {}
+
+Emulator::Emulator(bool headless)
+    : ppu(headless),
+      processor(std::make_unique<Processor>(&ppu, &controller_pad)),
+      apu(processor.get()),
+      debugger(nullptr),
+      frame_in_progress(false),
+      frame_scanline(0),
+      frame_clock(0),
+      profiler(nullptr),
+      movie_mode(kMovieNone) {
+  processor->set_apu(&apu);
+}
+
+Emulator::~Emulator() {
+  try {
+    stop_movie();
+  } catch (const char* error) {
+    // Never throw from a destructor; the recording is lost.
+  }
+}
 
 void Emulator::load_rom(std::string filename) {
   RomReader reader(filename);
-  ppu.set_chr_rom(reader.get_chr_rom());
-  processor->set_prg_rom(reader.get_prg_rom());
-  processor->reset();
+  mapper = Mapper::create(reader, processor.get(), &ppu);
+  processor->set_mapper(mapper.get());
+  ppu.set_mapper(mapper.get());
+  power_on();
+}
+
+void Emulator::power_on() {
+  ppu.power_on();
+  if (mapper) {
+    mapper->reset();
+  }
+  controller_pad.reset();
+  processor->power_on();
+  apu.power_on();
+  frame_in_progress = false;
 }
 
-void Emulator::emulate_frame() {
+bool Emulator::emulate_frame() {
+  TRACE_SCOPE("emulate_frame");
+
   // The PPU renders 262 scanlines. The CPU does ~113 clock cycles per scanline.
   //
   // TODO: Make this more accurate?
@@ -31,26 +90,289 @@ void Emulator::emulate_frame() {
   // 1 Dummy scanline
   // 240 Picture scanlines
   // 1 Dummy scanline -> VINT set afterwards
-  int clock = 0;
-  for (int scanline = 0; scanline <= 261; scanline++) {
-    while (clock < 113) {
-      clock += processor->execute();
+  if (!frame_in_progress) {
+    update_movie();
+    processor->apply_ram_cheats(cheats.get_cheats());
+    frame_in_progress = true;
+    frame_scanline = 0;
+    frame_clock = 0;
+    ppu.begin_frame(processor->get_cycle_count());
+    counters.begin_frame(processor->get_perf_counters());
+
+    if (debugger && debugger->should_stop_at_scanline(0)) {
+      return false;
+    }
+  }
+
+  while (frame_scanline <= 261) {
+    // The checking loop is only used while the debugger has work to do
+    bool debugging = debugger && debugger->is_active();
+
+    counters.start_cpu_timer();
+    {
+      TRACE_SCOPE("cpu");
+      frame_clock +=
+          processor->run(113 - frame_clock, debugging ? debugger : nullptr);
     }
+    counters.stop_cpu_timer();
 
-    if (ppu.render_scanline(scanline)) {
+    // Watchpoints can stop the emulator outside the checking loop
+    if (debugger && debugger->is_stopped()) {
+      return false;
+    }
+
+    apu.run_until(processor->get_cycle_count());
+
+    counters.start_render_timer();
+    bool vblank_interrupt = ppu.render_scanline(frame_scanline);
+    counters.stop_render_timer();
+
+    if (vblank_interrupt) {
+      TRACE_SCOPE("nmi");
       processor->non_maskable_interrupt();
       // NMI takes 7 cycles to execute
-      clock += 7;
+      frame_clock += 7;
+    }
+
+    frame_clock -= 113;
+    frame_scanline++;
+
+    if (debugging && frame_scanline <= 261 &&
+        debugger->should_stop_at_scanline(frame_scanline)) {
+      return false;
     }
+  }
+
+  frame_in_progress = false;
+  apu.end_frame(processor->get_cycle_count());
+  audio_samples.resize(apu.samples_available());
+  apu.read_samples(audio_samples.data(), audio_samples.size());
+
+  counters.end_frame(processor->get_perf_counters());
+  return true;
+}
+
+void Emulator::set_debugger(Debugger* debugger) {
+  if (this->debugger) {
+    this->debugger->attach(nullptr);
+  }
+
+  this->debugger = debugger;
+  if (debugger) {
+    debugger->attach(processor.get());
+  }
+}
+
+void Emulator::set_ppu_accuracy(PPUAccuracy accuracy) {
+  ppu.set_accuracy(accuracy);
+}
+
+void Emulator::set_profiler(GuestProfiler* profiler) {
+  if (this->profiler) {
+    this->profiler->attach(nullptr);
+  }
+
+  this->profiler = profiler;
+  if (profiler) {
+    profiler->attach(processor.get());
+  }
+}
+
+const byte* Emulator::get_framebuffer() { return ppu.get_framebuffer(); }
+
+const byte* Emulator::get_cpu_ram() { return processor->get_cpu_ram(); }
+
+const std::vector<int16_t>& Emulator::get_audio_samples() {
+  return audio_samples;
+}
+
+void Emulator::set_audio_sample_rate(double sample_rate) {
+  apu.set_sample_rate(sample_rate);
+}
+
+void Emulator::set_present_frames(bool present) {
+  ppu.set_present_frames(present);
+}
+
+uint64_t Emulator::frame_hash(bool include_cpu_ram) {
+  uint64_t hash = hash_bytes(kHashSeed, get_framebuffer(),
+                             kScreenWidth * kScreenHeight);
+
+  if (include_cpu_ram) {
+    hash = hash_bytes(hash, get_cpu_ram(), Processor::kCPURAMSize);
+  }
+
+  return hash;
+}
+
+PerfCounterValues Emulator::get_perf_counters() {
+  PerfCounterValues values = counters.values();
+  values += processor->get_perf_counters().values();
+  values += ppu.get_perf_counters().values();
+  return values;
+}
+
+void Emulator::write_perf_counters(std::string filename) {
+  std::ofstream file(filename, std::ios::out | std::ios::trunc);
+
+  if (!file.is_open()) {
+    throw "Could not open performance counter file for writing.";
+  }
+
+  get_perf_counters().write_json(file);
+}
+
+std::vector<byte> Emulator::save_state() {
+  std::vector<byte> state;
+  save_state(state);
+  return state;
+}
+
+void Emulator::save_state(std::vector<byte>& state) {
+  state.clear();  // Keeps the capacity, so repeated snapshots don't allocate
+  StateWriter writer(state);
+
+  writer.write(kStateVersion);
+  processor->save_state(writer);
+  ppu.save_state(writer);
+  controller_pad.save_state(writer);
+  apu.save_state(writer);
+  if (mapper) {
+    mapper->save_state(writer);
+  }
+}
+
+void Emulator::load_state(const std::vector<byte>& state) {
+  StateReader reader(state);
+
+  if (reader.read<byte>() != kStateVersion) {
+    throw "Save state is from an incompatible version.";
+  }
+
+  processor->load_state(reader);
+  ppu.load_state(reader);
+  controller_pad.load_state(reader);
+  apu.load_state(reader);
+  if (mapper) {
+    mapper->load_state(reader);
+  }
+
+  // States are taken between frames
+  frame_in_progress = false;
+}
+
+void Emulator::add_cheat(std::string code) {
+  cheats.add(code);
+  update_cheats();
+}
+
+void Emulator::remove_cheat(size_t index) {
+  cheats.remove(index);
+  update_cheats();
+}
+
+void Emulator::set_cheat_enabled(size_t index, bool enabled) {
+  cheats.set_enabled(index, enabled);
+  update_cheats();
+}
+
+void Emulator::clear_cheats() {
+  cheats.clear();
+  update_cheats();
+}
+
+const std::vector<Cheat>& Emulator::get_cheats() {
+  return cheats.get_cheats();
+}
+
+void Emulator::update_cheats() {
+  processor->set_rom_cheats(cheats.get_cheats());
+}
+
+void Emulator::start_recording(std::string filename, bool from_power_on) {
+  stop_movie();
+
+  if (from_power_on) {
+    power_on();
+    movie = std::make_unique<InputMovie>();
+  } else {
+    movie = std::make_unique<InputMovie>(save_state());
+  }
+
+  movie_mode = kMovieRecording;
+  movie_filename = filename;
+}
+
+void Emulator::start_playback(std::string filename) {
+  stop_movie();
+
+  movie = std::make_unique<InputMovie>(filename);
+
+  if (movie->starts_from_snapshot()) {
+    load_state(movie->get_snapshot());
+  } else {
+    power_on();
+  }
+
+  movie_mode = kMoviePlayback;
+}
+
+void Emulator::stop_movie() {
+  if (movie_mode == kMovieRecording) {
+    movie->save(movie_filename);
+  }
+
+  movie_mode = kMovieNone;
+  movie = nullptr;
+}
+
+bool Emulator::is_playing_movie() { return movie_mode == kMoviePlayback; }
 
-    clock -= 113;
+// Called at the start of every frame, so that a movie frame covers exactly the
+// input the game sees during one call to emulate_frame. Queued input is only
+// applied mid-frame when there's no movie, since movies hold one input per
+// frame.
+void Emulator::update_movie() {
+  controller_pad.drain_input_events(movie_mode != kMoviePlayback);
+
+  if (movie_mode == kMoviePlayback) {
+    if (movie->has_next_frame()) {
+      controller_pad.set_controller_1_buttons(movie->next_frame());
+    } else {
+      stop_movie();
+    }
+  } else if (movie_mode == kMovieRecording) {
+    movie->record_frame(controller_pad.get_controller_1_buttons());
   }
+
+  controller_pad.set_sub_frame_input(movie_mode == kMovieNone);
+}
+
+void Emulator::set_controller_buttons(byte controller_1, byte controller_2) {
+  controller_pad.set_controller_1_buttons(controller_1);
+  controller_pad.set_controller_2_buttons(controller_2);
+}
+
+void Emulator::set_input_queue(InputEventQueue* queue) {
+  controller_pad.set_input_queue(queue);
+}
+
+InputLatencyStats Emulator::get_input_latency() {
+  return controller_pad.get_input_latency();
 }
 
 bool Emulator::handle_key_down(SDL_Keysym sym) {
+  if (is_playing_movie()) {
+    return false;
+  }
+
   return controller_pad.record_key_down(sym);
 }
 
 bool Emulator::handle_key_up(SDL_Keysym sym) {
+  if (is_playing_movie()) {
+    return false;
+  }
+
   return controller_pad.record_key_up(sym);
 }
@@ -11,24 +11,121 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "APU.h"
+#include "CheatTable.h"
 #include "ControllerPad.h"
+#include "Debugger.h"
+#include "GuestProfiler.h"
+#include "InputMovie.h"
+#include "Mapper.h"
 #include "PPU.h"
+#include "PerfCounters.h"
 #include "Processor.h"
 #include "SDL.h"
 
 class Emulator {
+  friend class ConformanceSuite;  // Seeds and inspects the CPU directly
+
  private:
+  enum MovieMode { kMovieNone, kMovieRecording, kMoviePlayback };
+
   PPU ppu;
   ControllerPad controller_pad;
   std::unique_ptr<Processor> processor;
+  APU apu;
+  std::unique_ptr<Mapper> mapper;  // Holds the cartridge ROM
+  PerfCounters counters;  // Frame counts and CPU / renderer timing
+
+  std::vector<int16_t> audio_samples;  // Produced by the last frame
+
+  // Where emulate_frame left off when the debugger stopped it mid-frame
+  Debugger* debugger;
+  bool frame_in_progress;
+  int frame_scanline;
+  int frame_clock;
+
+  GuestProfiler* profiler;
+
+  CheatTable cheats;
+
+  std::unique_ptr<InputMovie> movie;
+  MovieMode movie_mode;
+  std::string movie_filename;
+
+  void update_movie();
+  void update_cheats();
 
  public:
   Emulator();
+  Emulator(bool headless);  // Headless emulators never open a window
+  ~Emulator();
   void load_rom(std::string filename);
-  void emulate_frame();
+  void power_on();
+
+  // Runs to the end of the frame, or until the debugger stops. Returns
+  // false if the frame isn't finished; the next call after the debugger
+  // resumes picks it up where it stopped.
+  bool emulate_frame();
+  void set_debugger(Debugger* debugger);  // Pass nullptr to detach
+  void set_profiler(GuestProfiler* profiler);  // Pass nullptr to detach
+
+  // kPPUFast by default. kPPUAccurate adds the hardware's fetch and sprite
+  // timing (sprite 0 hits, 8x16 sprites) at some cost in speed; choose it
+  // per ROM, between frames. It's kept across ROM loads.
+  void set_ppu_accuracy(PPUAccuracy accuracy);
+
+  // The last rendered frame, kScreenWidth * kScreenHeight NES color indices
+  const byte* get_framebuffer();
+  const byte* get_cpu_ram();
+
+  // The last frame's audio, mono signed 16-bit samples at the APU's sample
+  // rate (roughly sample_rate / 60 per frame)
+  const std::vector<int16_t>& get_audio_samples();
+  void set_audio_sample_rate(double sample_rate);
+
+  // Whether emulated frames are copied to the window. Frames are still
+  // rendered into the framebuffer either way.
+  void set_present_frames(bool present);
+
+  // A 64-bit hash of the framebuffer (and optionally CPU RAM), for comparing
+  // emulator output across builds
+  uint64_t frame_hash(bool include_cpu_ram);
+
+  // All zero unless built with EMULATOR_PERF_COUNTERS
+  PerfCounterValues get_perf_counters();
+  void write_perf_counters(std::string filename);
+
+  // Cheats stay active across ROM loads and resets until removed. RAM cheats
+  // are rewritten at the start of every frame. add_cheat throws if `code`
+  // isn't a Game Genie code or raw patch (see CheatTable::parse).
+  void add_cheat(std::string code);
+  void remove_cheat(size_t index);
+  void set_cheat_enabled(size_t index, bool enabled);
+  void clear_cheats();
+  const std::vector<Cheat>& get_cheats();
+
+  std::vector<byte> save_state();
+  void save_state(std::vector<byte>& state);  // Reuses the vector's storage
+  void load_state(const std::vector<byte>& state);
+
+  // Movies record controller input from power-on (or from the current state)
+  // and replay it frame by frame, ignoring keyboard input while playing.
+  void start_recording(std::string filename, bool from_power_on);
+  void start_playback(std::string filename);
+  void stop_movie();
+  bool is_playing_movie();
 
   bool handle_key_up(SDL_Keysym sym);
+
+  // Both controllers' buttons for the next frame, in ControllerPad's order
+  void set_controller_buttons(byte controller_1, byte controller_2);
+
+  // Takes controller input from `queue` instead of handle_key_down /
+  // handle_key_up, applying each event at the game's next controller strobe
+  void set_input_queue(InputEventQueue* queue);
+  InputLatencyStats get_input_latency();
   bool handle_key_down(SDL_Keysym sym);
 };
 
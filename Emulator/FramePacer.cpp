@@ -0,0 +1,150 @@
+//
+//  FramePacer.cpp
+//  Emulator
+//
+
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "Tracer.h"
+
+static const uint64_t kNTSCPeriodNumerator = 655171ULL * 8000;
+static const uint64_t kNTSCPeriodDenominator = 315;
+
+static const auto kDefaultSpinThreshold = std::chrono::microseconds(1500);
+static const uint64_t kMaxFramesBehind = 4;
+static const size_t kFrameTimeHistory = 1024;
+
+FramePacer::FramePacer()
+    : FramePacer(kNTSCPeriodNumerator, kNTSCPeriodDenominator) {}
+
+FramePacer::FramePacer(uint64_t period_numerator, uint64_t period_denominator)
+    : period_numerator(period_numerator),
+      period_denominator(period_denominator),
+      spin_threshold(kDefaultSpinThreshold),
+      speed(1) {
+  reset();
+}
+
+void FramePacer::reset() {
+  start = Clock::now();
+  last_frame = start;
+  last_presented = start;
+  frame_index = 1;
+
+  frames = 0;
+  missed_deadlines = 0;
+  frame_times.clear();
+  frame_times_position = 0;
+}
+
+void FramePacer::set_spin_threshold(std::chrono::nanoseconds threshold) {
+  spin_threshold = threshold;
+}
+
+void FramePacer::set_speed(double speed) {
+  this->speed = speed;
+  start = Clock::now();
+  frame_index = 1;
+}
+
+double FramePacer::get_speed() { return speed; }
+
+bool FramePacer::should_present_frame() {
+  if (speed == 1) {
+    return true;
+  }
+
+  // Present once a full frame period has passed since the last one
+  Clock::time_point now = Clock::now();
+  if (now - last_presented < deadline(1) - start) {
+    return false;
+  }
+
+  last_presented = now;
+  return true;
+}
+
+FramePacer::Clock::duration FramePacer::scaled(Clock::duration duration) {
+  if (speed == 1 || speed == 0) {
+    return duration;
+  }
+
+  return std::chrono::duration_cast<Clock::duration>(duration / speed);
+}
+
+FramePacer::Clock::time_point FramePacer::deadline(uint64_t index) {
+  return start + std::chrono::nanoseconds(index * period_numerator /
+                                          period_denominator);
+}
+
+void FramePacer::wait_for_next_frame() {
+  Clock::time_point target = start + scaled(deadline(frame_index) - start);
+  Clock::time_point now = Clock::now();
+
+  if (speed == 0) {
+    // Uncapped; don't wait at all
+  } else if (now > target) {
+    missed_deadlines++;
+
+    if (now - target > scaled(deadline(kMaxFramesBehind) - start)) {
+      // Too far behind (e.g. the process was suspended); start over
+      start = now;
+      frame_index = 0;
+      target = now;
+    }
+  } else {
+    TRACE_SCOPE("sleep");
+
+    if (target - now > spin_threshold) {
+      std::this_thread::sleep_for(target - now - spin_threshold);
+    }
+
+    while (Clock::now() < target) {
+      std::this_thread::yield();
+    }
+  }
+
+  frame_index++;
+
+  now = Clock::now();
+  int64_t frame_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_frame)
+          .count();
+  last_frame = now;
+
+  if (frame_times.size() < kFrameTimeHistory) {
+    frame_times.push_back(frame_time);
+  } else {
+    frame_times[frame_times_position] = frame_time;
+    frame_times_position = (frame_times_position + 1) % kFrameTimeHistory;
+  }
+
+  frames++;
+}
+
+FramePacerStats FramePacer::get_stats() {
+  FramePacerStats stats = {frames, missed_deadlines, 0, 0, 0, 0};
+
+  if (frame_times.empty()) {
+    return stats;
+  }
+
+  std::vector<int64_t> sorted = frame_times;
+  std::sort(sorted.begin(), sorted.end());
+
+  double sum = 0;
+  for (int64_t time : sorted) {
+    sum += time;
+  }
+
+  stats.mean_ms = sum / sorted.size() / 1e6;
+  stats.p50_ms = sorted[sorted.size() / 2] / 1e6;
+  stats.p99_ms =
+      sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)] / 1e6;
+  stats.max_ms = sorted.back() / 1e6;
+
+  return stats;
+}
@@ -0,0 +1,81 @@
+//
+//  FramePacer.h
+//  Emulator
+//
+//  Paces the main loop to the exact NTSC frame rate (~60.0988 Hz) using a
+//  monotonic clock. Each deadline is computed from the start time, so
+//  rounding never accumulates into drift. The wait sleeps for most of the
+//  remaining time and spins for the last stretch, which the OS scheduler
+//  can't hit precisely.
+//
+
+#ifndef __Emulator__FramePacer__
+#define __Emulator__FramePacer__
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct FramePacerStats {
+  uint64_t frames;
+  uint64_t missed_deadlines;  // Frames that finished after their deadline
+
+  // Time between consecutive frames, over the most recent frames
+  double mean_ms;
+  double p50_ms;
+  double p99_ms;
+  double max_ms;
+};
+
+class FramePacer {
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  // Frame period as a fraction of a nanosecond: NTSC frames are 29780.5 CPU
+  // cycles at 39375000 / 22 Hz, i.e. 655171 / 39375000 s = 655171 * 8000 /
+  // 315 ns.
+  uint64_t period_numerator;
+  uint64_t period_denominator;
+
+  Clock::duration spin_threshold;
+  double speed;  // Multiple of the frame rate, 0 for uncapped
+
+  Clock::time_point last_presented;
+
+  Clock::time_point start;
+  uint64_t frame_index;  // Deadline of the next frame is start + period * i
+  Clock::time_point last_frame;
+
+  uint64_t frames;
+  uint64_t missed_deadlines;
+  std::vector<int64_t> frame_times;  // Ring buffer, nanoseconds
+  size_t frame_times_position;
+
+  Clock::time_point deadline(uint64_t index);  // At normal speed
+  Clock::duration scaled(Clock::duration duration);
+
+ public:
+  FramePacer();
+  FramePacer(uint64_t period_numerator, uint64_t period_denominator);
+
+  void reset();
+  void set_spin_threshold(std::chrono::nanoseconds threshold);
+
+  // Fast-forward: run at `speed` times the frame rate, or as fast as possible
+  // when `speed` is 0. Restarts the schedule from now.
+  void set_speed(double speed);
+  double get_speed();
+
+  // Whether the upcoming frame should be shown. At normal speed every frame
+  // is; faster than that, only as many frames as the display can show.
+  bool should_present_frame();
+
+  // Waits until the deadline of the next frame. If the loop has fallen more
+  // than a few frames behind, the schedule restarts from now instead of
+  // rushing to catch up.
+  void wait_for_next_frame();
+
+  FramePacerStats get_stats();
+};
+
+#endif /* defined(__Emulator__FramePacer__) */
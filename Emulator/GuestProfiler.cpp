@@ -0,0 +1,358 @@
+//
+//  GuestProfiler.cpp
+//  Emulator
+//
+//  Calls are tracked by the stack pointer rather than by matching RTS to
+//  JSR, so that games which return through pushed addresses or reset the
+//  stack with TXS don't leave calls open forever: a call ends as soon as the
+//  stack pointer rises above where the call left it.
+//
+
+#include "GuestProfiler.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+#include "Mapper.h"
+#include "Processor.h"
+
+static const byte kJSR = 0x20;
+
+static bool reads_memory(Function function) {
+  switch (function) {
+    case BIT:
+    case CPX:
+    case CPY:
+    case ASL:
+    case LSR:
+    case ROL:
+    case ROR:
+    case INC:
+    case DEC:
+      return true;
+
+    default:
+      return is_read_instruction(function);
+  }
+}
+
+GuestProfiler::GuestProfiler()
+    : processor(nullptr),
+      pc_cycles(0x10000),
+      total_cycles(0),
+      start_pc(0),
+      start_s(0),
+      function(NOP),
+      last_s(0) {
+  clear();
+}
+
+void GuestProfiler::attach(Processor* processor) {
+  if (this->processor) {
+    this->processor->profiler = nullptr;
+  }
+
+  this->processor = processor;
+  if (processor) {
+    processor->profiler = this;
+    last_s = processor->s;
+  }
+}
+
+void GuestProfiler::clear() {
+  code_log.clear();
+  std::fill(pc_cycles.begin(), pc_cycles.end(), 0);
+  nodes.assign(1, {kFrameRoot, 0, -1, 0, {}});
+  frames.clear();
+  total_cycles = 0;
+}
+
+// Marks the PRG ROM byte currently mapped at `address`
+void GuestProfiler::log_rom(dbyte address, byte flags) {
+  Mapper* mapper = processor->mapper;
+  if (address < 0x8000 || !mapper) {
+    return;
+  }
+
+  const byte* page = processor->prg_rom_pages[(address >> 8) - 0x80];
+  const byte* prg_rom = mapper->get_prg_rom();
+  size_t size = mapper->get_prg_rom_size();
+  if (!page || page < prg_rom || page >= prg_rom + size) {
+    return;
+  }
+
+  if (code_log.size() != size) {
+    code_log.assign(size, 0);
+  }
+  code_log[page - prg_rom + (address & 0xFF)] |= flags;
+}
+
+void GuestProfiler::log_instruction() {
+  byte opcode = processor->peek_memory(start_pc);
+  if (!is_valid_opcode(opcode)) {
+    function = NOP;
+    return;
+  }
+
+  Instruction instruction = get_instruction(opcode);
+  function = instruction.function;
+
+  int length = get_instruction_length(instruction.address_type);
+  for (int i = 0; i < length; i++) {
+    log_rom(start_pc + i, kCodeLogCode);
+  }
+
+  dbyte operand = processor->peek_memory(start_pc + 1) |
+                  processor->peek_memory(start_pc + 2) << 8;
+  dbyte address;
+  switch (instruction.address_type) {
+    case Absolute:
+      address = operand;
+      break;
+
+    case AbsoluteX:
+      address = operand + processor->x;
+      break;
+
+    case AbsoluteY:
+      address = operand + processor->y;
+      break;
+
+    case Indirect:
+      // The pointer's high byte doesn't carry into the next page
+      log_rom(operand, kCodeLogPointer);
+      log_rom((operand & 0xFF00) | ((operand + 1) & 0xFF), kCodeLogPointer);
+      return;
+
+    case IndirectPreX: {
+      byte pointer = (operand & 0xFF) + processor->x;
+      address = processor->peek_memory(pointer) |
+                processor->peek_memory(static_cast<byte>(pointer + 1)) << 8;
+      break;
+    }
+
+    case IndirectPostY: {
+      byte pointer = operand & 0xFF;
+      address = (processor->peek_memory(pointer) |
+                 processor->peek_memory(static_cast<byte>(pointer + 1)) << 8) +
+                processor->y;
+      break;
+    }
+
+    default:
+      return;  // Zero page, or no memory operand
+  }
+
+  if (reads_memory(function)) {
+    log_rom(address, kCodeLogData);
+  }
+}
+
+void GuestProfiler::enter(FrameKind kind, dbyte address) {
+  if (frames.size() >= kMaxDepth) {
+    return;
+  }
+
+  int parent = current_node();
+  int node = -1;
+  for (int child : nodes[parent].children) {
+    if (nodes[child].kind == kind && nodes[child].address == address) {
+      node = child;
+      break;
+    }
+  }
+
+  if (node < 0) {
+    node = static_cast<int>(nodes.size());
+    nodes.push_back({kind, address, parent, 0, {}});
+    nodes[parent].children.push_back(node);
+  }
+
+  frames.push_back({node, processor->s});
+}
+
+int GuestProfiler::current_node() {
+  return frames.empty() ? 0 : frames.back().node;
+}
+
+void GuestProfiler::before_instruction() {
+  start_pc = processor->pc;
+  start_s = processor->s;
+
+  // Only an NMI moves the stack pointer between instructions. Anything else
+  // means a state was loaded or the CPU reset.
+  if (start_s != last_s) {
+    if (start_s == static_cast<byte>(last_s - 3)) {
+      log_rom(0xFFFA, kCodeLogPointer);
+      log_rom(0xFFFB, kCodeLogPointer);
+      enter(kFrameNMI, start_pc);
+    } else {
+      frames.clear();
+    }
+  }
+
+  // execute will take the interrupt instead of running the instruction
+  if (processor->irq_sources && !processor->if_interrupt()) {
+    function = NOP;
+    return;
+  }
+
+  log_instruction();
+}
+
+void GuestProfiler::after_instruction(int cycles) {
+  pc_cycles[start_pc] += cycles;
+  nodes[current_node()].cycles += cycles;
+  total_cycles += cycles;
+
+  byte s = processor->s;
+  last_s = s;
+
+  if (s == static_cast<byte>(start_s - 3)) {
+    // An IRQ or BRK
+    log_rom(0xFFFE, kCodeLogPointer);
+    log_rom(0xFFFF, kCodeLogPointer);
+    enter(kFrameIRQ, processor->pc);
+  } else if (function == JSR && s == static_cast<byte>(start_s - 2)) {
+    enter(kFrameSubroutine, processor->pc);
+  } else {
+    while (!frames.empty() && frames.back().s < s) {
+      frames.pop_back();
+    }
+  }
+}
+
+const std::vector<byte>& GuestProfiler::get_code_log() { return code_log; }
+
+uint64_t GuestProfiler::get_cycles_at(dbyte pc) { return pc_cycles[pc]; }
+
+uint64_t GuestProfiler::get_total_cycles() { return total_cycles; }
+
+uint64_t GuestProfiler::subtree_cycles(int node) {
+  uint64_t cycles = nodes[node].cycles;
+  for (int child : nodes[node].children) {
+    cycles += subtree_cycles(child);
+  }
+  return cycles;
+}
+
+std::vector<RoutineProfile> GuestProfiler::get_routines() {
+  std::map<dbyte, RoutineProfile> routines;
+
+  for (size_t node = 1; node < nodes.size(); node++) {
+    if (nodes[node].kind != kFrameSubroutine) {
+      continue;
+    }
+
+    RoutineProfile& routine = routines[nodes[node].address];
+    routine.address = nodes[node].address;
+    routine.self_cycles += nodes[node].cycles;
+
+    // Recursive calls are already counted by the outermost call
+    bool recursive = false;
+    for (int parent = nodes[node].parent; parent > 0;
+         parent = nodes[parent].parent) {
+      recursive |= nodes[parent].kind == kFrameSubroutine &&
+                   nodes[parent].address == routine.address;
+    }
+    if (!recursive) {
+      routine.total_cycles += subtree_cycles(node);
+    }
+  }
+
+  std::vector<RoutineProfile> sorted;
+  for (const auto& routine : routines) {
+    sorted.push_back(routine.second);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const RoutineProfile& a, const RoutineProfile& b) {
+              return a.total_cycles > b.total_cycles;
+            });
+  return sorted;
+}
+
+std::string GuestProfiler::node_name(int node) {
+  char name[8];
+  switch (nodes[node].kind) {
+    case kFrameRoot:
+      return "main";
+    case kFrameNMI:
+      return "nmi";
+    case kFrameIRQ:
+      return "irq";
+    default:
+      snprintf(name, sizeof(name), "$%04X", nodes[node].address);
+      return name;
+  }
+}
+
+void GuestProfiler::write_folded_node(std::ostream& stream, int node,
+                                      std::string path) {
+  path += node_name(node);
+  if (nodes[node].cycles) {
+    stream << path << " " << nodes[node].cycles << "\n";
+  }
+
+  for (int child : nodes[node].children) {
+    write_folded_node(stream, child, path + ";");
+  }
+}
+
+void GuestProfiler::write_folded_stacks(std::string filename) {
+  std::ofstream stream(filename);
+  if (!stream.is_open()) {
+    throw "Could not open folded stacks file.";
+  }
+
+  write_folded_node(stream, 0, "");
+}
+
+void GuestProfiler::write_code_log(std::string filename) {
+  std::ofstream stream(filename, std::ios::binary);
+  if (!stream.is_open()) {
+    throw "Could not open code/data log file.";
+  }
+
+  stream.write(reinterpret_cast<const char*>(code_log.data()),
+               code_log.size());
+}
+
+void GuestProfiler::write_report(std::string filename, size_t count) {
+  std::ofstream stream(filename);
+  if (!stream.is_open()) {
+    throw "Could not open profile report.";
+  }
+
+  char line[80];
+  double total = total_cycles ? static_cast<double>(total_cycles) : 1;
+
+  std::vector<int> pcs;
+  for (int pc = 0; pc < 0x10000; pc++) {
+    if (pc_cycles[pc]) {
+      pcs.push_back(pc);
+    }
+  }
+  std::sort(pcs.begin(), pcs.end(),
+            [this](int a, int b) { return pc_cycles[a] > pc_cycles[b]; });
+
+  stream << "PC      cycles        %\n";
+  for (size_t i = 0; i < pcs.size() && i < count; i++) {
+    snprintf(line, sizeof(line), "$%04X  %12" PRIu64 "  %5.1f\n", pcs[i],
+             pc_cycles[pcs[i]], 100 * pc_cycles[pcs[i]] / total);
+    stream << line;
+  }
+
+  std::vector<RoutineProfile> routines = get_routines();
+  stream << "\nRoutine  self cycles   self %   total cycles  total %\n";
+  for (size_t i = 0; i < routines.size() && i < count; i++) {
+    snprintf(line, sizeof(line),
+             "$%04X  %12" PRIu64 "  %5.1f  %12" PRIu64 "  %5.1f\n",
+             routines[i].address, routines[i].self_cycles,
+             100 * routines[i].self_cycles / total, routines[i].total_cycles,
+             100 * routines[i].total_cycles / total);
+    stream << line;
+  }
+}
@@ -0,0 +1,107 @@
+//
+//  GuestProfiler.h
+//  Emulator
+//
+//  Profiles the game rather than the emulator. While attached it keeps a
+//  code/data log of PRG ROM (which bytes ran as code, were read as data or
+//  were read as a pointer) and adds each instruction's cycles to its PC and
+//  to a call tree built by following JSR/RTS and interrupts. The call tree
+//  exports as folded stacks for flamegraph.pl or speedscope.
+//
+//  Like the debugger, the profiler switches the processor to a separately
+//  compiled execute loop, so it costs nothing while detached.
+//
+
+#ifndef __Emulator__GuestProfiler__
+#define __Emulator__GuestProfiler__
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "Instructions.h"
+#include "defines.h"
+
+class Processor;
+
+// Code/data log flags, one byte per PRG ROM byte. Code and data match the
+// low bits of FCEUX's .cdl files.
+const byte kCodeLogCode = 0x01;
+const byte kCodeLogData = 0x02;
+const byte kCodeLogPointer = 0x04;  // Read by JMP (ind) or as a vector
+
+struct RoutineProfile {
+  dbyte address;
+  uint64_t self_cycles;
+  uint64_t total_cycles;  // Including the routines it calls
+};
+
+class GuestProfiler {
+ private:
+  enum FrameKind { kFrameRoot, kFrameSubroutine, kFrameNMI, kFrameIRQ };
+
+  struct CallNode {
+    FrameKind kind;
+    dbyte address;  // The routine's entry point
+    int parent;
+    uint64_t cycles;  // Spent in this routine itself, on this path
+    std::vector<int> children;
+  };
+
+  // An open call; it returns once the stack pointer rises above `s`
+  struct Frame {
+    int node;
+    byte s;
+  };
+
+  static const size_t kMaxDepth = 256;
+
+  Processor* processor;
+
+  std::vector<byte> code_log;
+  std::vector<uint64_t> pc_cycles;
+  std::vector<CallNode> nodes;  // nodes[0] is the root
+  std::vector<Frame> frames;
+  uint64_t total_cycles;
+
+  // The instruction being profiled
+  dbyte start_pc;
+  byte start_s;
+  Function function;
+  byte last_s;  // After the previous instruction
+
+  void log_rom(dbyte address, byte flags);
+  void log_instruction();
+  void enter(FrameKind kind, dbyte address);
+  int current_node();
+  std::string node_name(int node);
+  void write_folded_node(std::ostream& stream, int node, std::string path);
+  uint64_t subtree_cycles(int node);
+
+ public:
+  GuestProfiler();
+
+  // Called by Emulator::set_profiler
+  void attach(Processor* processor);
+  void clear();
+
+  // Hooks called by the processor's profiling execute loop
+  void before_instruction();
+  void after_instruction(int cycles);
+
+  const std::vector<byte>& get_code_log();
+  uint64_t get_cycles_at(dbyte pc);
+  uint64_t get_total_cycles();
+
+  // Routines sorted by total cycles, most expensive first
+  std::vector<RoutineProfile> get_routines();
+
+  // One "main;$C123;$C456 <cycles>" line per call path
+  void write_folded_stacks(std::string filename);
+  void write_code_log(std::string filename);  // The raw log, one byte each
+  // The hottest PCs and routines as text
+  void write_report(std::string filename, size_t count);
+};
+
+#endif /* defined(__Emulator__GuestProfiler__) */
@@ -0,0 +1,43 @@
+//
+//  InputEventQueue.cpp
+//  Emulator
+//
+
+#include "InputEventQueue.h"
+
+#include <chrono>
+
+InputEventQueue::InputEventQueue() : events(kCapacity), dropped(0) {}
+
+uint64_t InputEventQueue::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool InputEventQueue::push(const InputEvent& event) {
+  if (!events.write(&event, 1)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool InputEventQueue::pop(uint64_t time, InputEvent& event) {
+  const InputEvent* oldest = events.peek();
+  if (!oldest || oldest->time > time) {
+    return false;
+  }
+
+  return events.read(&event, 1) == 1;
+}
+
+void InputEventQueue::set_poll_callback(std::function<void()> callback) {
+  poll = callback;
+}
+
+void InputEventQueue::run_poll_callback() {
+  if (poll) {
+    poll();
+  }
+}
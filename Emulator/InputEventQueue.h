@@ -0,0 +1,57 @@
+//
+//  InputEventQueue.h
+//  Emulator
+//
+//  Carries timestamped button presses from the thread that receives input
+//  to the emulation, without locking. The controller drains the queue each
+//  time the game strobes $4016, so a press lands in the first read after it
+//  happened instead of waiting for the next frame. Exactly one thread may
+//  push and one may drain.
+//
+
+#ifndef __Emulator__InputEventQueue__
+#define __Emulator__InputEventQueue__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "SPSCRing.h"
+#include "defines.h"
+
+struct InputEvent {
+  uint64_t time;   // steady_clock nanoseconds when the input happened
+  int controller;  // 0 or 1
+  byte button;     // One bit, in ControllerPad's button order
+  bool pressed;
+};
+
+class InputEventQueue {
+ private:
+  static const size_t kCapacity = 256;
+
+  SPSCRing<InputEvent> events;
+
+  std::function<void()> poll;
+
+ public:
+  std::atomic<uint64_t> dropped;
+
+  InputEventQueue();
+
+  static uint64_t now();  // steady_clock nanoseconds
+
+  // Producer. Returns false (and drops the event) if the queue is full.
+  bool push(const InputEvent& event);
+
+  // Consumer. Pops the oldest event if it happened at or before `time`.
+  bool pop(uint64_t time, InputEvent& event);
+
+  // Runs on the consumer before each drain. Lets a single-threaded app pump
+  // its event loop (which pushes) in the middle of a frame.
+  void set_poll_callback(std::function<void()> callback);
+  void run_poll_callback();
+};
+
+#endif /* defined(__Emulator__InputEventQueue__) */
@@ -0,0 +1,125 @@
+//
+//  InputMovie.cpp
+//  Emulator
+//
+//  Movie file layout (all integers little-endian):
+//
+//    0   "NMV\x1A"
+//    4   Format version
+//    5   Flags (bit 0: starts from a snapshot instead of power-on)
+//    6   Reserved
+//    8   Frame count (32 bits)
+//    12  Snapshot size in bytes (32 bits)
+//    16  Snapshot, then one byte of controller 1 buttons per frame
+//
+
+#include "InputMovie.h"
+
+#include <fstream>
+
+static const int kMovieHeaderSize = 16;
+// Version 1 snapshots predate the save-state version byte, so only version 1
+// movies that start from power-on can still be played back.
+static const byte kMovieVersion = 2;
+static const byte kPowerOnOnlyMovieVersion = 1;
+static const byte kMovieFromSnapshot = 0x01;
+
+static void write_uint32(byte* destination, uint32_t value) {
+  destination[0] = value;
+  destination[1] = value >> 8;
+  destination[2] = value >> 16;
+  destination[3] = value >> 24;
+}
+
+static uint32_t read_uint32(const byte* source) {
+  return source[0] | source[1] << 8 | source[2] << 16 |
+         static_cast<uint32_t>(source[3]) << 24;
+}
+
+InputMovie::InputMovie() : playback_position(0) {}
+
+InputMovie::InputMovie(std::vector<byte> snapshot)
+    : snapshot(std::move(snapshot)), playback_position(0) {}
+
+InputMovie::InputMovie(std::string filename) : playback_position(0) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+
+  if (!file.is_open()) {
+    throw "Could not open movie for reading.";
+  }
+
+  byte header[kMovieHeaderSize];
+  file.read(reinterpret_cast<char*>(header), kMovieHeaderSize);
+
+  if (!file || !(header[0] == 'N' && header[1] == 'M' && header[2] == 'V' &&
+                 header[3] == '\x1A')) {
+    throw "This is not a valid movie file!";
+  }
+
+  if (header[4] != kMovieVersion &&
+      !(header[4] == kPowerOnOnlyMovieVersion &&
+        !(header[5] & kMovieFromSnapshot))) {
+    throw "Unsupported movie version.";
+  }
+
+  uint32_t frame_count = read_uint32(header + 8);
+  uint32_t snapshot_size = read_uint32(header + 12);
+  if (!(header[5] & kMovieFromSnapshot)) {
+    snapshot_size = 0;
+  }
+
+  // Check the sizes before allocating for them
+  std::streampos position = file.tellg();
+  file.seekg(0, std::ios::end);
+  uint64_t remaining = static_cast<uint64_t>(file.tellg() - position);
+  file.seekg(position);
+  if (static_cast<uint64_t>(snapshot_size) + frame_count > remaining) {
+    throw "Movie file is truncated.";
+  }
+
+  if (snapshot_size) {
+    snapshot.resize(snapshot_size);
+    file.read(reinterpret_cast<char*>(snapshot.data()), snapshot_size);
+  }
+
+  frames.resize(frame_count);
+  file.read(reinterpret_cast<char*>(frames.data()), frame_count);
+
+  if (!file) {
+    throw "Movie file is truncated.";
+  }
+}
+
+void InputMovie::save(std::string filename) {
+  std::ofstream file(filename,
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open()) {
+    throw "Could not open movie for writing.";
+  }
+
+  byte header[kMovieHeaderSize] = {'N', 'M', 'V', '\x1A', kMovieVersion};
+  header[5] = starts_from_snapshot() ? kMovieFromSnapshot : 0;
+  write_uint32(header + 8, static_cast<uint32_t>(frames.size()));
+  write_uint32(header + 12, static_cast<uint32_t>(snapshot.size()));
+
+  file.write(reinterpret_cast<const char*>(header), kMovieHeaderSize);
+  file.write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size());
+  file.write(reinterpret_cast<const char*>(frames.data()), frames.size());
+}
+
+bool InputMovie::starts_from_snapshot() { return !snapshot.empty(); }
+
+const std::vector<byte>& InputMovie::get_snapshot() { return snapshot; }
+
+size_t InputMovie::frame_count() { return frames.size(); }
+
+void InputMovie::record_frame(byte buttons) { frames.push_back(buttons); }
+
+bool InputMovie::has_next_frame() {
+  return playback_position < frames.size();
+}
+
+byte InputMovie::next_frame() { return frames.at(playback_position++); }
+
+void InputMovie::rewind() { playback_position = 0; }
@@ -0,0 +1,41 @@
+//
+//  InputMovie.h
+//  Emulator
+//
+//  A recording of the controller state for every emulated frame. Replaying
+//  a movie from the same starting point reproduces the same frames exactly.
+//
+
+#ifndef __Emulator__InputMovie__
+#define __Emulator__InputMovie__
+
+#include <string>
+#include <vector>
+
+#include "defines.h"
+
+class InputMovie {
+ private:
+  std::vector<byte> snapshot;  // Empty if the movie starts at power-on
+  std::vector<byte> frames;    // Packed controller 1 buttons, one per frame
+  size_t playback_position;
+
+ public:
+  InputMovie();
+  InputMovie(std::vector<byte> snapshot);
+  InputMovie(std::string filename);
+
+  void save(std::string filename);
+
+  bool starts_from_snapshot();
+  const std::vector<byte>& get_snapshot();
+  size_t frame_count();
+
+  void record_frame(byte buttons);
+
+  bool has_next_frame();
+  byte next_frame();
+  void rewind();
+};
+
+#endif /* defined(__Emulator__InputMovie__) */
@@ -181,11 +181,48 @@ static std::map<byte, Instruction> INSTRUCTIONS = {
   {0xFD, {SBC, AbsoluteX,     4}},
   {0xFE, {INC, AbsoluteX,     7}},
 };
+
+// In the order of the Function enum
+static const char* FUNCTION_NAMES[] = {
+  "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI",
+  "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD", "CLI",
+  "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR",
+  "INC", "INX", "INY", "JMP", "JSR", "LDA", "LDX", "LDY",
+  "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL",
+  "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI", "STA",
+  "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+};
 // clang-format on
 
 Instruction get_instruction(byte opcode) {
-  // Throws an exception if opcode not found
-  return INSTRUCTIONS.at(opcode);
+  auto instruction = INSTRUCTIONS.find(opcode);
+  if (instruction == INSTRUCTIONS.end()) {
+    throw "Unrecognized instruction.";
+  }
+  return instruction->second;
+}
+
+bool is_valid_opcode(byte opcode) { return INSTRUCTIONS.count(opcode) != 0; }
+
+const char* get_function_name(Function function) {
+  return FUNCTION_NAMES[function];
+}
+
+int get_instruction_length(AddressType address_type) {
+  switch (address_type) {
+    case Implied:
+    case Accumulator:
+      return 1;
+
+    case Absolute:
+    case AbsoluteX:
+    case AbsoluteY:
+    case Indirect:
+      return 3;
+
+    default:
+      return 2;
+  }
 }
 
 bool is_read_instruction(Function function) {
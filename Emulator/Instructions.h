@@ -93,6 +93,10 @@ typedef struct Instruction {
 } Instruction;
 
 extern Instruction get_instruction(byte opcode);
+extern bool is_valid_opcode(byte opcode);
+
+extern const char* get_function_name(Function function);  // e.g. "LDA"
+extern int get_instruction_length(AddressType address_type);  // In bytes
 
 extern bool is_read_instruction(Function function);
 
@@ -0,0 +1,111 @@
+//
+//  MMC1.cpp
+//  Emulator
+//
+
+#include "MMC1.h"
+
+static const byte kShiftRegisterEmpty = 0x10;
+static const byte kShiftResetMask = 0x80;
+
+// Control register
+static const byte kMirroringMask = 0x03;
+static const byte kPRGModeMask = 0x0C;
+static const byte kPRGModeFixLast = 0x0C;
+static const byte kPRGModeFixFirst = 0x08;
+static const byte kCHR4KBModeMask = 0x10;
+
+static const Mirroring kMirroringModes[] = {
+    kMirroringSingleScreenLow, kMirroringSingleScreenHigh, kMirroringVertical,
+    kMirroringHorizontal};
+
+void MMC1::reset() {
+  shift_register = kShiftRegisterEmpty;
+  control = kPRGModeFixLast;
+  chr_bank_0 = 0;
+  chr_bank_1 = 0;
+  prg_bank = 0;
+  update_banks();
+}
+
+void MMC1::update_banks() {
+  set_mirroring(kMirroringModes[control & kMirroringMask]);
+
+  switch (control & kPRGModeMask) {
+    case kPRGModeFixLast:
+      map_prg_bank(0x8000, 0x4000, prg_bank & 0x0F);
+      map_prg_bank(0xC000, 0x4000, -1);
+      break;
+    case kPRGModeFixFirst:
+      map_prg_bank(0x8000, 0x4000, 0);
+      map_prg_bank(0xC000, 0x4000, prg_bank & 0x0F);
+      break;
+    default:
+      // 32 KB mode ignores the low bit of the bank number
+      map_prg_bank(0x8000, 0x4000, prg_bank & 0x0E);
+      map_prg_bank(0xC000, 0x4000, (prg_bank & 0x0E) | 1);
+      break;
+  }
+
+  if (control & kCHR4KBModeMask) {
+    map_chr_bank(0x0000, 0x1000, chr_bank_0);
+    map_chr_bank(0x1000, 0x1000, chr_bank_1);
+  } else {
+    map_chr_bank(0x0000, 0x2000, chr_bank_0 >> 1);
+  }
+}
+
+//
+// Each write shifts one bit into the shift register; the fifth write copies
+// it to the register selected by address bits 13-14.
+//
+void MMC1::write_register(dbyte address, byte value) {
+  if (value & kShiftResetMask) {
+    shift_register = kShiftRegisterEmpty;
+    control |= kPRGModeFixLast;
+    update_banks();
+    return;
+  }
+
+  bool full = shift_register & 0x01;
+  shift_register = (shift_register >> 1) | ((value & 0x01) << 4);
+
+  if (!full) {
+    return;
+  }
+
+  switch ((address >> 13) & 0x03) {
+    case 0:
+      control = shift_register;
+      break;
+    case 1:
+      chr_bank_0 = shift_register;
+      break;
+    case 2:
+      chr_bank_1 = shift_register;
+      break;
+    case 3:
+      prg_bank = shift_register;
+      break;
+  }
+
+  shift_register = kShiftRegisterEmpty;
+  update_banks();
+}
+
+void MMC1::save_state(StateWriter& writer) {
+  writer.write(shift_register);
+  writer.write(control);
+  writer.write(chr_bank_0);
+  writer.write(chr_bank_1);
+  writer.write(prg_bank);
+}
+
+void MMC1::load_state(StateReader& reader) {
+  reader.read(shift_register);
+  reader.read(control);
+  reader.read(chr_bank_0);
+  reader.read(chr_bank_1);
+  reader.read(prg_bank);
+  Mapper::load_state(reader);
+}
@@ -0,0 +1,34 @@
+//
+//  MMC1.h
+//  Emulator
+//
+//  Mapper 1 (MMC1): registers are loaded one bit at a time through a serial
+//  shift register. Supports 16/32 KB PRG and 4/8 KB CHR banking modes.
+//
+
+#ifndef __Emulator__MMC1__
+#define __Emulator__MMC1__
+
+#include "Mapper.h"
+
+class MMC1 : public Mapper {
+ private:
+  byte shift_register;  // A 1 in bit 4 marks the register as full
+  byte control;
+  byte chr_bank_0;
+  byte chr_bank_1;
+  byte prg_bank;
+
+  void update_banks() override;
+
+ public:
+  using Mapper::Mapper;
+
+  void reset() override;
+  void write_register(dbyte address, byte value) override;
+
+  void save_state(StateWriter& writer) override;
+  void load_state(StateReader& reader) override;
+};
+
+#endif /* defined(__Emulator__MMC1__) */
@@ -0,0 +1,125 @@
+//
+//  MMC3.cpp
+//  Emulator
+//
+
+#include "MMC3.h"
+
+#include <cstring>
+
+#include "Processor.h"
+
+static const byte kBankRegisterMask = 0x07;
+static const byte kPRGModeMask = 0x40;
+static const byte kCHRInversionMask = 0x80;
+
+void MMC3::reset() {
+  bank_select = 0;
+  ::memset(bank_registers, 0, sizeof(bank_registers));
+
+  irq_latch = 0;
+  irq_counter = 0;
+  irq_reload = false;
+  irq_enabled = false;
+  irq_asserted = false;
+  processor->set_irq_line(kIRQMapper, false);
+
+  Mapper::reset();
+}
+
+void MMC3::update_banks() {
+  // R6 is switchable at $8000 or $C000; the other slot holds the second to
+  // last bank
+  dbyte r6_address = bank_select & kPRGModeMask ? 0xC000 : 0x8000;
+  map_prg_bank(r6_address, 0x2000, bank_registers[6]);
+  map_prg_bank(r6_address ^ 0x4000, 0x2000, -2);
+  map_prg_bank(0xA000, 0x2000, bank_registers[7]);
+  map_prg_bank(0xE000, 0x2000, -1);
+
+  // Two 2 KB banks (R0, R1) and four 1 KB banks (R2-R5); inversion swaps the
+  // two halves of the pattern table
+  dbyte inversion = bank_select & kCHRInversionMask ? 0x1000 : 0x0000;
+  map_chr_bank(inversion ^ 0x0000, 0x0800, bank_registers[0] >> 1);
+  map_chr_bank(inversion ^ 0x0800, 0x0800, bank_registers[1] >> 1);
+  for (int i = 0; i < 4; i++) {
+    map_chr_bank(inversion ^ (0x1000 + i * 0x0400), 0x0400,
+                 bank_registers[2 + i]);
+  }
+}
+
+void MMC3::write_register(dbyte address, byte value) {
+  bool odd = address & 0x01;
+
+  switch (address & 0xE000) {
+    case 0x8000:
+      if (odd) {
+        bank_registers[bank_select & kBankRegisterMask] = value;
+      } else {
+        bank_select = value;
+      }
+      update_banks();
+      break;
+    case 0xA000:
+      if (!odd) {
+        set_mirroring(value & 0x01 ? kMirroringHorizontal : kMirroringVertical);
+      }
+      // Odd: PRG RAM protect, not emulated
+      break;
+    case 0xC000:
+      if (odd) {
+        irq_counter = 0;
+        irq_reload = true;
+      } else {
+        irq_latch = value;
+      }
+      break;
+    case 0xE000:
+      irq_enabled = odd;
+      if (!irq_enabled) {
+        // Disabling also acknowledges a pending interrupt
+        irq_asserted = false;
+        processor->set_irq_line(kIRQMapper, false);
+      }
+      break;
+  }
+}
+
+//
+// The real counter is clocked by A12 rising on the PPU bus, which happens once
+// per scanline with the usual pattern table layout.
+//
+void MMC3::clock_scanline() {
+  if (irq_counter == 0 || irq_reload) {
+    irq_counter = irq_latch;
+    irq_reload = false;
+  } else {
+    irq_counter--;
+  }
+
+  if (irq_counter == 0 && irq_enabled) {
+    irq_asserted = true;
+    processor->set_irq_line(kIRQMapper, true);
+  }
+}
+
+void MMC3::save_state(StateWriter& writer) {
+  writer.write(bank_select);
+  writer.write(bank_registers);
+  writer.write(irq_latch);
+  writer.write(irq_counter);
+  writer.write(irq_reload);
+  writer.write(irq_enabled);
+  writer.write(irq_asserted);
+}
+
+void MMC3::load_state(StateReader& reader) {
+  reader.read(bank_select);
+  reader.read(bank_registers);
+  reader.read(irq_latch);
+  reader.read(irq_counter);
+  reader.read(irq_reload);
+  reader.read(irq_enabled);
+  reader.read(irq_asserted);
+  processor->set_irq_line(kIRQMapper, irq_asserted);
+  Mapper::load_state(reader);
+}
@@ -0,0 +1,38 @@
+//
+//  MMC3.h
+//  Emulator
+//
+//  Mapper 4 (MMC3): 8 KB PRG and 1/2 KB CHR banks, plus a scanline counter
+//  that raises an IRQ.
+//
+
+#ifndef __Emulator__MMC3__
+#define __Emulator__MMC3__
+
+#include "Mapper.h"
+
+class MMC3 : public Mapper {
+ private:
+  byte bank_select;
+  byte bank_registers[8];
+
+  byte irq_latch;
+  byte irq_counter;
+  bool irq_reload;
+  bool irq_enabled;
+  bool irq_asserted;
+
+  void update_banks() override;
+
+ public:
+  using Mapper::Mapper;
+
+  void reset() override;
+  void write_register(dbyte address, byte value) override;
+  void clock_scanline() override;
+
+  void save_state(StateWriter& writer) override;
+  void load_state(StateReader& reader) override;
+};
+
+#endif /* defined(__Emulator__MMC3__) */
@@ -0,0 +1,129 @@
+//
+//  Mapper.cpp
+//  Emulator
+//
+
+#include "Mapper.h"
+
+#include <limits>
+
+#include "AxROM.h"
+#include "CNROM.h"
+#include "MMC1.h"
+#include "MMC3.h"
+#include "NROM.h"
+#include "PPU.h"
+#include "Processor.h"
+#include "RomReader.h"
+#include "UxROM.h"
+
+static const size_t kLargestPRGBank = 0x4000;
+static const size_t kLargestCHRBank = 0x2000;
+static const size_t kSmallestPRGBank = 0x2000;
+static const size_t kSmallestCHRBank = 0x0400;
+
+Mapper::Mapper(RomReader& reader, Processor* processor, PPU* ppu)
+    : processor(processor),
+      ppu(ppu),
+      image(reader.get_image()),
+      prg_rom(reader.get_prg_rom()),
+      prg_rom_size(reader.get_prg_rom_size()),
+      chr_rom(reader.get_chr_rom()),
+      chr_rom_size(reader.get_chr_rom_size()),
+      header_mirroring(reader.get_mirroring()) {
+  // map_prg_bank and map_chr_bank need at least one of the largest bank any
+  // mapper switches. NES 2.0 headers can declare less.
+  if (prg_rom_size < kLargestPRGBank) {
+    throw "Program ROM is smaller than one 16 KB bank.";
+  }
+  if (chr_rom && chr_rom_size < kLargestCHRBank) {
+    throw "Character ROM is smaller than one 8 KB bank.";
+  }
+
+  // Bank numbers are ints
+  const size_t max_banks = std::numeric_limits<int>::max();
+  if (prg_rom_size / kSmallestPRGBank > max_banks ||
+      chr_rom_size / kSmallestCHRBank > max_banks) {
+    throw "ROM has more banks than a mapper can address.";
+  }
+}
+
+Mapper::Mapper(Processor* processor, PPU* ppu)
+    : processor(processor),
+      ppu(ppu),
+      prg_rom(nullptr),
+      prg_rom_size(0),
+      chr_rom(nullptr),
+      chr_rom_size(0),
+      header_mirroring(kMirroringVertical) {}
+
+Mapper::~Mapper() {}
+
+std::unique_ptr<Mapper> Mapper::create(RomReader& reader, Processor* processor,
+                                       PPU* ppu) {
+  switch (reader.get_mapper_number()) {
+    case 0:
+      return std::make_unique<NROM>(reader, processor, ppu);
+    case 1:
+      return std::make_unique<MMC1>(reader, processor, ppu);
+    case 2:
+      return std::make_unique<UxROM>(reader, processor, ppu);
+    case 3:
+      return std::make_unique<CNROM>(reader, processor, ppu);
+    case 4:
+      return std::make_unique<MMC3>(reader, processor, ppu);
+    case 7:
+      return std::make_unique<AxROM>(reader, processor, ppu);
+    default:
+      throw "Unsupported memory mapper.";
+  }
+}
+
+void Mapper::reset() {
+  set_mirroring(header_mirroring);
+  update_banks();
+}
+
+const byte* Mapper::get_prg_rom() { return prg_rom; }
+
+size_t Mapper::get_prg_rom_size() { return prg_rom_size; }
+
+void Mapper::write_expansion(dbyte address, byte value) {}
+
+void Mapper::clock_scanline() {}
+
+void Mapper::save_state(StateWriter& writer) {}
+
+void Mapper::load_state(StateReader& reader) { update_banks(); }
+
+void Mapper::map_prg_bank(dbyte address, size_t bank_size, int bank) {
+  int banks = static_cast<int>(prg_rom_size / bank_size);
+  bank %= banks;
+  if (bank < 0) {
+    bank += banks;
+  }
+
+  processor->map_prg_rom(address, bank_size, prg_rom + bank * bank_size);
+}
+
+void Mapper::map_chr_bank(dbyte address, size_t bank_size, int bank) {
+  if (!chr_rom) {
+    // CHR RAM is a fixed 8 KB in the PPU
+    return;
+  }
+
+  int banks = static_cast<int>(chr_rom_size / bank_size);
+  bank %= banks;
+  if (bank < 0) {
+    bank += banks;
+  }
+
+  ppu->map_pattern_table(address, bank_size, chr_rom + bank * bank_size);
+}
+
+void Mapper::set_mirroring(Mirroring mirroring) {
+  // Four-screen cartridges have their own VRAM and ignore the mapper
+  if (header_mirroring != kMirroringFourScreen) {
+    ppu->set_mirroring(mirroring);
+  }
+}
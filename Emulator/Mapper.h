@@ -0,0 +1,77 @@
+//
+//  Mapper.h
+//  Emulator
+//
+//  Cartridge mappers. A mapper holds the cartridge's ROM image and switches
+//  banks by pointing the processor's and PPU's page tables into
+//  them; bank data is never copied.
+//
+
+#ifndef __Emulator__Mapper__
+#define __Emulator__Mapper__
+
+#include <memory>
+
+#include "RomImage.h"
+#include "SaveState.h"
+#include "defines.h"
+
+class PPU;
+class Processor;
+class RomReader;
+
+class Mapper {
+ protected:
+  Processor* processor;
+  PPU* ppu;
+
+  // Banks point into the shared image
+  std::shared_ptr<const RomImage> image;
+  const byte* prg_rom;
+  size_t prg_rom_size;
+  const byte* chr_rom;  // nullptr when the cartridge has CHR RAM
+  size_t chr_rom_size;
+  Mirroring header_mirroring;
+
+  // Maps bank `bank` (of size `bank_size`) at `address`. Banks wrap around
+  // the ROM size, and negative banks count from the end: -1 is the last.
+  // Cartridges must hold one of the largest banks (16 KB of PRG ROM, 8 KB of
+  // CHR ROM), so 32 KB PRG windows are mapped as two 16 KB banks.
+  void map_prg_bank(dbyte address, size_t bank_size, int bank);
+  void map_chr_bank(dbyte address, size_t bank_size, int bank);
+  void set_mirroring(Mirroring mirroring);
+
+  // Applies the bank registers to the page tables
+  virtual void update_banks() = 0;
+
+  // For images that aren't iNES cartridges; the subclass points prg_rom at
+  // its data
+  Mapper(Processor* processor, PPU* ppu);
+
+ public:
+  Mapper(RomReader& reader, Processor* processor, PPU* ppu);
+  virtual ~Mapper();
+
+  // Throws if the cartridge's mapper isn't supported
+  static std::unique_ptr<Mapper> create(RomReader& reader,
+                                        Processor* processor, PPU* ppu);
+
+  virtual void reset();
+
+  const byte* get_prg_rom();
+  size_t get_prg_rom_size();
+
+  // CPU writes to $8000-$FFFF
+  virtual void write_register(dbyte address, byte value) = 0;
+
+  // CPU writes to the expansion area, $4020-$5FFF
+  virtual void write_expansion(dbyte address, byte value);
+
+  // Called at the end of each rendered scanline (and the pre-render line)
+  virtual void clock_scanline();
+
+  virtual void save_state(StateWriter& writer);
+  virtual void load_state(StateReader& reader);
+};
+
+#endif /* defined(__Emulator__Mapper__) */
@@ -0,0 +1,16 @@
+//
+//  NROM.cpp
+//  Emulator
+//
+
+#include "NROM.h"
+
+void NROM::update_banks() {
+  map_prg_bank(0x8000, 0x4000, 0);
+  map_prg_bank(0xC000, 0x4000, -1);
+  map_chr_bank(0x0000, 0x2000, 0);
+}
+
+void NROM::write_register(dbyte address, byte value) {
+  // Writes to ROM are ignored
+}
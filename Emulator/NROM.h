@@ -0,0 +1,24 @@
+//
+//  NROM.h
+//  Emulator
+//
+//  Mapper 0: no bank switching. 16 KB PRG ROMs appear at both $8000 and
+//  $C000.
+//
+
+#ifndef __Emulator__NROM__
+#define __Emulator__NROM__
+
+#include "Mapper.h"
+
+class NROM : public Mapper {
+ private:
+  void update_banks() override;
+
+ public:
+  using Mapper::Mapper;
+
+  void write_register(dbyte address, byte value) override;
+};
+
+#endif /* defined(__Emulator__NROM__) */
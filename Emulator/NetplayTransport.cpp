@@ -0,0 +1,152 @@
+//
+//  NetplayTransport.cpp
+//  Emulator
+//
+
+#include "NetplayTransport.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+static const size_t kMaxPacketSize = 1500;
+
+NetplayTransport::~NetplayTransport() {}
+
+UdpTransport::UdpTransport(int local_port, std::string peer_host,
+                           int peer_port) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  addrinfo* peer = nullptr;
+  std::string port = std::to_string(peer_port);
+  if (getaddrinfo(peer_host.c_str(), port.c_str(), &hints, &peer) != 0) {
+    throw "Could not resolve netplay peer.";
+  }
+
+  byte* peer_bytes = reinterpret_cast<byte*>(peer->ai_addr);
+  peer_address.assign(peer_bytes, peer_bytes + peer->ai_addrlen);
+  int family = peer->ai_family;
+  freeaddrinfo(peer);
+
+  socket_fd = socket(family, SOCK_DGRAM, 0);
+  if (socket_fd < 0) {
+    throw "Could not create netplay socket.";
+  }
+
+  sockaddr_storage local = {};
+  socklen_t local_length;
+  if (family == AF_INET6) {
+    sockaddr_in6* address = reinterpret_cast<sockaddr_in6*>(&local);
+    address->sin6_family = AF_INET6;
+    address->sin6_addr = in6addr_any;
+    address->sin6_port = htons(local_port);
+    local_length = sizeof(sockaddr_in6);
+  } else {
+    sockaddr_in* address = reinterpret_cast<sockaddr_in*>(&local);
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = htonl(INADDR_ANY);
+    address->sin_port = htons(local_port);
+    local_length = sizeof(sockaddr_in);
+  }
+
+  if (bind(socket_fd, reinterpret_cast<sockaddr*>(&local), local_length) < 0 ||
+      fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK) < 0) {
+    close(socket_fd);
+    throw "Could not bind netplay socket.";
+  }
+}
+
+UdpTransport::~UdpTransport() { close(socket_fd); }
+
+void UdpTransport::send(const std::vector<byte>& packet) {
+  // Losing a packet to a full socket buffer is no worse than losing it on
+  // the network
+  sendto(socket_fd, packet.data(), packet.size(), 0,
+         reinterpret_cast<const sockaddr*>(peer_address.data()),
+         static_cast<socklen_t>(peer_address.size()));
+}
+
+bool UdpTransport::receive(std::vector<byte>& packet) {
+  packet.resize(kMaxPacketSize);
+
+  while (true) {
+    sockaddr_storage sender;
+    socklen_t sender_length = sizeof(sender);
+    ssize_t length =
+        recvfrom(socket_fd, packet.data(), packet.size(), 0,
+                 reinterpret_cast<sockaddr*>(&sender), &sender_length);
+    if (length < 0) {
+      return false;
+    }
+
+    // Ignore anyone but the peer
+    if (sender_length == peer_address.size() &&
+        !::memcmp(&sender, peer_address.data(), sender_length)) {
+      packet.resize(length);
+      return true;
+    }
+  }
+}
+
+LoopbackNetwork::Endpoint::Endpoint(LoopbackNetwork* network, int index)
+    : network(network), index(index) {}
+
+void LoopbackNetwork::Endpoint::send(const std::vector<byte>& packet) {
+  LoopbackNetwork& n = *network;
+  n.sent++;
+
+  std::uniform_real_distribution<double> uniform(0, 1);
+  if (uniform(n.random) < n.loss) {
+    n.lost++;
+    return;
+  }
+
+  double delay = n.latency_ms + uniform(n.random) * n.jitter_ms;
+  n.in_flight[1 - index].push_back({n.time_ms + delay, packet});
+}
+
+bool LoopbackNetwork::Endpoint::receive(std::vector<byte>& packet) {
+  std::vector<Packet>& queue = network->in_flight[index];
+
+  // Jitter can reorder packets; take the earliest one that has arrived
+  auto next = std::min_element(queue.begin(), queue.end(),
+                               [](const Packet& a, const Packet& b) {
+                                 return a.delivery_time < b.delivery_time;
+                               });
+  if (next == queue.end() || next->delivery_time > network->time_ms) {
+    return false;
+  }
+
+  packet = std::move(next->data);
+  queue.erase(next);
+  return true;
+}
+
+LoopbackNetwork::LoopbackNetwork(double latency_ms, double jitter_ms,
+                                 double loss, unsigned seed)
+    : latency_ms(latency_ms),
+      jitter_ms(jitter_ms),
+      loss(loss),
+      random(seed),
+      time_ms(0),
+      endpoints{Endpoint(this, 0), Endpoint(this, 1)},
+      sent(0),
+      lost(0) {}
+
+NetplayTransport* LoopbackNetwork::get_endpoint(int index) {
+  return &endpoints[index];
+}
+
+void LoopbackNetwork::set_time(double time_ms) { this->time_ms = time_ms; }
+
+uint64_t LoopbackNetwork::get_sent() { return sent; }
+
+uint64_t LoopbackNetwork::get_lost() { return lost; }
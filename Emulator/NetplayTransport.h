@@ -0,0 +1,91 @@
+//
+//  NetplayTransport.h
+//  Emulator
+//
+//  Unreliable datagram links between two netplay peers. Packets may be
+//  lost, duplicated or reordered; the rollback session tolerates all three.
+//
+
+#ifndef __Emulator__NetplayTransport__
+#define __Emulator__NetplayTransport__
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "defines.h"
+
+class NetplayTransport {
+ public:
+  virtual ~NetplayTransport();
+
+  virtual void send(const std::vector<byte>& packet) = 0;
+
+  // Never blocks. Returns false when no packet is waiting.
+  virtual bool receive(std::vector<byte>& packet) = 0;
+};
+
+// A non-blocking UDP socket that only talks to one peer
+class UdpTransport : public NetplayTransport {
+ private:
+  int socket_fd;
+  std::vector<byte> peer_address;  // A struct sockaddr of the peer
+
+ public:
+  // Throws if the port can't be bound or the peer can't be resolved
+  UdpTransport(int local_port, std::string peer_host, int peer_port);
+  ~UdpTransport();
+
+  void send(const std::vector<byte>& packet) override;
+  bool receive(std::vector<byte>& packet) override;
+};
+
+//
+// Two endpoints joined in memory, for testing. Each packet is delivered
+// `latency_ms` (plus up to `jitter_ms`) after it's sent, or lost with
+// probability `loss`. Time only moves when set_time is called, so runs are
+// repeatable for a given seed.
+//
+class LoopbackNetwork {
+ private:
+  struct Packet {
+    double delivery_time;
+    std::vector<byte> data;
+  };
+
+  class Endpoint : public NetplayTransport {
+   private:
+    LoopbackNetwork* network;
+    int index;
+
+   public:
+    Endpoint(LoopbackNetwork* network, int index);
+    void send(const std::vector<byte>& packet) override;
+    bool receive(std::vector<byte>& packet) override;
+  };
+
+  double latency_ms;
+  double jitter_ms;
+  double loss;
+  std::mt19937 random;
+
+  double time_ms;
+  std::vector<Packet> in_flight[2];  // Indexed by the receiving endpoint
+  Endpoint endpoints[2];
+
+  uint64_t sent;
+  uint64_t lost;
+
+ public:
+  LoopbackNetwork(double latency_ms, double jitter_ms, double loss,
+                  unsigned seed);
+
+  NetplayTransport* get_endpoint(int index);
+  void set_time(double time_ms);
+
+  uint64_t get_sent();
+  uint64_t get_lost();
+};
+
+#endif /* defined(__Emulator__NetplayTransport__) */
@@ -0,0 +1,218 @@
+//
+//  NsfPlayer.cpp
+//  Emulator
+//
+
+#include "NsfPlayer.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const double kCPUClockRate = 39375000.0 / 22;  // NTSC
+static const int kDefaultSpeed = 16639;  // Microseconds; the NTSC frame rate
+
+static const size_t kBankSize = 0x1000;
+static const dbyte kBankRegisters = 0x5FF8;  // $5FF8-$5FFF select $8000-$FFFF
+
+// Routines called by the player return here, an address no code runs from
+static const dbyte kReturnAddress = 0x4100;
+
+// Init routines may decompress data or wait out a few frames
+static const uint64_t kInitCycleLimit = static_cast<uint64_t>(kCPUClockRate);
+
+static dbyte read_dbyte(const byte* data) { return data[0] | data[1] << 8; }
+
+// Header strings are padded with zeros, but may fill their field
+static std::string read_string(const byte* data, size_t length) {
+  const char* text = reinterpret_cast<const char*>(data);
+  return std::string(text, strnlen(text, length));
+}
+
+NsfHeader::NsfHeader(const byte* data, size_t size) {
+  if (size < kSize || ::memcmp(data, "NESM\x1A", 5)) {
+    throw "This is not a valid NSF file.";
+  }
+
+  version = data[0x05];
+  songs = data[0x06];
+  starting_song = data[0x07];
+  load_address = read_dbyte(data + 0x08);
+  init_address = read_dbyte(data + 0x0A);
+  play_address = read_dbyte(data + 0x0C);
+  name = read_string(data + 0x0E, 32);
+  artist = read_string(data + 0x2E, 32);
+  copyright = read_string(data + 0x4E, 32);
+  ntsc_speed = read_dbyte(data + 0x6E);
+  ::memcpy(initial_banks, data + 0x70, sizeof(initial_banks));
+  expansion_chips = data[0x7B];
+
+  bank_switched = false;
+  for (byte bank : initial_banks) {
+    bank_switched |= bank != 0;
+  }
+
+  if (songs == 0 || (!bank_switched && load_address < 0x8000)) {
+    throw "This is not a valid NSF file.";
+  }
+  if (starting_song < 1 || starting_song > songs) {
+    starting_song = 1;
+  }
+  if (ntsc_speed == 0) {
+    ntsc_speed = kDefaultSpeed;
+  }
+}
+
+//
+// The NSF's data, laid out in 4 KB banks for $8000-$FFFF. Bank-switched
+// files are offset within their first bank by the low bits of the load
+// address; the others are placed at the load address in 32 KB.
+//
+class NsfMapper : public Mapper {
+ private:
+  std::vector<byte> data;
+  byte initial_banks[8];
+  byte banks[8];
+
+  void update_banks() override {
+    for (int i = 0; i < 8; i++) {
+      map_prg_bank(0x8000 + i * kBankSize, kBankSize, banks[i]);
+    }
+  }
+
+ public:
+  NsfMapper(Processor* processor, PPU* ppu, const NsfHeader& header,
+            const byte* music, size_t size)
+      : Mapper(processor, ppu) {
+    size_t offset;
+    if (header.bank_switched) {
+      offset = header.load_address & (kBankSize - 1);
+      ::memcpy(initial_banks, header.initial_banks, sizeof(initial_banks));
+    } else {
+      offset = header.load_address - 0x8000;
+      size = std::min(size, 0x8000 - offset);
+      for (int i = 0; i < 8; i++) {
+        initial_banks[i] = i;
+      }
+    }
+
+    size_t banks_needed =
+        std::max<size_t>((offset + size + kBankSize - 1) / kBankSize,
+                         header.bank_switched ? 1 : 8);
+    data.resize(banks_needed * kBankSize);
+    std::copy(music, music + size, data.begin() + offset);
+
+    prg_rom = data.data();
+    prg_rom_size = data.size();
+  }
+
+  void reset() override {
+    ::memcpy(banks, initial_banks, sizeof(banks));
+    Mapper::reset();
+  }
+
+  void write_register(dbyte address, byte value) override {}
+
+  void write_expansion(dbyte address, byte value) override {
+    if (address >= kBankRegisters) {
+      int slot = address - kBankRegisters;
+      banks[slot] = value;
+      map_prg_bank(0x8000 + slot * kBankSize, kBankSize, value);
+    }
+  }
+};
+
+NsfPlayer::NsfPlayer(std::string filename)
+    : image(RomImage::open(filename)),
+      header(image->get_data(), image->get_size()),
+      ppu(true),
+      processor(std::make_unique<Processor>(&ppu, &controller_pad)),
+      apu(processor.get()),
+      song(0),
+      play_period(header.ntsc_speed * kCPUClockRate / 1000000),
+      next_play_time(0) {
+  mapper = std::make_unique<NsfMapper>(
+      processor.get(), &ppu, header, image->get_data() + NsfHeader::kSize,
+      image->get_size() - NsfHeader::kSize);
+  processor->set_mapper(mapper.get());
+  processor->set_apu(&apu);
+
+  start_song(header.starting_song);
+}
+
+const NsfHeader& NsfPlayer::get_header() { return header; }
+
+void NsfPlayer::set_audio_sample_rate(double sample_rate) {
+  apu.set_sample_rate(sample_rate);
+}
+
+void NsfPlayer::start_song(int song) {
+  this->song = std::max(1, std::min(song, header.songs));
+
+  mapper->reset();
+  processor->power_on();  // Clears RAM
+  apu.power_on();
+
+  // The state the NSF specification promises init routines
+  for (dbyte address = 0x4000; address <= 0x4013; address++) {
+    apu.write_register(address, 0x00, 0);
+  }
+  apu.write_register(0x4015, 0x0F, 0);
+  apu.write_register(0x4017, 0x40, 0);
+
+  // A = song (0-based), X = 0 for NTSC
+  call(header.init_address, this->song - 1, 0, kInitCycleLimit);
+
+  // Anything init played is discarded
+  apu.end_frame(processor->cycle_count);
+  audio_samples.resize(apu.samples_available());
+  apu.read_samples(audio_samples.data(), audio_samples.size());
+  audio_samples.clear();
+
+  next_play_time = processor->cycle_count;
+}
+
+int NsfPlayer::get_song() { return song; }
+
+double NsfPlayer::get_play_rate() { return kCPUClockRate / play_period; }
+
+void NsfPlayer::play_frame() {
+  next_play_time += play_period;
+  uint64_t frame_end = static_cast<uint64_t>(next_play_time);
+
+  // A play routine that overruns its frame is cut off
+  if (processor->cycle_count < frame_end) {
+    call(header.play_address, processor->a, processor->x,
+         frame_end - processor->cycle_count);
+  }
+
+  // The CPU idles until the next call
+  processor->cycle_count = std::max(processor->cycle_count, frame_end);
+
+  apu.end_frame(processor->cycle_count);
+  audio_samples.resize(apu.samples_available());
+  apu.read_samples(audio_samples.data(), audio_samples.size());
+}
+
+const std::vector<int16_t>& NsfPlayer::get_audio_samples() {
+  return audio_samples;
+}
+
+bool NsfPlayer::call(dbyte address, byte a, byte x, uint64_t max_cycles) {
+  processor->a = a;
+  processor->x = x;
+  processor->s = 0xFF;
+  processor->set_interrupt(1);
+
+  // As JSR does, push the return address minus one
+  dbyte return_address = kReturnAddress - 1;
+  processor->stack_push(return_address >> 8);
+  processor->stack_push(return_address & 0xFF);
+  processor->pc = address;
+
+  uint64_t end = processor->cycle_count + max_cycles;
+  while (processor->pc != kReturnAddress && processor->cycle_count < end) {
+    processor->execute();
+  }
+
+  return processor->pc == kReturnAddress;
+}
@@ -0,0 +1,92 @@
+//
+//  NsfPlayer.h
+//  Emulator
+//
+//  Plays NES Sound Format (.nsf) music. NSF files hold a game's sound code
+//  without the game: the player calls the file's init routine once per song
+//  and its play routine at the file's rate. Only the CPU and the APU run;
+//  the PPU is never clocked and nothing is drawn, so a second of music
+//  costs a small fraction of a second of emulated game.
+//
+//  Expansion sound chips aren't emulated; their parts of a tune are silent.
+//
+
+#ifndef __Emulator__NsfPlayer__
+#define __Emulator__NsfPlayer__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "APU.h"
+#include "ControllerPad.h"
+#include "Mapper.h"
+#include "PPU.h"
+#include "Processor.h"
+#include "RomImage.h"
+#include "defines.h"
+
+struct NsfHeader {
+  static const size_t kSize = 0x80;
+
+  int version;
+  int songs;
+  int starting_song;  // 1-based
+  dbyte load_address;
+  dbyte init_address;
+  dbyte play_address;
+  std::string name;
+  std::string artist;
+  std::string copyright;
+  int ntsc_speed;  // Microseconds between play calls
+  byte initial_banks[8];
+  bool bank_switched;  // Any initial bank is nonzero
+  byte expansion_chips;
+
+  // Throws if `data` isn't an NSF file
+  NsfHeader(const byte* data, size_t size);
+};
+
+class NsfPlayer {
+ private:
+  std::shared_ptr<const RomImage> image;
+  NsfHeader header;
+
+  PPU ppu;  // Never run, but the CPU's bus expects one
+  ControllerPad controller_pad;
+  std::unique_ptr<Processor> processor;
+  APU apu;
+  std::unique_ptr<Mapper> mapper;
+
+  int song;
+  double play_period;     // CPU cycles between play calls
+  double next_play_time;  // CPU cycle the next play call is due
+
+  std::vector<int16_t> audio_samples;
+
+  // Runs the routine at `address` as if called with JSR, until it returns
+  // or `max_cycles` pass. Returns whether it returned.
+  bool call(dbyte address, byte a, byte x, uint64_t max_cycles);
+
+ public:
+  // Throws if the file can't be read or isn't an NSF file
+  NsfPlayer(std::string filename);
+
+  const NsfHeader& get_header();
+  void set_audio_sample_rate(double sample_rate);
+
+  // Resets the machine and runs the song's init routine. Songs are numbered
+  // from 1.
+  void start_song(int song);
+  int get_song();
+
+  // Play calls per second
+  double get_play_rate();
+
+  // Calls the play routine once and runs until the next call is due. The
+  // audio produced is then in get_audio_samples().
+  void play_frame();
+  const std::vector<int16_t>& get_audio_samples();
+};
+
+#endif /* defined(__Emulator__NsfPlayer__) */
@@ -8,6 +8,12 @@
 
 #include "PPU.h"
 
+#include <cstring>
+
+#include "DotPPU.h"
+#include "Mapper.h"
+#include "ScanlinePPU.h"
+
 // PPU CONTROL REGISTER 1
 const int kNameTableXScrollBit = 0;
 const int kNameTableYScrollBit = 1;
@@ -43,43 +49,77 @@ const int kPPUStatusSpriteOverflowMask = 1 << kPPUStatusSpriteOverflowBit;
 const int kPPUStatusSprite0Mask = 1 << kPPUStatusSprite0Bit;
 const int kPPUStatusVBlankMask = 1 << kPPUStatusVBlankBit;
 
-PPU::PPU()
-    : control_1(0),
+// Physical name table for each of the four logical ones, by Mirroring
+static const int kNameTableMirroring[][4] = {
+    {0, 0, 1, 1},  // Horizontal
+    {0, 1, 0, 1},  // Vertical
+    {0, 0, 0, 0},  // Single screen, lower bank
+    {1, 1, 1, 1},  // Single screen, upper bank
+    {0, 1, 2, 3},  // Four screen
+};
+
+PPU::PPU(bool headless)
+    : renderer(std::make_unique<SDLRenderer>(this, headless)),
+      mapper(nullptr),
+      catch_up_engine(nullptr),
+      vram(),
+      mirroring(kMirroringVertical),
+      control_1(0),
       control_2(0),
       status(0),
-      vram(),
       first_write(true),  // set toggle
-      renderer(std::make_unique<SDLRenderer>(this)) {}
-
-bool PPU::render_scanline(int scanline) {
-  if (scanline == 0) {
-    reset_sprite_0_flag();
+      access_cycle(0),
+      log_writes(false) {
+  for (int i = 0; i < 8; i++) {
+    pages[i] = write_pages[i] = vram + i * 0x400;
   }
+  map_nametables();
 
-  if (scanline == 20 && is_screen_enabled()) {
-    // This should happen at clock cycle 256!
-    update_scroll_counters_from_registers();
-  }
+  set_accuracy(kPPUFast);
 
-  // These are the actual drawing scanlines
-  if (scanline >= 21 && scanline <= 260 && is_screen_enabled()) {
-    renderer->render_scanline(scanline - 21);
+  power_on();
+}
 
-    // H & HT counters are updated at the end of hblank
-    cntH = regH;
-    cntHT = regHT;
-  }
+//
+// Clears VRAM (including CHR RAM). CHR ROM and mirroring belong to the
+// cartridge and are left alone.
+//
+void PPU::power_on() {
+  ::memset(vram, 0, kVRAMSize);
+  ::memset(spr_ram, 0, kSprRAMSize);
+
+  control_1 = 0;
+  control_2 = 0;
+  status = 0;
+  sprite_memory_address = 0;
+  read_buffer = 0;
 
-  if (scanline == 261) {
-    // Set the VBlank flag in the status register
-    status |= kPPUStatusVBlankMask;
+  regFV = regV = regH = regVT = regHT = regFH = regS = 0;
+  cntFV = cntV = cntH = cntVT = cntHT = 0;
 
-    // If VBlank interrupts are enabled, return true which will generate an
-    // interrupt
-    return control_1 & kVBlankInterruptEnableMask;
+  first_write = true;
+}
+
+void PPU::set_accuracy(PPUAccuracy accuracy) {
+  this->accuracy = accuracy;
+  log_writes = false;
+  write_log.clear();
+
+  if (accuracy == kPPUAccurate) {
+    engine = std::make_unique<DotPPU>(this);
+    catch_up_engine = engine.get();
+  } else {
+    engine = std::make_unique<ScanlinePPU>(this);
+    catch_up_engine = nullptr;
   }
+}
+
+PPUAccuracy PPU::get_accuracy() { return accuracy; }
+
+void PPU::begin_frame(uint64_t cpu_cycle) { engine->begin_frame(cpu_cycle); }
 
-  return false;
+bool PPU::render_scanline(int scanline) {
+  return engine->finish_scanline(scanline);
 }
 
 //
@@ -116,52 +156,137 @@ bool PPU::render_scanline(int scanline) {
 // --------------------------------------- $0000
 //
 
+void PPU::set_mapper(Mapper* mapper) { this->mapper = mapper; }
+
 //
 // The Pattern Table may come from VROM.
 //
-void PPU::set_chr_rom(std::unique_ptr<byte[]> chr_rom) {
-  ::memcpy(vram, chr_rom.get(), kPatternTableSize);
+void PPU::map_pattern_table(dbyte address, size_t length, const byte* data) {
+  for (size_t offset = 0; offset < length; offset += 0x400) {
+    int page = static_cast<int>((address + offset) >> 10);
+    pages[page] = data + offset;
+    write_pages[page] = rom_write_page;
+  }
 }
 
-dbyte PPU::calculate_effective_address(dbyte address) {
-  // Only consider the least significant 14 bits to form the address
-  address &= 0x3FFF;
+void PPU::set_mirroring(Mirroring mirroring) {
+  this->mirroring = mirroring;
+  map_nametables();
+}
 
-  if (address < 0x2000) {
-    return address;
-  } else if (address < 0x3000) {
-    // There is only physical space for two name & attribute tables in the PPU
-    // memory Mirroring bits in the cartridge control how the 4 virtual tables
-    // are mapped
-    //
-    // TODO: Support mirroring, right now hard-coded to vertical
-    return address & 0x27FF;
-  } else if (address < 0x3F00) {
-    // 0x3000 - 0x3EFF is a mirror of 0x2000 - 0x2EFF
-    return address - 0x1000;
-  } else {
-    // Image / Sprite palette are mirrored 8 times from 0x3F00 to 0x4000
-    address &= 0x3F1F;
+//
+// There is only physical space for two name & attribute tables in the PPU
+// memory (four with four-screen cartridges). Mirroring in the cartridge
+// controls how the 4 virtual tables are mapped.
+//
+void PPU::map_nametables() {
+  for (int slot = 0; slot < 4; slot++) {
+    byte* table = vram + 0x2000 + kNameTableMirroring[mirroring][slot] * 0x400;
+    pages[8 + slot] = pages[12 + slot] = table;
+    write_pages[8 + slot] = write_pages[12 + slot] = table;
+  }
+}
 
-    // 0x3F1x is a mirror of 0x3F0x
-    if ((address & 0x03) == 0) {
-      address &= 0x3F0F;
-    }
-    return address;
+void PPU::save_state(StateWriter& writer) {
+  writer.write_bytes(vram, kVRAMSize);
+  writer.write_bytes(spr_ram, kSprRAMSize);
+
+  writer.write(control_1);
+  writer.write(control_2);
+  writer.write(status);
+  writer.write(sprite_memory_address);
+  writer.write(read_buffer);
+
+  byte scroll[] = {regFV, regV,  regH,  regVT, regHT, regFH,
+                   regS,  cntFV, cntV,  cntH,  cntVT, cntHT};
+  writer.write(scroll);
+  writer.write(first_write);
+  writer.write(mirroring);
+}
+
+void PPU::load_state(StateReader& reader) {
+  reader.read_bytes(vram, kVRAMSize);
+  reader.read_bytes(spr_ram, kSprRAMSize);
+
+  reader.read(control_1);
+  reader.read(control_2);
+  reader.read(status);
+  reader.read(sprite_memory_address);
+  reader.read(read_buffer);
+
+  byte scroll[12];
+  reader.read(scroll);
+  regFV = scroll[0];
+  regV = scroll[1];
+  regH = scroll[2];
+  regVT = scroll[3];
+  regHT = scroll[4];
+  regFH = scroll[5];
+  regS = scroll[6];
+  cntFV = scroll[7];
+  cntV = scroll[8];
+  cntH = scroll[9];
+  cntVT = scroll[10];
+  cntHT = scroll[11];
+  reader.read(first_write);
+  reader.read(mirroring);
+  map_nametables();
+
+  log_writes = false;
+  write_log.clear();
+}
+
+const byte* PPU::get_framebuffer() { return renderer->get_framebuffer(); }
+
+void PPU::set_present_frames(bool present) {
+  renderer->set_present_frames(present);
+}
+
+const PerfCounters& PPU::get_perf_counters() { return counters; }
+
+//
+// Image / Sprite palette are mirrored 8 times from 0x3F00 to 0x4000, and
+// 0x3F1x is a mirror of 0x3F0x for every fourth entry.
+//
+static dbyte mirror_palette_address(dbyte address) {
+  address &= 0x3F1F;
+
+  if ((address & 0x03) == 0) {
+    address &= 0x3F0F;
   }
+  return address;
 }
 
 byte PPU::read_memory(dbyte address) {
-  return vram[calculate_effective_address(address)];
+  address &= 0x3FFF;
+
+  if (address >= kPaletteTableStart) {
+    return vram[mirror_palette_address(address)];
+  }
+
+  return pages[address >> 10][address & 0x3FF];
 }
 
 void PPU::store_memory(dbyte address, byte word) {
-  vram[calculate_effective_address(address)] = word;
+  address &= 0x3FFF;
+
+  if (address >= kPaletteTableStart) {
+    vram[mirror_palette_address(address)] = word;
+    return;
+  }
+
+  write_pages[address >> 10][address & 0x3FF] = word;
 }
 
 /** VBLANK **/
+void PPU::set_vblank_flag() { status |= kPPUStatusVBlankMask; }
+
 void PPU::reset_vblank_flag() { status &= ~kPPUStatusVBlankMask; }
 
+bool PPU::vblank_interrupt_enabled() {
+  return control_1 & kVBlankInterruptEnableMask;
+}
+
 /** SPRITE HIT **/
 void PPU::reset_sprite_0_flag() { status &= ~kPPUStatusSprite0Mask; }
 
@@ -190,6 +315,12 @@ dbyte PPU::sprite_pattern_table_address() {
 /** REGISTER READS AND WRITES */
 
 byte PPU::read_status() {
+  counters.count_status_read();
+
+  if (!first_write) {
+    log_write(kAccessStatusRead, 0);
+  }
+
   byte result = status;
   reset_vblank_flag();  // reset vblank flag
   first_write = true;   // reset toggle
@@ -197,6 +328,7 @@ byte PPU::read_status() {
 }
 byte PPU::read_control_1() { return control_1; }
 void PPU::write_control_1(byte value) {
+  log_write(kAccessControl1, value);
   control_1 = value;
 
   regH = (value & kNameTableXScrollMask) >> kNameTableXScrollBit;
@@ -206,8 +338,13 @@ void PPU::write_control_1(byte value) {
 }
 
 byte PPU::read_control_2() { return control_2; }
-void PPU::write_control_2(byte value) { control_2 = value; }
-void PPU::write_spr_ram(byte* start) { ::memcpy(spr_ram, start, kSprRAMSize); }
+void PPU::write_control_2(byte value) {
+  log_write(kAccessControl2, value);
+  control_2 = value;
+}
+void PPU::write_spr_ram(const byte* start) {
+  ::memcpy(spr_ram, start, kSprRAMSize);
+}
 void PPU::set_sprite_memory_address(byte value) {
   sprite_memory_address = value;
 }
@@ -216,6 +353,8 @@ void PPU::write_sprite_data(byte value) {
 }
 byte PPU::read_sprite_data() { return spr_ram[sprite_memory_address++]; }
 void PPU::write_scroll_register(byte value) {
+  log_write(kAccessScroll, value);
+
   if (first_write) {
     regFH = value & 0x07;
     regHT = (value & 0xF8) >> 3;
@@ -227,6 +366,8 @@ void PPU::write_scroll_register(byte value) {
   first_write = !first_write;
 }
 void PPU::write_vram_address(byte value) {
+  log_write(kAccessAddress, value);
+
   if (first_write) {
     regVT = (regVT & 0x07) | (value & 0x03) << 3;
     regH = (value & 0x04) >> 2;
@@ -242,7 +383,39 @@ void PPU::write_vram_address(byte value) {
   first_write = !first_write;
 }
 
+//
+// Applies a logged access's effect on the registers again, without its side
+// effects on memory or the status register.
+//
+void PPU::replay_write(const PPURegisterWrite& write) {
+  switch (write.access) {
+    case kAccessControl1:
+      write_control_1(write.value);
+      break;
+    case kAccessControl2:
+      write_control_2(write.value);
+      break;
+    case kAccessScroll:
+      write_scroll_register(write.value);
+      break;
+    case kAccessAddress:
+      write_vram_address(write.value);
+      break;
+    case kAccessStatusRead:
+      first_write = true;
+      break;
+    case kAccessData:
+      increment_scroll_counters();
+      break;
+  }
+}
+
+dbyte PPU::get_vram_address() { return vram_address(); }
+
 byte PPU::read_vram_data() {
+  counters.count_vram_data_read();
+  log_write(kAccessData, 0);
+
   byte result;
 
   if (vram_address() >= kPaletteTableStart) {
@@ -257,6 +430,9 @@ byte PPU::read_vram_data() {
 }
 
 void PPU::write_vram_data(byte value) {
+  counters.count_vram_data_write();
+  log_write(kAccessData, 0);
+
   store_memory(vram_address(), value);
   increment_scroll_counters();
 }
@@ -273,7 +449,7 @@ dbyte PPU::nametable_address() {
 // name table determines the actual color to use in the palette. Returns the two
 // high order bits of the palette entry.
 byte PPU::palette_select_bits() {
-  byte attr_byte = read_memory(attributetable_address());
+  byte attr_byte = read_page(attributetable_address());
 
   // Figurex out which two bits to take
   int bits_offset = ((cntVT & 0x02) << 1) | (cntHT & 0x02);
@@ -288,7 +464,7 @@ dbyte PPU::attributetable_address() {
 }
 
 dbyte PPU::patterntable_address() {
-  byte pattern_index = read_memory(nametable_address());
+  byte pattern_index = read_page(nametable_address());
 
   return regS << 12 | pattern_index << 4 | cntFV;
 }
@@ -10,8 +10,12 @@
 #define __Emulator__PPU__
 
 #include <memory>
+#include <vector>
 
+#include "PPUEngine.h"
+#include "PerfCounters.h"
 #include "SDLRenderer.h"
+#include "SaveState.h"
 #include "defines.h"
 
 const dbyte kVRAMSize = 0x4000;
@@ -20,13 +24,49 @@ const dbyte kSprRAMSize = 0x100;
 const dbyte kPaletteTableStart = 0x3F00;
 const dbyte kPaletteTableSpriteOffset = 16;
 
+class Mapper;
+
+// Register accesses that change what a scanline looks like
+enum PPURegisterAccess {
+  kAccessControl1,
+  kAccessControl2,
+  kAccessScroll,
+  kAccessAddress,
+  kAccessStatusRead,  // Only logged when it resets the write toggle
+  kAccessData,        // $2007 reads and writes move the VRAM address
+};
+
+struct PPURegisterWrite {
+  uint64_t cpu_cycle;
+  PPURegisterAccess access;
+  byte value;
+};
+
 class PPU {
   friend class SDLRenderer;
+  friend class Benchmarks;
+  friend class ScanlinePPU;
+  friend class DotPPU;
 
  private:
   std::unique_ptr<SDLRenderer> renderer;
+  Mapper* mapper;
+
+  PPUAccuracy accuracy;
+  std::unique_ptr<PPUEngine> engine;
+  PPUEngine* catch_up_engine;  // Only set for engines that need catching up
 
   byte vram[kVRAMSize];
+
+  // The address space below the palette in 1 KB pages: the eight pattern
+  // table pages, pointing at CHR ROM banks or into vram (CHR RAM), then the
+  // four name table slots twice ($3000-$3EFF mirrors $2000-$2EFF), pointing
+  // into vram as the mirroring selects. Writes to CHR ROM go to a scratch
+  // page instead.
+  const byte* pages[16];
+  byte* write_pages[16];
+  byte rom_write_page[0x400];
+  Mirroring mirroring;
   byte spr_ram[kSprRAMSize];
 
   byte control_1;
@@ -54,11 +94,34 @@ class PPU {
 
   bool first_write;
 
-  dbyte calculate_effective_address(dbyte address);
+  // The fast engine logs accesses made while the CPU runs a visible line, so
+  // that it can apply them at the pixel where they happened
+  uint64_t access_cycle;  // Of the CPU's latest register access
+  bool log_writes;
+  std::vector<PPURegisterWrite> write_log;
+
+  PerfCounters counters;
+
+  void log_write(PPURegisterAccess access, byte value) {
+    if (log_writes) {
+      write_log.push_back({access_cycle, access, value});
+    }
+  }
+  void replay_write(const PPURegisterWrite& write);
+
   byte read_memory(dbyte address);
   void store_memory(dbyte address, byte word);
 
+  // read_memory for addresses below the palette, which every background and
+  // sprite fetch is
+  byte read_page(dbyte address) {
+    return pages[(address >> 10) & 0x0F][address & 0x3FF];
+  }
+  void map_nametables();
+
+  void set_vblank_flag();
   void reset_vblank_flag();
+  bool vblank_interrupt_enabled();
 
   void reset_sprite_0_flag();
   void set_sprite_0_flag();
@@ -86,10 +149,37 @@ class PPU {
   bool is_screen_enabled();
 
  public:
-  PPU();
+  PPU(bool headless);
+
+  void power_on();
+  void set_mapper(Mapper* mapper);
+
+  // Takes effect immediately, so switch between frames
+  void set_accuracy(PPUAccuracy accuracy);
+  PPUAccuracy get_accuracy();
 
+  // See PPUEngine. The CPU calls catch_up before every access to the PPU's
+  // registers, OAM DMA and mapper writes; it does nothing for the fast
+  // engine apart from timestamping its write log.
+  void begin_frame(uint64_t cpu_cycle);
   bool render_scanline(int scanline);
-  void set_chr_rom(std::unique_ptr<byte[]> chr_rom);
+  void catch_up(uint64_t cpu_cycle) {
+    access_cycle = cpu_cycle;
+    if (catch_up_engine) {
+      catch_up_engine->catch_up(cpu_cycle);
+    }
+  }
+
+  // Points `length` bytes of the pattern tables at `address` (both multiples
+  // of 1 KB) at CHR ROM. Until this is called the pattern tables are RAM.
+  void map_pattern_table(dbyte address, size_t length, const byte* data);
+  void set_mirroring(Mirroring mirroring);
+  const byte* get_framebuffer();
+  void set_present_frames(bool present);
+  const PerfCounters& get_perf_counters();
+
+  void save_state(StateWriter& writer);
+  void load_state(StateReader& reader);
 
   byte read_status();
   byte read_control_1();
@@ -97,7 +187,7 @@ class PPU {
   byte read_control_2();
   void write_control_2(byte value);
 
-  void write_spr_ram(byte* start);  // DMA
+  void write_spr_ram(const byte* start);  // DMA
   void set_sprite_memory_address(byte value);
   byte read_sprite_data();
   void write_sprite_data(byte value);
@@ -105,6 +195,7 @@ class PPU {
   void write_scroll_register(byte value);
 
   void write_vram_address(byte value);
+  dbyte get_vram_address();  // Where the next $2007 access goes
   byte read_vram_data();
   void write_vram_data(byte value);
 };
@@ -0,0 +1,46 @@
+//
+//  PPUEngine.h
+//  Emulator
+//
+//  The part of the PPU that turns its registers and memory into pixels.
+//  The PPU class owns the registers, VRAM and OAM that the CPU sees, and
+//  hands the timing of rendering to one of two engines:
+//
+//    kPPUFast      ScanlinePPU renders each scanline once the CPU has run
+//                  it. Register writes made during the line are logged with
+//                  their cycle, and the line is rendered in spans split at
+//                  those dots, so raster splits land on the right pixel.
+//                  Sprite evaluation and fetch timing are not modelled.
+//    kPPUAccurate  DotPPU steps dot by dot with the hardware's fetch and
+//                  sprite evaluation timing. It only runs when the CPU
+//                  touches the PPU (or a mapper register) and at the end of
+//                  each scanline, catching up to the CPU's cycle.
+//
+
+#ifndef __Emulator__PPUEngine__
+#define __Emulator__PPUEngine__
+
+#include <cstdint>
+
+enum PPUAccuracy {
+  kPPUFast,
+  kPPUAccurate,
+};
+
+class PPUEngine {
+ public:
+  virtual ~PPUEngine() {}
+
+  // Called as each frame starts, with the CPU's cycle count at that point
+  virtual void begin_frame(uint64_t cpu_cycle) = 0;
+
+  // Runs to the end of `scanline` in the emulator's frame order: 20 lines
+  // of vblank, the pre-render line, 240 visible lines and the post-render
+  // line. Returns true if the PPU raises an NMI.
+  virtual bool finish_scanline(int scanline) = 0;
+
+  // Runs up to the dot the CPU has reached, before it accesses the PPU
+  virtual void catch_up(uint64_t cpu_cycle) = 0;
+};
+
+#endif /* defined(__Emulator__PPUEngine__) */
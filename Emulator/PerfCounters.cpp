@@ -0,0 +1,91 @@
+//
+//  PerfCounters.cpp
+//  Emulator
+//
+
+#include "PerfCounters.h"
+
+#include <cstdio>
+
+static const char* const kRegionNames[kMemoryRegionCount] = {
+    "cpu_ram", "ppu_registers", "io_registers",
+    "expansion", "sram", "prg_rom",
+};
+
+PerfCounterValues& PerfCounterValues::operator+=(
+    const PerfCounterValues& other) {
+  frames += other.frames;
+
+  instructions += other.instructions;
+  cycles += other.cycles;
+  frame_instructions += other.frame_instructions;
+  frame_cycles += other.frame_cycles;
+  for (int i = 0; i < 256; i++) {
+    opcodes[i] += other.opcodes[i];
+  }
+
+  for (int i = 0; i < kMemoryRegionCount; i++) {
+    reads[i] += other.reads[i];
+    writes[i] += other.writes[i];
+  }
+  status_reads += other.status_reads;
+  vram_data_reads += other.vram_data_reads;
+  vram_data_writes += other.vram_data_writes;
+
+  sprite_lines += other.sprite_lines;
+  sprites_evaluated += other.sprites_evaluated;
+  if (other.max_sprites_per_line > max_sprites_per_line) {
+    max_sprites_per_line = other.max_sprites_per_line;
+  }
+
+  cpu_seconds += other.cpu_seconds;
+  render_seconds += other.render_seconds;
+  frame_cpu_seconds += other.frame_cpu_seconds;
+  frame_render_seconds += other.frame_render_seconds;
+
+  return *this;
+}
+
+void PerfCounterValues::write_json(std::ostream& stream) const {
+  stream << "{\n"
+         << "  \"enabled\": " << (kPerfCountersEnabled ? "true" : "false")
+         << ",\n"
+         << "  \"frames\": " << frames << ",\n"
+         << "  \"instructions\": " << instructions << ",\n"
+         << "  \"cycles\": " << cycles << ",\n"
+         << "  \"frame_instructions\": " << frame_instructions << ",\n"
+         << "  \"frame_cycles\": " << frame_cycles << ",\n"
+         << "  \"status_reads\": " << status_reads << ",\n"
+         << "  \"vram_data_reads\": " << vram_data_reads << ",\n"
+         << "  \"vram_data_writes\": " << vram_data_writes << ",\n"
+         << "  \"sprite_lines\": " << sprite_lines << ",\n"
+         << "  \"sprites_evaluated\": " << sprites_evaluated << ",\n"
+         << "  \"max_sprites_per_line\": " << max_sprites_per_line << ",\n"
+         << "  \"cpu_seconds\": " << cpu_seconds << ",\n"
+         << "  \"render_seconds\": " << render_seconds << ",\n"
+         << "  \"frame_cpu_seconds\": " << frame_cpu_seconds << ",\n"
+         << "  \"frame_render_seconds\": " << frame_render_seconds << ",\n";
+
+  stream << "  \"reads\": {";
+  for (int i = 0; i < kMemoryRegionCount; i++) {
+    stream << (i ? ", " : "") << "\"" << kRegionNames[i] << "\": " << reads[i];
+  }
+  stream << "},\n  \"writes\": {";
+  for (int i = 0; i < kMemoryRegionCount; i++) {
+    stream << (i ? ", " : "") << "\"" << kRegionNames[i]
+           << "\": " << writes[i];
+  }
+
+  // Only opcodes that were executed at least once
+  stream << "},\n  \"opcodes\": {";
+  bool first = true;
+  for (int i = 0; i < 256; i++) {
+    if (opcodes[i]) {
+      char name[8];
+      snprintf(name, sizeof(name), "0x%02X", i);
+      stream << (first ? "" : ", ") << "\"" << name << "\": " << opcodes[i];
+      first = false;
+    }
+  }
+  stream << "}\n}\n";
+}
@@ -0,0 +1,150 @@
+//
+//  PerfCounters.h
+//  Emulator
+//
+//  Optional performance counters. They are compiled in only when
+//  EMULATOR_PERF_COUNTERS is defined; otherwise every counting method is an
+//  empty inline function and the counters cost nothing.
+//
+
+#ifndef Emulator_PerfCounters_h
+#define Emulator_PerfCounters_h
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include "defines.h"
+
+#ifdef EMULATOR_PERF_COUNTERS
+const bool kPerfCountersEnabled = true;
+#else
+const bool kPerfCountersEnabled = false;
+#endif
+
+enum MemoryRegion {
+  kRegionCPURAM,
+  kRegionPPURegisters,
+  kRegionIORegisters,
+  kRegionExpansion,
+  kRegionSRAM,
+  kRegionPRGROM,
+  kMemoryRegionCount,
+};
+
+struct PerfCounterValues {
+  uint64_t frames;
+
+  uint64_t instructions;
+  uint64_t cycles;
+  uint64_t frame_instructions;  // During the last frame
+  uint64_t frame_cycles;
+  uint64_t opcodes[256];
+
+  uint64_t reads[kMemoryRegionCount];
+  uint64_t writes[kMemoryRegionCount];
+  uint64_t status_reads;     // $2002
+  uint64_t vram_data_reads;  // $2007
+  uint64_t vram_data_writes;
+
+  uint64_t sprite_lines;  // Scanlines on which sprites were evaluated
+  uint64_t sprites_evaluated;
+  uint64_t max_sprites_per_line;
+
+  double cpu_seconds;
+  double render_seconds;
+  double frame_cpu_seconds;  // During the last frame
+  double frame_render_seconds;
+
+  PerfCounterValues() { ::memset(this, 0, sizeof(*this)); }
+
+  PerfCounterValues& operator+=(const PerfCounterValues& other);
+  void write_json(std::ostream& stream) const;
+};
+
+template <bool kEnabled>
+class BasicPerfCounters;
+
+// Counters compiled out: nothing is stored and nothing is counted
+template <>
+class BasicPerfCounters<false> {
+ public:
+  void count_instruction(byte opcode, int cycles) {}
+  void count_read(MemoryRegion region) {}
+  void count_write(MemoryRegion region) {}
+  void count_status_read() {}
+  void count_vram_data_read() {}
+  void count_vram_data_write() {}
+  void count_sprites_evaluated(int sprites) {}
+
+  void begin_frame(const BasicPerfCounters& cpu) {}
+  void end_frame(const BasicPerfCounters& cpu) {}
+  void start_cpu_timer() {}
+  void stop_cpu_timer() {}
+  void start_render_timer() {}
+  void stop_render_timer() {}
+
+  PerfCounterValues values() const { return PerfCounterValues(); }
+};
+
+template <>
+class BasicPerfCounters<true> {
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  PerfCounterValues counters;
+
+  PerfCounterValues frame_start;
+  Clock::time_point timer_start;
+
+  double elapsed_seconds() {
+    return std::chrono::duration<double>(Clock::now() - timer_start).count();
+  }
+
+ public:
+  void count_instruction(byte opcode, int cycles) {
+    counters.instructions++;
+    counters.cycles += cycles;
+    counters.opcodes[opcode]++;
+  }
+  void count_read(MemoryRegion region) { counters.reads[region]++; }
+  void count_write(MemoryRegion region) { counters.writes[region]++; }
+  void count_status_read() { counters.status_reads++; }
+  void count_vram_data_read() { counters.vram_data_reads++; }
+  void count_vram_data_write() { counters.vram_data_writes++; }
+  void count_sprites_evaluated(int sprites) {
+    counters.sprite_lines++;
+    counters.sprites_evaluated += sprites;
+    if (static_cast<uint64_t>(sprites) > counters.max_sprites_per_line) {
+      counters.max_sprites_per_line = sprites;
+    }
+  }
+
+  // `cpu` holds the processor's counters, which the frame totals come from
+  void begin_frame(const BasicPerfCounters& cpu) {
+    frame_start = cpu.counters;
+    frame_start.cpu_seconds = counters.cpu_seconds;
+    frame_start.render_seconds = counters.render_seconds;
+  }
+  void end_frame(const BasicPerfCounters& cpu) {
+    counters.frames++;
+    counters.frame_instructions =
+        cpu.counters.instructions - frame_start.instructions;
+    counters.frame_cycles = cpu.counters.cycles - frame_start.cycles;
+    counters.frame_cpu_seconds = counters.cpu_seconds - frame_start.cpu_seconds;
+    counters.frame_render_seconds =
+        counters.render_seconds - frame_start.render_seconds;
+  }
+
+  void start_cpu_timer() { timer_start = Clock::now(); }
+  void stop_cpu_timer() { counters.cpu_seconds += elapsed_seconds(); }
+  void start_render_timer() { timer_start = Clock::now(); }
+  void stop_render_timer() { counters.render_seconds += elapsed_seconds(); }
+
+  PerfCounterValues values() const { return counters; }
+};
+
+typedef BasicPerfCounters<kPerfCountersEnabled> PerfCounters;
+
+#endif  // Emulator_PerfCounters_h
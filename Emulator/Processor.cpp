@@ -10,7 +10,14 @@
 
 #include "Processor.h"
 
+#include <cstring>
+
+#include "APU.h"
+#include "CpuTrace.h"
+#include "Debugger.h"
+#include "GuestProfiler.h"
 #include "Instructions.h"
+#include "Mapper.h"
 
 const int kCarryBit =
     0;  // Set when the result of the computation is < 0 or > 255 (unsigned)
@@ -34,12 +41,156 @@ const int kSignMask = 1 << kSignBit;
 Processor::Processor(PPU* ppu, ControllerPad* controller_pad)
     : ppu(ppu),
       controller_pad(controller_pad),
+      mapper(nullptr),
+      apu(nullptr),
+      pc(0),
+      s(0),
+      p(0),
+      a(0),
+      x(0),
+      y(0),
       cpu_ram(),
       sram(),
-      prg_rom(nullptr) {}
+      read_pages(),
+      write_pages(),
+      watched_read_pages(),
+      watched_write_pages(),
+      watched_pages(),
+      watcher(nullptr),
+      cycles_to_run(0),
+      profiler(nullptr),
+      prg_rom_pages(),
+      irq_sources(0),
+      cycle_count(0) {
+  // CPU RAM is mirrored 4x from $0000 to $1FFF
+  for (int page = 0x00; page < 0x20; page++) {
+    write_pages[page] = cpu_ram + (page & 0x07) * 0x100;
+    read_pages[page] = write_pages[page];
+  }
+
+  for (int page = 0x60; page < 0x80; page++) {
+    write_pages[page] = sram + (page - 0x60) * 0x100;
+    read_pages[page] = write_pages[page];
+  }
+}
+
+void Processor::set_mapper(Mapper* mapper) { this->mapper = mapper; }
+
+void Processor::map_prg_rom(dbyte address, size_t length, const byte* data) {
+  for (size_t offset = 0; offset < length; offset += 0x100) {
+    map_prg_page((address + offset) >> 8, data + offset);
+  }
+}
+
+void Processor::map_prg_page(int page, const byte* data) {
+  if (page >= 0x80) {
+    std::vector<byte>& patched = patched_pages[page - 0x80];
+    prg_rom_pages[page - 0x80] = data;
+
+    if (!patched.empty() && data) {
+      ::memcpy(patched.data(), data, 0x100);
+      for (const Cheat& cheat : rom_cheats) {
+        byte offset = cheat.address & 0xFF;
+        if ((cheat.address >> 8) == page &&
+            (cheat.compare < 0 || data[offset] == cheat.compare)) {
+          patched[offset] = cheat.value;
+        }
+      }
+      data = patched.data();
+    }
+  }
+
+  (watched_pages[page] ? watched_read_pages : read_pages)[page] = data;
+}
+
+void Processor::set_rom_cheats(const std::vector<Cheat>& cheats) {
+  bool was_patched[128];
+  for (int i = 0; i < 128; i++) {
+    was_patched[i] = !patched_pages[i].empty();
+  }
+
+  bool patched[128] = {};
+  rom_cheats.clear();
+  for (const Cheat& cheat : cheats) {
+    if (cheat.enabled && cheat.address >= 0x8000) {
+      rom_cheats.push_back(cheat);
+      patched[(cheat.address >> 8) - 0x80] = true;
+    }
+  }
+
+  // Remap the pages that gained, lost or changed cheats
+  for (int i = 0; i < 128; i++) {
+    if (!patched[i] && !was_patched[i]) {
+      continue;
+    }
+
+    if (patched[i]) {
+      patched_pages[i].resize(0x100);
+    } else {
+      std::vector<byte>().swap(patched_pages[i]);
+    }
+
+    if (prg_rom_pages[i]) {
+      map_prg_page(0x80 + i, prg_rom_pages[i]);
+    }
+  }
+}
 
-void Processor::set_prg_rom(std::unique_ptr<byte[]> prg_rom) {
-  this->prg_rom = std::move(prg_rom);
+void Processor::apply_ram_cheats(const std::vector<Cheat>& cheats) {
+  for (const Cheat& cheat : cheats) {
+    byte* memory = nullptr;
+    if (cheat.address < 0x2000) {
+      memory = cpu_ram + (cheat.address & 0x07FF);
+    } else if (cheat.address >= 0x6000 && cheat.address < 0x8000) {
+      memory = sram + (cheat.address - 0x6000);
+    }
+
+    if (cheat.enabled && memory &&
+        (cheat.compare < 0 || *memory == cheat.compare)) {
+      *memory = cheat.value;
+    }
+  }
+}
+
+const byte* Processor::memory_page(byte page) {
+  return watched_pages[page] ? watched_read_pages[page] : read_pages[page];
+}
+
+byte Processor::peek_memory(dbyte address) {
+  const byte* page = memory_page(address >> 8);
+  return page ? page[address & 0xFF] : 0;
+}
+
+void Processor::watch_page(byte page, bool watched) {
+  if (watched == watched_pages[page]) {
+    return;
+  }
+
+  if (watched) {
+    watched_read_pages[page] = read_pages[page];
+    watched_write_pages[page] = write_pages[page];
+    read_pages[page] = nullptr;
+    write_pages[page] = nullptr;
+  } else {
+    read_pages[page] = watched_read_pages[page];
+    write_pages[page] = watched_write_pages[page];
+  }
+  watched_pages[page] = watched;
+}
+
+void Processor::set_apu(APU* apu) { this->apu = apu; }
+
+void Processor::set_irq_line(IRQSource source, bool asserted) {
+  asserted ? irq_sources |= source : irq_sources &= ~source;
+}
+
+uint64_t Processor::get_cycle_count() { return cycle_count; }
+
+void Processor::power_on() {
+  ::memset(cpu_ram, 0, kCPURAMSize);
+  ::memset(sram, 0, kSRAMSize);
+  cycle_count = 0;
+  reset();
 }
 
 void Processor::reset() {
@@ -52,14 +203,62 @@ void Processor::reset() {
   y = 0;
 }
 
+//
+// Non-maskable interrupt: taken whatever the I flag says, which matters once
+// a game clears it to receive mapper or APU IRQs.
+//
 void Processor::non_maskable_interrupt() {
-  if (if_interrupt()) {
-    stack_push(pc >> 8);
-    stack_push(pc);
-    stack_push(p & ~kBreakMask);  // NMI pushes 0 for break bit
+  stack_push(pc >> 8);
+  stack_push(pc);
+  stack_push(p & ~kBreakMask);  // NMI pushes 0 for break bit
 
-    pc = address_at(0xFFFA);
-  }
+  set_interrupt(1);
+  pc = address_at(0xFFFA);
+  cycle_count += 7;
+}
+
+//
+// Maskable interrupt, taken between instructions while the IRQ line is held
+// and interrupts are enabled.
+//
+int Processor::interrupt_request() {
+  stack_push(pc >> 8);
+  stack_push(pc);
+  stack_push(p & ~kBreakMask);
+
+  set_interrupt(1);
+  pc = address_at(0xFFFE);
+
+  cycle_count += 7;
+  return 7;
+}
+
+const byte* Processor::get_cpu_ram() { return cpu_ram; }
+
+const PerfCounters& Processor::get_perf_counters() { return counters; }
+
+void Processor::save_state(StateWriter& writer) {
+  writer.write(pc);
+  writer.write(s);
+  writer.write(p);
+  writer.write(a);
+  writer.write(x);
+  writer.write(y);
+  writer.write(cycle_count);
+  writer.write_bytes(cpu_ram, kCPURAMSize);
+  writer.write_bytes(sram, kSRAMSize);
+}
+
+void Processor::load_state(StateReader& reader) {
+  reader.read(pc);
+  reader.read(s);
+  reader.read(p);
+  reader.read(a);
+  reader.read(x);
+  reader.read(y);
+  reader.read(cycle_count);
+  reader.read_bytes(cpu_ram, kCPURAMSize);
+  reader.read_bytes(sram, kSRAMSize);
 }
 
 void Processor::set_p_bit(int bit, bool value) {
@@ -115,18 +314,63 @@ dbyte Processor::rel_addr(dbyte addr, byte offset) {
 void Processor::stack_push(byte value) { store_memory(0x100 + s--, value); }
 byte Processor::stack_pop() { return read_memory(0x100 + ++s); }
 
+static inline MemoryRegion region_for_address(dbyte address) {
+  if (address >= 0x8000) {
+    return kRegionPRGROM;
+  }
+  return address >= 0x6000 ? kRegionSRAM : kRegionCPURAM;
+}
+
 byte Processor::read_memory(dbyte address) {
+  const byte* page = read_pages[address >> 8];
+  if (page) {
+    counters.count_read(region_for_address(address));
+    return page[address & 0xFF];
+  }
+
+  return read_io(address);
+}
+
+void Processor::store_memory(dbyte address, byte value) {
+  byte* page = write_pages[address >> 8];
+  if (page) {
+    counters.count_write(region_for_address(address));
+    page[address & 0xFF] = value;
+    return;
+  }
+
+  store_io(address, value);
+}
+
+// Accesses to pages with no memory behind them (I/O registers and the
+// mapper) or whose memory the debugger is watching
+byte Processor::read_io(dbyte address) {
+  if (watcher) {
+    watcher->check_cpu_read(address);
+    if ((address & 0xE007) == 0x2007) {
+      watcher->check_ppu_read(ppu->get_vram_address());
+    }
+
+    const byte* page = watched_read_pages[address >> 8];
+    if (page) {
+      counters.count_read(region_for_address(address));
+      return page[address & 0xFF];
+    }
+  }
+
   if (address >= 0x8000) {
-    // Program ROM space
-    return prg_rom[address - 0x8000];
-  } else if (address >= 0x6000) {
-    // SRAM
-    return sram[address - 0x6000];
+    // No PRG ROM mapped here
+    counters.count_read(kRegionPRGROM);
+    return 0;
   } else if (address >= 0x4020) {
     // Expansion ROM
     // throw "Expansion ROM not implemented";
+    counters.count_read(kRegionExpansion);
   } else if (address >= 0x4000) {
+    counters.count_read(kRegionIORegisters);
     switch (address) {
+      case 0x4015:
+        return apu ? apu->read_status(cycle_count) : 0;
       case 0x4016:
         return controller_pad->read_controller_1_state();
       case 0x4017:
@@ -137,6 +381,8 @@ byte Processor::read_memory(dbyte address) {
     }
   } else if (address >= 0x2000) {
     // PPU I/O Registers
+    counters.count_read(kRegionPPURegisters);
+    ppu->catch_up(cycle_count);
     switch (address & 0x07) {  // I/O registers are mirrored every 8 bytes
       case 0x00:
         return ppu->read_control_1();
@@ -153,15 +399,27 @@ byte Processor::read_memory(dbyte address) {
     }
   }
 
-  // Must be in 0x0000 -> 0x2000 (CPU RAM, mirrored 4x)
   return cpu_ram[address & 0x07FF];
 }
 
-void Processor::store_memory(dbyte address, byte value) {
-  if (address < 0x2000) {
-    // CPU Ram
-    cpu_ram[address & 0x07FF] = value;
-  } else if (address < 0x4000) {
+void Processor::store_io(dbyte address, byte value) {
+  if (watcher) {
+    watcher->check_cpu_write(address);
+    if ((address & 0xE007) == 0x2007) {
+      watcher->check_ppu_write(ppu->get_vram_address());
+    }
+
+    byte* page = watched_write_pages[address >> 8];
+    if (page) {
+      counters.count_write(region_for_address(address));
+      page[address & 0xFF] = value;
+      return;
+    }
+  }
+
+  if (address < 0x4000) {
+    counters.count_write(kRegionPPURegisters);
+    ppu->catch_up(cycle_count);
     switch (address & 0x07) {
       case 0x00:
         ppu->write_control_1(value);
@@ -189,24 +447,45 @@ void Processor::store_memory(dbyte address, byte value) {
     }
   } else if (address < 0x4020) {
     // Sound and other I/O registers
+    counters.count_write(kRegionIORegisters);
     switch (address) {
       case 0x4014:
-        ppu->write_spr_ram(cpu_ram + value * 0x100);
+        ppu->catch_up(cycle_count);
+        if (memory_page(value)) {
+          ppu->write_spr_ram(memory_page(value));
+        }
         break;
       case 0x4016:
         controller_pad->write_value(value);
         break;
       default:
+        // $4000-$4013, $4015 and $4017 are the APU's
+        if (apu && address != 0x4009 && address != 0x400D &&
+            address <= 0x4017) {
+          apu->write_register(address, value, cycle_count);
+        }
         break;
-        // throw "Unrecognized I/O write. Please implement.";
     }
-  } else if (address >= 0x6000 && address < 0x8000) {
-    // SRAM
-    sram[address - 0x6000] = value;
+  } else if (address >= 0x8000) {
+    // Writes to ROM go to the mapper's registers
+    counters.count_write(kRegionPRGROM);
+    if (mapper) {
+      ppu->catch_up(cycle_count);  // Bank switches can change the picture
+      mapper->write_register(address, value);
+    }
+  } else {
+    counters.count_write(kRegionExpansion);
+    if (mapper && address < 0x6000) {
+      mapper->write_expansion(address, value);
+    }
   }
 }
 
 int Processor::execute() {
+  if (irq_sources && !if_interrupt()) {
+    return interrupt_request();
+  }
+
   byte opcode = read_memory(pc);  // opcode of instruction
   dbyte address;                  // address of operand
   byte src;                       // operand
@@ -714,5 +993,69 @@ int Processor::execute() {
       throw "Unrecognized instruction";
   }
 
+  counters.count_instruction(opcode, cycles);
+  cycle_count += cycles;
   return cycles;
 }
+
+CpuTraceRecord Processor::trace_record() {
+  CpuTraceRecord record = {};
+  record.cycle = cycle_count;
+  record.pc = pc;
+  record.opcode = peek_memory(pc);
+  record.operands[0] = peek_memory(pc + 1);
+  record.operands[1] = peek_memory(pc + 2);
+  record.a = a;
+  record.x = x;
+  record.y = y;
+  record.p = p;
+  record.s = s;
+  return record;
+}
+
+void Processor::trace_instruction() {
+  if (irq_sources && !if_interrupt()) {
+    return;  // execute will take the interrupt instead
+  }
+
+  CpuTrace::instance().record(trace_record());
+}
+
+template <bool kDebugging, bool kTracing, bool kProfiling>
+int Processor::run_loop(int cycles, Debugger* debugger) {
+  int elapsed = 0;
+  cycles_to_run = cycles;
+  while (elapsed < cycles_to_run) {
+    if (kDebugging && debugger->should_stop_before(pc, s)) {
+      break;
+    }
+    if (kTracing) {
+      trace_instruction();
+    }
+    if (kProfiling) {
+      profiler->before_instruction();
+    }
+    int instruction_cycles = execute();
+    if (kProfiling) {
+      profiler->after_instruction(instruction_cycles);
+    }
+    elapsed += instruction_cycles;
+  }
+  return elapsed;
+}
+
+template <bool kTracing, bool kProfiling>
+int Processor::run_with(int cycles, Debugger* debugger) {
+  return debugger ? run_loop<true, kTracing, kProfiling>(cycles, debugger)
+                  : run_loop<false, kTracing, kProfiling>(cycles, debugger);
+}
+
+int Processor::run(int cycles, Debugger* debugger) {
+  if (CpuTrace::is_enabled()) {
+    return profiler ? run_with<true, true>(cycles, debugger)
+                    : run_with<true, false>(cycles, debugger);
+  }
+
+  return profiler ? run_with<false, true>(cycles, debugger)
+                  : run_with<false, false>(cycles, debugger);
+}
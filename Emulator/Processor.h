@@ -10,15 +10,44 @@
 #define __Emulator__Processor__
 
 #include <memory>
+#include <vector>
 
+#include "CheatTable.h"
 #include "ControllerPad.h"
+#include "CpuTrace.h"
 #include "PPU.h"
+#include "PerfCounters.h"
+#include "SaveState.h"
 #include "defines.h"
 
+class APU;
+class Debugger;
+class GuestProfiler;
+class Mapper;
+
+// Devices that can hold the IRQ line; the line is asserted while any is
+enum IRQSource {
+  kIRQMapper = 0x01,
+  kIRQFrameCounter = 0x02,
+  kIRQDMC = 0x04,
+};
+
 class Processor {
+  friend class APU;  // The DMC reads samples over the CPU bus
+  friend class Benchmarks;
+  friend class ConformanceSuite;  // Starts nestest in automation mode
+  friend class Debugger;  // Reads registers and unmaps watched pages
+  friend class GuestProfiler;  // Reads registers and the PRG ROM mapping
+  friend class NsfPlayer;  // Calls routines directly, without a frame loop
+
+ public:
+  static const int kCPURAMSize = 2048;
+
  private:
   PPU* ppu;
   ControllerPad* controller_pad;
+  Mapper* mapper;
+  APU* apu;
 
   /* REGISTERS */
   dbyte pc;  // program counter, 16 bits
@@ -29,16 +58,52 @@ class Processor {
   byte y;    // index register y
 
   /* MEMORY */
-  static const int kCPURAMSize = 2048;
   static const int kSRAMSize = 8192;
 
-  std::unique_ptr<byte[]> prg_rom;
   byte cpu_ram[kCPURAMSize];
   byte sram[kSRAMSize];
 
+  // One entry per 256-byte page. Pages backed by plain memory (RAM, SRAM and
+  // the mapper's current PRG banks) are read and written directly; null
+  // entries go through the I/O registers and the mapper.
+  const byte* read_pages[256];
+  byte* write_pages[256];
+
+  // The real mappings of pages the debugger has unmapped to watch them.
+  // `watcher` is only set while the debugger is watching something.
+  const byte* watched_read_pages[256];
+  byte* watched_write_pages[256];
+  bool watched_pages[256];
+  Debugger* watcher;
+
+  // The current run's cycle budget, which end_run cuts short
+  int cycles_to_run;
+
+  GuestProfiler* profiler;  // Set while a profiler is attached
+
+  // PRG ROM as the mapper last mapped it at $8000-$FFFF. Pages that ROM
+  // cheats patch are mapped to a patched copy of it instead, so reads
+  // elsewhere are unaffected.
+  const byte* prg_rom_pages[128];
+  std::vector<byte> patched_pages[128];  // Empty for unpatched pages
+  std::vector<Cheat> rom_cheats;
+
+  byte irq_sources;  // IRQSource bits currently asserting the line
+
+  uint64_t cycle_count;  // CPU cycles since power on
+
+  PerfCounters counters;
+
   byte read_memory(dbyte address);
   void store_memory(dbyte address, byte word);
+  byte read_io(dbyte address);
+  void store_io(dbyte address, byte value);
   dbyte address_at(dbyte memloc);
+  const byte* memory_page(byte page);  // Null for I/O pages
+  byte peek_memory(dbyte address);     // Without side effects
+  void watch_page(byte page, bool watched);
+  void end_run() { cycles_to_run = 0; }  // After the current instruction
+  void map_prg_page(int page, const byte* data);
 
   /* STACK */
   void stack_push(byte value);
@@ -70,13 +135,52 @@ class Processor {
 
   /* HELPER FUNCTIONS */
   dbyte rel_addr(dbyte addr, byte offset);
+  int interrupt_request();
+  CpuTraceRecord trace_record();  // The state before the next instruction
+  void trace_instruction();
+
+  // Debugging, tracing and profiling each get an execute loop of their own,
+  // so the usual loop has no per-instruction checks for any of them
+  template <bool kDebugging, bool kTracing, bool kProfiling>
+  int run_loop(int cycles, Debugger* debugger);
+  template <bool kTracing, bool kProfiling>
+  int run_with(int cycles, Debugger* debugger);
 
  public:
   Processor(PPU* ppu, ControllerPad* controller_pad);
-  void set_prg_rom(std::unique_ptr<byte[]> prg_rom);
+  void set_mapper(Mapper* mapper);
+  void set_apu(APU* apu);
+
+  // Points `length` bytes of the address space at `address` (both multiples
+  // of 256) at PRG ROM
+  void map_prg_rom(dbyte address, size_t length, const byte* data);
+
+  // Applies the enabled cheats at $8000 and up to PRG ROM reads. Remapping
+  // only touches the pages they patch.
+  void set_rom_cheats(const std::vector<Cheat>& cheats);
+
+  // Writes the enabled cheats below $8000 into RAM and SRAM
+  void apply_ram_cheats(const std::vector<Cheat>& cheats);
+  void set_irq_line(IRQSource source, bool asserted);
+
+  uint64_t get_cycle_count();
   int execute();
+
+  // Executes instructions until at least `cycles` cycles have run and
+  // returns how many did. With a debugger, it's checked before each
+  // instruction and the run ends early when it stops; pass one only while
+  // it's active. A watchpoint ends the run after the instruction that hit
+  // it, with or without one.
+  int run(int cycles, Debugger* debugger);
+  void power_on();
   void reset();
   void non_maskable_interrupt();
+
+  const byte* get_cpu_ram();
+  const PerfCounters& get_perf_counters();
+
+  void save_state(StateWriter& writer);
+  void load_state(StateReader& reader);
 };
 
 #endif /* defined(__Emulator__Processor__) */
@@ -0,0 +1,192 @@
+//
+//  RollbackSession.cpp
+//  Emulator
+//
+
+#include "RollbackSession.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Packet layout, little-endian:
+//   0  'N' 'P'
+//   2  uint32 first frame of the inputs
+//   6  byte   input count
+//   7  uint32 next remote frame the sender needs (acknowledges all before it)
+//  11  inputs
+static const size_t kHeaderSize = 11;
+
+static void write_uint32(byte* destination, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    destination[i] = (value >> (i * 8)) & 0xFF;
+  }
+}
+
+static uint32_t read_uint32(const byte* source) {
+  return source[0] | (source[1] << 8) | (source[2] << 16) |
+         (static_cast<uint32_t>(source[3]) << 24);
+}
+
+RollbackSession::RollbackSession(Emulator* emulator,
+                                 NetplayTransport* transport, int local_player,
+                                 int input_delay)
+    : emulator(emulator),
+      transport(transport),
+      local_player(local_player),
+      input_delay(std::max(0, std::min(input_delay, +kMaxPrediction))),
+      frame(0),
+      window_total(0) {
+  // Nobody presses anything during the delay frames at the start
+  local_next = remote_next = remote_ack = this->input_delay;
+  rollback_frame = 0;
+
+  ::memset(local_inputs, 0, sizeof(local_inputs));
+  ::memset(remote_inputs, 0, sizeof(remote_inputs));
+  ::memset(remote_used, 0, sizeof(remote_used));
+  ::memset(&stats, 0, sizeof(stats));
+  ::memset(window, 0, sizeof(window));
+}
+
+void RollbackSession::send_inputs() {
+  // Resend everything the peer hasn't acknowledged, so a lost packet costs
+  // nothing as long as a later one arrives
+  uint32_t count =
+      std::min<uint32_t>(local_next - remote_ack, kMaxInputsPerPacket);
+
+  packet.resize(kHeaderSize + count);
+  packet[0] = 'N';
+  packet[1] = 'P';
+  write_uint32(&packet[2], remote_ack);
+  packet[6] = count;
+  write_uint32(&packet[7], remote_next);
+  for (uint32_t i = 0; i < count; i++) {
+    packet[kHeaderSize + i] = local_inputs[(remote_ack + i) % kInputHistory];
+  }
+
+  transport->send(packet);
+}
+
+void RollbackSession::receive_inputs() {
+  while (transport->receive(packet)) {
+    if (packet.size() < kHeaderSize || packet[0] != 'N' || packet[1] != 'P' ||
+        packet.size() < kHeaderSize + packet[6]) {
+      continue;
+    }
+
+    uint32_t first_frame = read_uint32(&packet[2]);
+    uint32_t count = packet[6];
+    uint32_t ack = read_uint32(&packet[7]);
+
+    if (ack > remote_ack && ack <= local_next) {
+      remote_ack = ack;
+    }
+
+    // Only take inputs that extend the confirmed run; anything else is a
+    // duplicate or will be resent
+    for (uint32_t f = std::max(first_frame, remote_next);
+         f < first_frame + count && f == remote_next &&
+         f < frame + kInputHistory - kMaxPrediction;
+         f++) {
+      byte input = packet[kHeaderSize + (f - first_frame)];
+      remote_inputs[f % kInputHistory] = input;
+      remote_next++;
+
+      if (f < frame && remote_used[f % kInputHistory] != input) {
+        rollback_frame = std::min(rollback_frame, f);
+      }
+    }
+  }
+}
+
+byte RollbackSession::predicted_remote_input(uint32_t f) {
+  if (f < remote_next) {
+    return remote_inputs[f % kInputHistory];
+  }
+
+  return remote_inputs[(remote_next - 1) % kInputHistory];
+}
+
+void RollbackSession::simulate(uint32_t f, bool present) {
+  emulator->save_state(snapshots[f % kSnapshotCount]);
+
+  byte local = local_inputs[f % kInputHistory];
+  byte remote = predicted_remote_input(f);
+  remote_used[f % kInputHistory] = remote;
+
+  if (local_player == 0) {
+    emulator->set_controller_buttons(local, remote);
+  } else {
+    emulator->set_controller_buttons(remote, local);
+  }
+
+  emulator->set_present_frames(present);
+  emulator->emulate_frame();
+}
+
+int RollbackSession::roll_back() {
+  if (rollback_frame >= frame) {
+    return 0;
+  }
+
+  emulator->load_state(snapshots[rollback_frame % kSnapshotCount]);
+  for (uint32_t f = rollback_frame; f < frame; f++) {
+    simulate(f, false);
+  }
+
+  int resimulated = frame - rollback_frame;
+  rollback_frame = frame;
+
+  stats.rollbacks++;
+  stats.resimulated_frames += resimulated;
+  stats.max_rollback_depth = std::max(stats.max_rollback_depth, resimulated);
+  return resimulated;
+}
+
+bool RollbackSession::advance_frame(byte local_buttons) {
+  receive_inputs();
+
+  if (frame >= remote_next + kMaxPrediction) {
+    stats.stalled_frames++;
+    send_inputs();
+    return false;
+  }
+
+  local_inputs[local_next % kInputHistory] = local_buttons;
+  local_next++;
+  send_inputs();
+
+  int resimulated = roll_back();
+  simulate(frame, true);
+  frame++;
+  rollback_frame = frame;
+
+  stats.frames++;
+  int& slot = window[stats.frames % kWindowFrames];
+  window_total += resimulated - slot;
+  slot = resimulated;
+  stats.max_resimulated_per_second =
+      std::max(stats.max_resimulated_per_second, window_total);
+
+  return true;
+}
+
+void RollbackSession::poll() {
+  receive_inputs();
+  send_inputs();
+  roll_back();
+}
+
+uint32_t RollbackSession::get_frame() { return frame; }
+
+uint32_t RollbackSession::get_confirmed_frame() {
+  return std::min(frame, remote_next);
+}
+
+NetplayStats RollbackSession::get_stats() {
+  NetplayStats result = stats;
+  if (stats.frames > 0) {
+    result.resimulated_per_second =
+        stats.resimulated_frames * 60.0 / stats.frames;
+  }
+  return result;
+}
@@ -0,0 +1,91 @@
+//
+//  RollbackSession.h
+//  Emulator
+//
+//  Two-player rollback netplay. Each peer runs the game immediately with a
+//  prediction of the remote player's input (their last confirmed buttons).
+//  When the real input arrives and differs from the prediction, the session
+//  restores the snapshot taken before the first mispredicted frame and
+//  re-simulates up to the present without presenting the frames.
+//
+
+#ifndef __Emulator__RollbackSession__
+#define __Emulator__RollbackSession__
+
+#include <cstdint>
+#include <vector>
+
+#include "Emulator.h"
+#include "NetplayTransport.h"
+#include "defines.h"
+
+struct NetplayStats {
+  uint64_t frames;
+  uint64_t rollbacks;
+  uint64_t resimulated_frames;
+  int max_rollback_depth;
+  uint64_t stalled_frames;  // Ticks spent waiting for the remote player
+  double resimulated_per_second;
+  int max_resimulated_per_second;  // Over any 60-frame window
+};
+
+class RollbackSession {
+ private:
+  // How far the session may run past the last confirmed remote input
+  static const int kMaxPrediction = 8;
+  static const int kSnapshotCount = kMaxPrediction + 1;
+  static const int kInputHistory = 64;
+  static const int kMaxInputsPerPacket = 32;
+  static const int kWindowFrames = 60;
+
+  Emulator* emulator;
+  NetplayTransport* transport;
+  int local_player;  // 0 or 1
+  int input_delay;
+
+  uint32_t frame;  // The next frame to emulate
+
+  // Inputs are known for frames before local_next and remote_next
+  byte local_inputs[kInputHistory];
+  uint32_t local_next;
+  byte remote_inputs[kInputHistory];
+  uint32_t remote_next;
+  uint32_t remote_ack;  // The peer has our inputs for frames before this
+
+  byte remote_used[kInputHistory];  // The remote input each frame ran with
+  uint32_t rollback_frame;          // == frame when no rollback is pending
+
+  std::vector<byte> snapshots[kSnapshotCount];  // Taken before each frame
+  std::vector<byte> packet;
+
+  NetplayStats stats;
+  int window[kWindowFrames];  // Frames re-simulated on each recent frame
+  int window_total;
+
+  void send_inputs();
+  void receive_inputs();
+  void simulate(uint32_t frame, bool present);
+  int roll_back();  // Returns the number of frames re-simulated
+  byte predicted_remote_input(uint32_t frame);
+
+ public:
+  // Both peers must start from the same power-on state. Local input takes
+  // effect `input_delay` frames after it's passed to advance_frame, which
+  // hides that much latency without any rollback.
+  RollbackSession(Emulator* emulator, NetplayTransport* transport,
+                  int local_player, int input_delay);
+
+  // Runs one frame with the local player's buttons. Returns false (running
+  // nothing) when the session is too far ahead of the remote player.
+  bool advance_frame(byte local_buttons);
+
+  // Exchanges input and applies any correction it brings, without running a
+  // new frame. Call it while the game is paused or stalled.
+  void poll();
+
+  uint32_t get_frame();
+  uint32_t get_confirmed_frame();  // Frames before this will never roll back
+  NetplayStats get_stats();
+};
+
+#endif /* defined(__Emulator__RollbackSession__) */
@@ -0,0 +1,141 @@
+//
+//  RomHeader.cpp
+//  Emulator
+//
+
+#include "RomHeader.h"
+
+static const int kPRGROMByte = 4;
+static const int kCHRROMByte = 5;
+static const int kFlags6Byte = 6;
+static const int kFlags7Byte = 7;
+static const int kPRGRAMByte = 8;
+
+// Flags 6
+static const int kVerticalMirroring = 0x01;
+static const int kBatteryBackedSRAM = 0x02;
+static const int kTrainer = 0x04;
+static const int kFourScreenMirroring = 0x08;
+
+static const int kMapperMask = 0xF0;
+
+// Flags 7
+static const int kConsoleTypeMask = 0x03;
+static const int kFormatMask = 0x0C;
+static const int kFormatNES20Bits = 0x08;
+static const int kFormatArchaicBits = 0x04;
+
+static const int kPRGROMPageSize = 16384;  // 16kb
+static const int kCHRROMPageSize = 8192;   // 8kb
+static const int kPRGRAMPageSize = 8192;   // 8kb
+
+//
+// NES 2.0 ROM sizes: a 12-bit page count, or when the upper nibble is $F, an
+// exponent-multiplier pair in the lower byte (2^E * (MM * 2 + 1) bytes).
+//
+static uint64_t nes20_rom_size(byte lsb, byte msb_nibble, int page_size) {
+  if (msb_nibble == 0x0F) {
+    int exponent = lsb >> 2;
+    int multiplier = (lsb & 0x03) * 2 + 1;
+    if (exponent > 60) {
+      // Larger than any file could be, and 2^E * 7 would overflow
+      return UINT64_MAX;
+    }
+    return (1ULL << exponent) * multiplier;
+  }
+
+  return static_cast<uint64_t>(msb_nibble << 8 | lsb) * page_size;
+}
+
+// NES 2.0 RAM sizes are shift counts: 64 << n bytes, or none if n is 0
+static uint32_t nes20_ram_size(int shift) { return shift ? 64u << shift : 0; }
+
+RomHeader::RomHeader(const byte* data) {
+  if (!(data[0] == 'N' && data[1] == 'E' && data[2] == 'S' &&
+        data[3] == '\x1A')) {
+    throw "This is not a valid NES ROM!";
+  }
+
+  byte flags6 = data[kFlags6Byte];
+  byte flags7 = data[kFlags7Byte];
+
+  if ((flags7 & kFormatMask) == kFormatNES20Bits) {
+    format = kFormatNES20;
+  } else if ((flags7 & kFormatMask) == kFormatArchaicBits ||
+             data[12] || data[13] || data[14] || data[15]) {
+    format = kFormatArchaicINES;
+  } else {
+    format = kFormatINES;
+  }
+
+  mirroring = flags6 & kFourScreenMirroring
+                  ? kMirroringFourScreen
+                  : flags6 & kVerticalMirroring ? kMirroringVertical
+                                                : kMirroringHorizontal;
+  battery = flags6 & kBatteryBackedSRAM;
+  trainer = flags6 & kTrainer;
+
+  mapper = (flags6 & kMapperMask) >> 4;
+  submapper = 0;
+  prg_nvram_size = 0;
+  chr_ram_size = 0;
+  chr_nvram_size = 0;
+  timing = kTimingNTSC;
+  misc_roms = 0;
+  expansion_device = 0;
+
+  if (format == kFormatArchaicINES) {
+    // Only the low mapper nibble can be trusted
+    console_type = kConsoleNES;
+    prg_rom_size = data[kPRGROMByte] * kPRGROMPageSize;
+    chr_rom_size = data[kCHRROMByte] * kCHRROMPageSize;
+    prg_ram_size = kPRGRAMPageSize;
+    return;
+  }
+
+  mapper |= flags7 & kMapperMask;
+  console_type = static_cast<ConsoleType>(flags7 & kConsoleTypeMask);
+
+  if (format == kFormatINES) {
+    prg_rom_size = data[kPRGROMByte] * kPRGROMPageSize;
+    chr_rom_size = data[kCHRROMByte] * kCHRROMPageSize;
+
+    // 0 means 8 KB, for compatibility with older dumps
+    prg_ram_size =
+        (data[kPRGRAMByte] ? data[kPRGRAMByte] : 1) * kPRGRAMPageSize;
+    if (!chr_rom_size) {
+      chr_ram_size = kCHRROMPageSize;
+    }
+    timing = data[9] & 0x01 ? kTimingPAL : kTimingNTSC;
+    return;
+  }
+
+  mapper |= (data[8] & 0x0F) << 8;
+  submapper = data[8] >> 4;
+
+  prg_rom_size =
+      nes20_rom_size(data[kPRGROMByte], data[9] & 0x0F, kPRGROMPageSize);
+  chr_rom_size =
+      nes20_rom_size(data[kCHRROMByte], data[9] >> 4, kCHRROMPageSize);
+
+  prg_ram_size = nes20_ram_size(data[10] & 0x0F);
+  prg_nvram_size = nes20_ram_size(data[10] >> 4);
+  chr_ram_size = nes20_ram_size(data[11] & 0x0F);
+  chr_nvram_size = nes20_ram_size(data[11] >> 4);
+
+  timing = static_cast<ConsoleTiming>(data[12] & 0x03);
+  misc_roms = data[14] & 0x03;
+  expansion_device = data[15] & 0x3F;
+}
+
+uint64_t RomHeader::rom_size() const {
+  uint64_t size = kSize + (trainer ? kTrainerSize : 0);
+  if (prg_rom_size > UINT64_MAX - size) {
+    return UINT64_MAX;
+  }
+  size += prg_rom_size;
+  if (chr_rom_size > UINT64_MAX - size) {
+    return UINT64_MAX;
+  }
+  return size + chr_rom_size;
+}
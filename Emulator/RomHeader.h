@@ -0,0 +1,66 @@
+//
+//  RomHeader.h
+//  Emulator
+//
+//  Parses the 16-byte iNES / NES 2.0 header at the start of a .nes file.
+//
+
+#ifndef __Emulator__RomHeader__
+#define __Emulator__RomHeader__
+
+#include <cstdint>
+
+#include "defines.h"
+
+enum RomFormat {
+  kFormatArchaicINES,  // Bytes 7-15 are unreliable (e.g. "DiskDude!")
+  kFormatINES,
+  kFormatNES20,
+};
+
+enum ConsoleType {
+  kConsoleNES,
+  kConsoleVsSystem,
+  kConsolePlayChoice,
+  kConsoleExtended,
+};
+
+enum ConsoleTiming {
+  kTimingNTSC,
+  kTimingPAL,
+  kTimingMultiRegion,
+  kTimingDendy,
+};
+
+struct RomHeader {
+  static const int kSize = 16;
+  static const int kTrainerSize = 512;
+
+  RomFormat format;
+  int mapper;
+  int submapper;  // NES 2.0 only
+
+  uint64_t prg_rom_size;  // Bytes
+  uint64_t chr_rom_size;  // 0 if the cartridge uses CHR RAM
+  uint32_t prg_ram_size;  // Sizes of RAM / NVRAM are 0 when unknown
+  uint32_t prg_nvram_size;
+  uint32_t chr_ram_size;
+  uint32_t chr_nvram_size;
+
+  Mirroring mirroring;
+  bool battery;
+  bool trainer;
+
+  ConsoleType console_type;
+  ConsoleTiming timing;
+  int misc_roms;         // NES 2.0: extra ROMs after CHR ROM
+  int expansion_device;  // NES 2.0: default expansion device
+
+  // Throws if `data` doesn't start with the iNES magic number
+  RomHeader(const byte* data);
+
+  // Header + trainer + PRG ROM + CHR ROM, or UINT64_MAX if that overflows
+  uint64_t rom_size() const;
+};
+
+#endif /* defined(__Emulator__RomHeader__) */
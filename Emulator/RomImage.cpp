@@ -0,0 +1,89 @@
+//
+//  RomImage.cpp
+//  Emulator
+//
+
+#include "RomImage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+// Identifies a file's contents: the same inode with the same size and
+// modification time
+typedef std::tuple<dev_t, ino_t, off_t, time_t, long> FileKey;
+
+std::mutex cache_mutex;
+std::map<FileKey, std::weak_ptr<const RomImage>> cache;
+
+}  // namespace
+
+RomImage::RomImage(const byte* data, size_t size) : data(data), size(size) {}
+
+RomImage::~RomImage() {
+  if (size) {
+    ::munmap(const_cast<byte*>(data), size);
+  }
+}
+
+std::shared_ptr<const RomImage> RomImage::open(std::string filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw "Could not open file for reading.";
+  }
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw "Could not open file for reading.";
+  }
+
+#ifdef __APPLE__
+  long mtime_nsec = info.st_mtimespec.tv_nsec;
+#else
+  long mtime_nsec = info.st_mtim.tv_nsec;
+#endif
+  FileKey key(info.st_dev, info.st_ino, info.st_size, info.st_mtime,
+              mtime_nsec);
+
+  std::lock_guard<std::mutex> lock(cache_mutex);
+
+  std::shared_ptr<const RomImage> image = cache[key].lock();
+  if (image) {
+    ::close(fd);
+    return image;
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  const byte* data = nullptr;
+
+  // mmap can't map an empty file; an empty image fails header validation
+  if (size) {
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(fd);
+      throw "Could not map ROM file.";
+    }
+    data = static_cast<const byte*>(mapping);
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+
+  image.reset(new RomImage(data, size));
+  cache[key] = image;
+
+  // Drop entries whose images have all been released
+  for (auto it = cache.begin(); it != cache.end();) {
+    it = it->second.expired() ? cache.erase(it) : std::next(it);
+  }
+
+  return image;
+}
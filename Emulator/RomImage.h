@@ -0,0 +1,38 @@
+//
+//  RomImage.h
+//  Emulator
+//
+//  An immutable, memory-mapped ROM file. Images are reference counted and
+//  shared: opening a file that is already open (in any Emulator in this
+//  process) returns the existing mapping, and separate processes share the
+//  same pages through the OS page cache.
+//
+
+#ifndef __Emulator__RomImage__
+#define __Emulator__RomImage__
+
+#include <memory>
+#include <string>
+
+#include "defines.h"
+
+class RomImage {
+ private:
+  const byte* data;
+  size_t size;
+
+  RomImage(const byte* data, size_t size);
+
+ public:
+  ~RomImage();
+  RomImage(const RomImage&) = delete;
+  RomImage& operator=(const RomImage&) = delete;
+
+  // Throws if the file can't be opened or mapped
+  static std::shared_ptr<const RomImage> open(std::string filename);
+
+  const byte* get_data() const { return data; }
+  size_t get_size() const { return size; }
+};
+
+#endif /* defined(__Emulator__RomImage__) */
@@ -0,0 +1,368 @@
+//
+//  RomLibrary.cpp
+//  Emulator
+//
+//  Index file format (integers little-endian):
+//
+//    "NESLIB\x1A" + version (1 byte), entry count (u32)
+//    Per entry: path length (u16), path, file size (u64), modification time
+//    (i64), valid (u8), header (16 bytes), CRC32 (u32), SHA-1 (20 bytes)
+//
+
+#include "RomLibrary.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "RomImage.h"
+
+static const char kIndexMagic[] = "NESLIB\x1A";
+static const byte kIndexVersion = 1;
+
+// Path length, file size, modification time, valid, header, CRC32, SHA-1,
+// for an entry with an empty path
+static const size_t kMinimumEntrySize = 2 + 8 + 8 + 1 + RomHeader::kSize + 4 +
+                                        std::tuple_size<SHA1Digest>::value;
+
+namespace {
+
+struct FoundFile {
+  std::string path;
+  uint64_t size;
+  int64_t modified_time;
+};
+
+bool has_nes_extension(const char* name) {
+  size_t length = ::strlen(name);
+  return length > 4 && (::strcasecmp(name + length - 4, ".nes") == 0);
+}
+
+// Symbolic links to files are followed, but links to directories aren't,
+// so a link loop can't recurse forever
+void find_roms(const std::string& directory, std::vector<FoundFile>& found) {
+  DIR* dir = ::opendir(directory.c_str());
+  if (!dir) {
+    return;
+  }
+
+  while (dirent* entry = ::readdir(dir)) {
+    if (!::strcmp(entry->d_name, ".") || !::strcmp(entry->d_name, "..")) {
+      continue;
+    }
+
+    std::string path = directory + "/" + entry->d_name;
+    struct stat info;
+    if (::lstat(path.c_str(), &info) != 0) {
+      continue;
+    }
+
+    if (S_ISLNK(info.st_mode) &&
+        (::stat(path.c_str(), &info) != 0 || S_ISDIR(info.st_mode))) {
+      continue;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+      find_roms(path, found);
+    } else if (S_ISREG(info.st_mode) && has_nes_extension(entry->d_name)) {
+#ifdef __APPLE__
+      long mtime_nsec = info.st_mtimespec.tv_nsec;
+#else
+      long mtime_nsec = info.st_mtim.tv_nsec;
+#endif
+      found.push_back({path, static_cast<uint64_t>(info.st_size),
+                       static_cast<int64_t>(info.st_mtime) * 1000000000 +
+                           mtime_nsec});
+    }
+  }
+
+  ::closedir(dir);
+}
+
+bool is_in_directory(const std::string& path, const std::string& directory) {
+  return path.size() > directory.size() &&
+         path.compare(0, directory.size(), directory) == 0 &&
+         path[directory.size()] == '/';
+}
+
+// Fills in everything but the path, size and modification time
+void index_rom(RomLibraryEntry& entry) {
+  entry.valid = false;
+  ::memset(entry.header, 0, RomHeader::kSize);
+  entry.crc32 = 0;
+  entry.sha1.fill(0);
+
+  try {
+    std::shared_ptr<const RomImage> image = RomImage::open(entry.path);
+    if (image->get_size() < RomHeader::kSize) {
+      return;
+    }
+
+    RomHeader header(image->get_data());
+    size_t start =
+        RomHeader::kSize + (header.trainer ? RomHeader::kTrainerSize : 0);
+    if (start > image->get_size()) {
+      return;
+    }
+
+    ::memcpy(entry.header, image->get_data(), RomHeader::kSize);
+    entry.crc32 = crc32(image->get_data() + start, image->get_size() - start);
+    entry.sha1 = sha1(image->get_data() + start, image->get_size() - start);
+    entry.valid = true;
+  } catch (const char* error) {
+    // Unreadable or not a ROM; indexed as invalid so it isn't retried
+  }
+}
+
+template <typename T>
+void write_le(std::ostream& stream, T value) {
+  for (size_t i = 0; i < sizeof(T); i++) {
+    stream.put(static_cast<char>(static_cast<uint64_t>(value) >> (i * 8)));
+  }
+}
+
+template <typename T>
+T read_le(std::istream& stream) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    int c = stream.get();
+    if (c == EOF) {
+      throw "ROM library index is corrupt.";
+    }
+    value |= static_cast<uint64_t>(c) << (i * 8);
+  }
+  return static_cast<T>(value);
+}
+
+void read_exact(std::istream& stream, void* destination, size_t length) {
+  if (!stream.read(static_cast<char*>(destination), length)) {
+    throw "ROM library index is corrupt.";
+  }
+}
+
+}  // namespace
+
+bool RomLibrary::load(std::string filename) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  char magic[sizeof(kIndexMagic) - 1];
+  read_exact(file, magic, sizeof(magic));
+  if (::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+      read_le<byte>(file) != kIndexVersion) {
+    throw "ROM library index is corrupt.";
+  }
+
+  // A corrupt count mustn't allocate more entries than the file could hold
+  uint32_t count = read_le<uint32_t>(file);
+  std::streampos position = file.tellg();
+  file.seekg(0, std::ios::end);
+  uint64_t remaining = static_cast<uint64_t>(file.tellg() - position);
+  file.seekg(position);
+  if (count > remaining / kMinimumEntrySize) {
+    throw "ROM library index is corrupt.";
+  }
+
+  std::vector<RomLibraryEntry> loaded(count);
+  for (RomLibraryEntry& entry : loaded) {
+    entry.path.resize(read_le<uint16_t>(file));
+    read_exact(file, &entry.path[0], entry.path.size());
+    entry.file_size = read_le<uint64_t>(file);
+    entry.modified_time = read_le<int64_t>(file);
+    entry.valid = read_le<byte>(file);
+    read_exact(file, entry.header, RomHeader::kSize);
+    entry.crc32 = read_le<uint32_t>(file);
+    read_exact(file, entry.sha1.data(), entry.sha1.size());
+  }
+
+  entries.swap(loaded);
+  return true;
+}
+
+void RomLibrary::save(std::string filename) {
+  // Write to a temporary file and rename it, so a crash never leaves a
+  // truncated index behind
+  std::string temporary = filename + ".tmp";
+
+  {
+    std::ofstream file(temporary,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      throw "Could not open ROM library index for writing.";
+    }
+
+    file.write(kIndexMagic, sizeof(kIndexMagic) - 1);
+    write_le<byte>(file, kIndexVersion);
+    write_le<uint32_t>(file, static_cast<uint32_t>(entries.size()));
+
+    for (const RomLibraryEntry& entry : entries) {
+      write_le<uint16_t>(file, static_cast<uint16_t>(entry.path.size()));
+      file.write(entry.path.data(), entry.path.size());
+      write_le<uint64_t>(file, entry.file_size);
+      write_le<int64_t>(file, entry.modified_time);
+      write_le<byte>(file, entry.valid);
+      file.write(reinterpret_cast<const char*>(entry.header), RomHeader::kSize);
+      write_le<uint32_t>(file, entry.crc32);
+      file.write(reinterpret_cast<const char*>(entry.sha1.data()),
+                 entry.sha1.size());
+    }
+
+    if (!file) {
+      throw "Could not write ROM library index.";
+    }
+  }
+
+  if (::rename(temporary.c_str(), filename.c_str()) != 0) {
+    throw "Could not write ROM library index.";
+  }
+}
+
+RomScanStats RomLibrary::scan(const std::vector<std::string>& directories,
+                              int threads) {
+  auto start = std::chrono::steady_clock::now();
+  RomScanStats stats = {};
+
+  std::vector<FoundFile> found;
+  for (const std::string& directory : directories) {
+    find_roms(directory, found);
+  }
+
+  // Overlapping or repeated scan directories find the same files again
+  std::sort(found.begin(), found.end(),
+            [](const FoundFile& a, const FoundFile& b) {
+              return a.path < b.path;
+            });
+  found.erase(std::unique(found.begin(), found.end(),
+                          [](const FoundFile& a, const FoundFile& b) {
+                            return a.path == b.path;
+                          }),
+              found.end());
+  stats.files = found.size();
+
+  std::map<std::string, const RomLibraryEntry*> previous;
+  for (const RomLibraryEntry& entry : entries) {
+    previous[entry.path] = &entry;
+  }
+
+  // Keep entries outside the scanned directories; reuse unchanged ones
+  std::vector<RomLibraryEntry> scanned;
+  std::vector<size_t> changed;
+
+  for (const RomLibraryEntry& entry : entries) {
+    bool in_scan = false;
+    for (const std::string& directory : directories) {
+      in_scan = in_scan || is_in_directory(entry.path, directory);
+    }
+    if (!in_scan) {
+      scanned.push_back(entry);
+      continue;
+    }
+
+    auto it = std::lower_bound(
+        found.begin(), found.end(), entry.path,
+        [](const FoundFile& file, const std::string& path) {
+          return file.path < path;
+        });
+    stats.removed += it == found.end() || it->path != entry.path;
+  }
+
+  for (const FoundFile& file : found) {
+    auto it = previous.find(file.path);
+    if (it != previous.end() && it->second->file_size == file.size &&
+        it->second->modified_time == file.modified_time) {
+      scanned.push_back(*it->second);
+      stats.unchanged++;
+    } else {
+      RomLibraryEntry entry;
+      entry.path = file.path;
+      entry.file_size = file.size;
+      entry.modified_time = file.modified_time;
+      changed.push_back(scanned.size());
+      scanned.push_back(entry);
+    }
+  }
+  stats.hashed = changed.size();
+
+  // Hash changed files in parallel; each worker claims the next file
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = static_cast<int>(std::min(static_cast<size_t>(threads),
+                                      std::max<size_t>(changed.size(), 1)));
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < changed.size(); i = next++) {
+      index_rom(scanned[changed[i]]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+
+  for (size_t i : changed) {
+    stats.invalid += !scanned[i].valid;
+  }
+
+  std::sort(scanned.begin(), scanned.end(),
+            [](const RomLibraryEntry& a, const RomLibraryEntry& b) {
+              return a.path < b.path;
+            });
+  entries.swap(scanned);
+
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return stats;
+}
+
+const std::vector<RomLibraryEntry>& RomLibrary::get_entries() {
+  return entries;
+}
+
+const RomLibraryEntry* RomLibrary::find_by_path(const std::string& path) {
+  auto it = std::lower_bound(
+      entries.begin(), entries.end(), path,
+      [](const RomLibraryEntry& entry, const std::string& path) {
+        return entry.path < path;
+      });
+  return it != entries.end() && it->path == path ? &*it : nullptr;
+}
+
+std::vector<const RomLibraryEntry*> RomLibrary::find_by_crc32(uint32_t crc32) {
+  std::vector<const RomLibraryEntry*> matches;
+  for (const RomLibraryEntry& entry : entries) {
+    if (entry.valid && entry.crc32 == crc32) {
+      matches.push_back(&entry);
+    }
+  }
+  return matches;
+}
+
+std::vector<const RomLibraryEntry*> RomLibrary::find_by_sha1(
+    const SHA1Digest& sha1) {
+  std::vector<const RomLibraryEntry*> matches;
+  for (const RomLibraryEntry& entry : entries) {
+    if (entry.valid && entry.sha1 == sha1) {
+      matches.push_back(&entry);
+    }
+  }
+  return matches;
+}
@@ -0,0 +1,67 @@
+//
+//  RomLibrary.h
+//  Emulator
+//
+//  An index of the .nes files in a set of directories: header, CRC32 and
+//  SHA-1 of every ROM, kept in a compact on-disk file so lookups don't have
+//  to read the ROMs again. Rescans only re-read files whose size or
+//  modification time changed.
+//
+
+#ifndef __Emulator__RomLibrary__
+#define __Emulator__RomLibrary__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Checksums.h"
+#include "RomHeader.h"
+#include "defines.h"
+
+struct RomLibraryEntry {
+  std::string path;
+  uint64_t file_size;
+  int64_t modified_time;  // Nanoseconds since the epoch
+
+  bool valid;  // false if the file isn't a readable NES ROM
+  byte header[RomHeader::kSize];
+
+  // Of the ROM data after the header and trainer, which is what ROM
+  // databases list
+  uint32_t crc32;
+  SHA1Digest sha1;
+
+  RomHeader get_header() const { return RomHeader(header); }
+};
+
+struct RomScanStats {
+  size_t files;      // .nes files found
+  size_t hashed;     // New or changed files that were read
+  size_t unchanged;  // Files reused from the index
+  size_t removed;    // Index entries whose files are gone
+  size_t invalid;    // Files that aren't valid ROMs
+  double seconds;
+};
+
+class RomLibrary {
+ private:
+  std::vector<RomLibraryEntry> entries;  // Sorted by path
+
+ public:
+  // Returns false if the index doesn't exist; throws if it is corrupt
+  bool load(std::string filename);
+  void save(std::string filename);
+
+  // Scans `directories` recursively using `threads` threads (0 for one per
+  // core). Symbolic links to directories aren't followed. Entries outside
+  // these directories are kept.
+  RomScanStats scan(const std::vector<std::string>& directories, int threads);
+
+  const std::vector<RomLibraryEntry>& get_entries();
+  const RomLibraryEntry* find_by_path(const std::string& path);
+  std::vector<const RomLibraryEntry*> find_by_crc32(uint32_t crc32);
+  std::vector<const RomLibraryEntry*> find_by_sha1(const SHA1Digest& sha1);
+};
+
+#endif /* defined(__Emulator__RomLibrary__) */
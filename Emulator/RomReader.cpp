@@ -9,129 +9,126 @@
 #include "RomReader.h"
 
 #include <bitset>
-#include <fstream>
+#include <cstring>
 #include <iostream>
 
-static const int kPRGROMByte = 4;
-static const int kCHRROMByte = 5;
-static const int kPRGRAMByte = 8;
-
-static const int kFourScreenMirroring = 0x08;
-static const int kHorizontalMirroring = 0x00;
-static const int kVerticalMirroring = 0x01;
-
-static const int kBatteryBackedSRAM = 0x02;
-static const int kTrainer = 0x04;
+//
+// Validates the header against the file size. Files may be longer than the
+// header says only when NES 2.0 declares miscellaneous ROMs after CHR ROM.
+//
+static const RomHeader& check_size(const RomHeader& header, long file_size) {
+  uint64_t size = static_cast<uint64_t>(file_size);
 
-static const int kMapperMask = 0xF0;
+  if (!header.prg_rom_size) {
+    throw "Program ROM bytes = 0";
+  }
 
-static const int kPRGROMPageSize = 16384;  // 16kb
-static const int kCHRROMPageSize = 8192;   // 8kb
-static const int kPRGRAMPageSize = 8192;   // 8kb
+  // NES 2.0 exponent sizes can be large enough to wrap the sum, so check
+  // each part on its own first
+  if (header.prg_rom_size > size || header.chr_rom_size > size) {
+    throw "Inconsistent file size";
+  }
 
-RomReader::RomReader(std::string filename) {
-  std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+  uint64_t rom_size = header.rom_size();
+  if (rom_size > size || (rom_size != size && !header.misc_roms)) {
+    throw "Inconsistent file size";
+  }
 
-  if (file.is_open()) {
-    fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-    file.read(reinterpret_cast<char*>(header), kROMHeaderSize);
+  return header;
+}
 
-    if (!(header[0] == 'N' && header[1] == 'E' && header[2] == 'S' &&
-          header[3] == '\x1A')) {
-      file.close();
-      throw "This is not a valid NES ROM!";
-    }
+static const byte* header_bytes(const RomImage& image) {
+  if (image.get_size() < RomHeader::kSize) {
+    throw "This is not a valid NES ROM!";
+  }
 
-    prg_rom_bytes = header[kPRGROMByte] * kPRGROMPageSize;
-    chr_rom_bytes = header[kCHRROMByte] * kCHRROMPageSize;
-    prg_ram_bytes = header[kPRGRAMByte] * kPRGRAMPageSize;
+  return image.get_data();
+}
 
-    if (!prg_ram_bytes) {
-      // This can be 0 in an old value of the .NES file format; assume 1 page if
-      // so
-      prg_ram_bytes = kPRGRAMPageSize;
-    }
+RomReader::RomReader(std::string filename)
+    : image(RomImage::open(filename)),
+      fileSize(static_cast<long>(image->get_size())),
+      parsed_header(check_size(RomHeader(header_bytes(*image)), fileSize)) {
+  ::memcpy(header, image->get_data(), RomHeader::kSize);
 
-    // Error checking
-    if (!prg_rom_bytes) {
-      throw "Program ROM bytes = 0";
-    }
+  prg_rom = image->get_data() + RomHeader::kSize +
+            (parsed_header.trainer ? RomHeader::kTrainerSize : 0);
+  chr_rom = parsed_header.chr_rom_size ? prg_rom + parsed_header.prg_rom_size
+                                       : nullptr;
+}
 
-    if (kROMHeaderSize + prg_rom_bytes + chr_rom_bytes != fileSize) {
-      throw "Inconsistent file size";
-    }
+std::shared_ptr<const RomImage> RomReader::get_image() { return image; }
 
-    prg_rom = std::make_unique<byte[]>(static_cast<size_t>(prg_rom_bytes));
-    file.read(reinterpret_cast<char*>(prg_rom.get()), prg_rom_bytes);
+const RomHeader& RomReader::get_header() { return parsed_header; }
 
-    chr_rom = nullptr;
-    if (chr_rom_bytes) {
-      chr_rom = std::make_unique<byte[]>(static_cast<size_t>(chr_rom_bytes));
-      file.read(reinterpret_cast<char*>(chr_rom.get()), chr_rom_bytes);
-    }
+const byte* RomReader::get_prg_rom() { return prg_rom; }
 
-    prg_ram = std::make_unique<byte[]>(static_cast<size_t>(prg_ram_bytes));
-    file.read(reinterpret_cast<char*>(prg_ram.get()), prg_ram_bytes);
+const byte* RomReader::get_chr_rom() { return chr_rom; }
 
-    file.close();
-  } else {
-    throw "Could not open file for reading.";
-  }
+size_t RomReader::get_prg_rom_size() {
+  return static_cast<size_t>(parsed_header.prg_rom_size);
 }
 
-std::unique_ptr<byte[]>&& RomReader::get_prg_rom() {
-  return std::move(prg_rom);
+size_t RomReader::get_chr_rom_size() {
+  return static_cast<size_t>(parsed_header.chr_rom_size);
 }
 
-std::unique_ptr<byte[]>&& RomReader::get_chr_rom() {
-  return std::move(chr_rom);
-}
+int RomReader::get_mapper_number() { return parsed_header.mapper; }
+
+Mirroring RomReader::get_mirroring() { return parsed_header.mirroring; }
 
 void RomReader::printDebugInfo() {
+  static const char* kFormatNames[] = {"archaic iNES", "iNES", "NES 2.0"};
+  static const char* kTimingNames[] = {"NTSC", "PAL", "Multi-region",
+                                       "Dendy"};
+  static const char* kMirroringNames[] = {
+      "Horizontal", "Vertical", "Single-screen", "Single-screen",
+      "Four-screen"};
+
   std::bitset<8> flags6(header[6]);
   std::bitset<8> flags7(header[7]);
-  std::bitset<8> flags9(header[9]);
-  std::bitset<8> flags10(header[10]);
+  const RomHeader& h = parsed_header;
 
   std::cout << "File size is " << fileSize << " bytes." << std::endl
             << std::endl
 
-            << header[0] << header[1] << header[2] << std::endl
-            << "Size of PRG ROM: " << prg_rom_bytes << " bytes" << std::endl
-            << "Size of CHR ROM: " << chr_rom_bytes << " bytes" << std::endl
-            << "Size of PRG RAM: " << prg_ram_bytes << " bytes" << std::endl
+            << header[0] << header[1] << header[2] << " ("
+            << kFormatNames[h.format] << ")" << std::endl
+            << "Size of PRG ROM: " << h.prg_rom_size << " bytes" << std::endl
+            << "Size of CHR ROM: " << h.chr_rom_size << " bytes" << std::endl
+            << "Size of PRG RAM: " << h.prg_ram_size << " bytes" << std::endl
+            << "Size of PRG NVRAM: " << h.prg_nvram_size << " bytes"
+            << std::endl
+            << "Size of CHR RAM: " << h.chr_ram_size << " bytes" << std::endl
+            << "Size of CHR NVRAM: " << h.chr_nvram_size << " bytes"
+            << std::endl
             << std::endl
 
             << "Flags 6: " << flags6 << std::endl
-            << "Flags 7: " << flags7 << std::endl
-            << "Flags 9: " << flags9 << std::endl
-            << "Flags 10: " << flags10 << std::endl;
-
-  // Mirroring type
-  std::cout << std::endl << "Mirroring Type: ";
-  if (header[6] & kFourScreenMirroring) {
-    std::cout << "Four-screen" << std::endl;
-  } else if (header[6] & kVerticalMirroring) {
-    std::cout << "Vertical" << std::endl;
-  } else if (header[6] & kHorizontalMirroring) {
-    std::cout << "Horizontal" << std::endl;
-  }
+            << "Flags 7: " << flags7 << std::endl;
+
+  std::cout << std::endl
+            << "Mirroring Type: " << kMirroringNames[h.mirroring] << std::endl
+            << "Timing: " << kTimingNames[h.timing] << std::endl;
 
-  if (header[6] & kBatteryBackedSRAM) {
+  if (h.battery) {
     std::cout << "Battery backed SRAM in CPU $6000-$7FFF" << std::endl;
   }
 
-  if (header[6] & kTrainer) {
+  if (h.trainer) {
     std::cout << "512 byte trainer at $7000-$71FF" << std::endl;
   }
 
-  int mapper = ((header[6] & kMapperMask) >> 4) | (header[7] & kMapperMask);
-  if (mapper) {
-    std::cout << "Memory Mapper: " << mapper << std::endl;
+  if (h.mapper || h.submapper) {
+    std::cout << "Memory Mapper: " << h.mapper << "." << h.submapper
+              << std::endl;
+  }
+
+  if (h.console_type != kConsoleNES) {
+    std::cout << "Console type: " << h.console_type << std::endl;
   }
 
-  if (header[7] || header[9] || header[10]) {
-    std::cout << "Unimplemented features in flags 7-10!";
+  if (h.misc_roms) {
+    std::cout << "Miscellaneous ROMs: " << h.misc_roms << std::endl;
   }
 }
@@ -12,28 +12,34 @@
 #include <memory>
 #include <string>
 
+#include "RomHeader.h"
+#include "RomImage.h"
 #include "defines.h"
 
 class RomReader {
  private:
-  static const int kROMHeaderSize = 16;
+  // PRG and CHR ROM point into the image, which must outlive them
+  std::shared_ptr<const RomImage> image;
 
   long fileSize;
-  byte header[kROMHeaderSize];
+  byte header[RomHeader::kSize];
+  RomHeader parsed_header;
 
-  long prg_rom_bytes;
-  long chr_rom_bytes;
-  long prg_ram_bytes;
-
-  std::unique_ptr<byte[]> prg_rom;
-  std::unique_ptr<byte[]> chr_rom;
-  std::unique_ptr<byte[]> prg_ram;
+  const byte* prg_rom;
+  const byte* chr_rom;
 
  public:
   RomReader(std::string filename);
 
-  std::unique_ptr<byte[]>&& get_prg_rom();
-  std::unique_ptr<byte[]>&& get_chr_rom();
+  std::shared_ptr<const RomImage> get_image();
+  const RomHeader& get_header();
+  const byte* get_prg_rom();
+  const byte* get_chr_rom();  // nullptr if the cartridge uses CHR RAM
+  size_t get_prg_rom_size();
+  size_t get_chr_rom_size();
+
+  int get_mapper_number();
+  Mirroring get_mirroring();
 
   void printDebugInfo();
 };
@@ -0,0 +1,79 @@
+//
+//  SDLAudio.cpp
+//  Emulator
+//
+
+#include "SDLAudio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Samples per callback; about 11 ms at 48 kHz
+static const Uint16 kDeviceBufferSamples = 512;
+
+// Enough to absorb a few late frames
+static const size_t kRingSamples = 8192;
+
+// Well under a callback's worth of audio
+static const auto kWaitInterval = std::chrono::microseconds(500);
+
+SDLAudio::SDLAudio(int sample_rate)
+    : device(0),
+      sample_rate(sample_rate),
+      device_buffer_samples(kDeviceBufferSamples),
+      ring(kRingSamples),
+      underruns(0) {
+  SDL_AudioSpec desired = {};
+  desired.freq = sample_rate;
+  desired.format = AUDIO_S16SYS;
+  desired.channels = 1;
+  desired.samples = kDeviceBufferSamples;
+  desired.callback = callback;
+  desired.userdata = this;
+
+  SDL_AudioSpec obtained;
+  device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained,
+                               SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+  if (device == 0) {
+    throw "Could not open audio device.";
+  }
+
+  this->sample_rate = obtained.freq;
+  device_buffer_samples = obtained.samples;
+  SDL_PauseAudioDevice(device, 0);
+}
+
+SDLAudio::~SDLAudio() { SDL_CloseAudioDevice(device); }
+
+void SDLAudio::callback(void* userdata, Uint8* stream, int length) {
+  SDLAudio* audio = static_cast<SDLAudio*>(userdata);
+  int16_t* samples = reinterpret_cast<int16_t*>(stream);
+  size_t count = length / sizeof(int16_t);
+
+  size_t read = audio->ring.read(samples, count);
+  if (read < count) {
+    std::fill(samples + read, samples + count, 0);
+    audio->underruns.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+int SDLAudio::get_sample_rate() { return sample_rate; }
+
+void SDLAudio::queue_samples(const int16_t* samples, size_t count) {
+  ring.write(samples, count);
+}
+
+size_t SDLAudio::get_queued_samples() {
+  return ring.size() + device_buffer_samples;
+}
+
+void SDLAudio::wait_for_queued_below(size_t samples) {
+  while (get_queued_samples() >= samples) {
+    std::this_thread::sleep_for(kWaitInterval);
+  }
+}
+
+uint64_t SDLAudio::get_underruns() {
+  return underruns.load(std::memory_order_relaxed);
+}
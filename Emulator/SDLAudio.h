@@ -0,0 +1,46 @@
+//
+//  SDLAudio.h
+//  Emulator
+//
+//  Plays the emulator's samples through an SDL audio device. Samples are
+//  queued from the emulation thread and pulled by SDL's callback thread
+//  through a lock-free ring; if the ring runs dry the callback plays silence.
+//
+
+#ifndef __Emulator__SDLAudio__
+#define __Emulator__SDLAudio__
+
+#include <atomic>
+#include <cstdint>
+
+#include "AudioRingBuffer.h"
+#include "SDL.h"
+
+class SDLAudio {
+ private:
+  SDL_AudioDeviceID device;
+  int sample_rate;  // As granted by the device
+  int device_buffer_samples;
+  AudioRingBuffer ring;
+  std::atomic<uint64_t> underruns;
+
+  static void callback(void* userdata, Uint8* stream, int length);
+
+ public:
+  // Throws if no audio device can be opened
+  SDLAudio(int sample_rate);
+  ~SDLAudio();
+
+  int get_sample_rate();
+  void queue_samples(const int16_t* samples, size_t count);
+
+  // Samples waiting in the ring, plus the device's own buffer
+  size_t get_queued_samples();
+
+  // Blocks until the device has drained the queue below `samples`
+  void wait_for_queued_below(size_t samples);
+
+  uint64_t get_underruns();
+};
+
+#endif /* defined(__Emulator__SDLAudio__) */
@@ -8,9 +8,11 @@
 
 #include "SDLRenderer.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "PPU.h"
+#include "Tracer.h"
 #include "defines.h"
 #include "nes_palette.h"
 
@@ -21,11 +23,6 @@ void drawPixel(SDL_Surface* surface, int x, int y, color_t color) {
   *p = SDL_MapRGB(surface->format, color.r, color.g, color.b);
 }
 
-Uint32 getPixel(SDL_Surface* surface, int x, int y) {
-  Uint32* p = (Uint32*)surface->pixels + y * surface->pitch / 4 + x;
-  return *p;
-}
-
 byte SDLRenderer::color_index_for_pattern_bit(int x, dbyte pattern_start,
                                               int palette_select, bool sprite) {
   // First, calculate the 4-bit palette address
@@ -34,8 +31,8 @@ byte SDLRenderer::color_index_for_pattern_bit(int x, dbyte pattern_start,
   // x is the horizontal index of the pixel we're looking for
   dbyte palette_address = kPaletteTableStart;
 
-  byte lower_byte = ppu->read_memory(pattern_start);
-  byte higher_byte = ppu->read_memory(pattern_start + 8);
+  byte lower_byte = ppu->read_page(pattern_start);
+  byte higher_byte = ppu->read_page(pattern_start + 8);
 
   int pattern_bit =
       7 - x;  // x is ascending left to right; that's H -> L in bit order
@@ -63,11 +60,19 @@ byte SDLRenderer::color_index_for_pattern_bit(int x, dbyte pattern_start,
 // @param scanline An integer between 0 and 239, inclusive
 //
 void SDLRenderer::render_scanline(int scanline) {
-  if (SDL_MUSTLOCK(screen)) {
-    SDL_LockSurface(screen);
-  }
+  TRACE_SCOPE("render_scanline");
+  render_span(scanline, 0, kScreenWidth);
+  finish_scanline(scanline);
+}
 
-  ppu->reset_more_than_8_sprites_flag();
+//
+// Render the pixels in [start, end) of a scanline with the current register
+// values. Spans must be drawn left to right.
+//
+void SDLRenderer::render_span(int scanline, int start, int end) {
+  if (start == 0) {
+    ppu->reset_more_than_8_sprites_flag();
+  }
 
   // TODO: Render Sprites & Background at the same time
 
@@ -75,14 +80,12 @@ void SDLRenderer::render_scanline(int scanline) {
   // RENDER THE BACKGROUND //
   ///////////////////////////
   if (ppu->enable_background()) {
-    int x = 0;
+    int x = start;
 
-    while (x < kScreenWidth) {
-      drawPixel(
-          screen, x, scanline,
-          NES_PALETTE[color_index_for_pattern_bit(
-              (x + ppu->regFH) % 8,  // bit offset within that tile
-              ppu->patterntable_address(), ppu->palette_select_bits(), false)]);
+    while (x < end) {
+      framebuffer[scanline][x] = color_index_for_pattern_bit(
+          (x + ppu->regFH) % 8,  // bit offset within that tile
+          ppu->patterntable_address(), ppu->palette_select_bits(), false);
 
       // roll over to the next tile?
       if ((++x + ppu->regFH) % 8 == 0) {
@@ -100,10 +103,6 @@ void SDLRenderer::render_scanline(int scanline) {
     }
 
     byte transparency_color_index = ppu->read_memory(kPaletteTableStart);
-    color_t transparency_color = NES_PALETTE[transparency_color_index];
-    Uint32 transparency_color_sdl =
-        SDL_MapRGB(screen->format, transparency_color.r, transparency_color.b,
-                   transparency_color.g);
 
     int sprites_drawn = 0;
 
@@ -134,7 +133,8 @@ void SDLRenderer::render_scanline(int scanline) {
       bool flip_vertical = color_attr & 0x80;
 
       int y = scanline - ypos;
-      for (int x = 0; x < 8; x++) {
+      int first_x = std::max(start - xpos, 0);
+      for (int x = first_x; x < 8 && xpos + x < end; x++) {
         dbyte pattern_start = pattern_base + pattern_num * kPatternSizeBytes +
                               (flip_vertical ? 7 - y : y);
         byte color_index =
@@ -142,36 +142,82 @@ void SDLRenderer::render_scanline(int scanline) {
                                         pattern_start, upper_color_bits, true);
 
         if (color_index != transparency_color_index) {
-          Uint32 current_pixel = getPixel(screen, xpos + x, scanline);
+          byte current_pixel = framebuffer[scanline][xpos + x];
 
           // Sprite 0 hit flag - TODO: Is this correct??
-          if (i == 0 && current_pixel != transparency_color_sdl) {
+          if (i == 0 && current_pixel != transparency_color_index) {
             ppu->set_sprite_0_flag();
           }
 
           // if color_attr & 0x20 == 0x20, sprite is drawn behind background
           // (but not transparent color)
           if ((color_attr & 0x20) == 0x00 ||
-              current_pixel == transparency_color_sdl) {
-            drawPixel(screen, xpos + x, scanline, NES_PALETTE[color_index]);
+              current_pixel == transparency_color_index) {
+            framebuffer[scanline][xpos + x] = color_index;
           }
         }
       }
     }
-  }
 
-  if (SDL_MUSTLOCK(screen)) {
-    SDL_UnlockSurface(screen);
+    if (end == kScreenWidth) {
+      ppu->counters.count_sprites_evaluated(sprites_drawn);
+    }
   }
+}
 
+void SDLRenderer::finish_scanline(int scanline) {
   if (scanline == 239) {
-    SDL_UpdateWindowSurface(window);
+    end_frame();
   }
 
   ppu->increment_vertical_scroll_counter();
 }
 
-SDLRenderer::SDLRenderer(PPU* ppu) : ppu(ppu) {
+//
+// Copy the finished frame to the window.
+//
+void SDLRenderer::present() {
+  TRACE_SCOPE("present");
+
+  if (SDL_MUSTLOCK(screen)) {
+    SDL_LockSurface(screen);
+  }
+
+  for (int y = 0; y < kScreenHeight; y++) {
+    for (int x = 0; x < kScreenWidth; x++) {
+      drawPixel(screen, x, y, NES_PALETTE[framebuffer[y][x] & 0x3F]);
+    }
+  }
+
+  if (SDL_MUSTLOCK(screen)) {
+    SDL_UnlockSurface(screen);
+  }
+
+  SDL_UpdateWindowSurface(window);
+}
+
+const byte* SDLRenderer::get_framebuffer() { return &framebuffer[0][0]; }
+
+byte* SDLRenderer::get_scanline(int scanline) { return framebuffer[scanline]; }
+
+void SDLRenderer::end_frame() {
+  if (window && present_frames) {
+    present();
+  }
+}
+
+void SDLRenderer::set_present_frames(bool present) { present_frames = present; }
+
+SDLRenderer::SDLRenderer(PPU* ppu, bool headless)
+    : window(nullptr),
+      screen(nullptr),
+      ppu(ppu),
+      present_frames(true),
+      framebuffer() {
+  if (headless) {
+    return;
+  }
+
   // create the screen surface
   window =
       SDL_CreateWindow("Emulator", SDL_WINDOWPOS_UNDEFINED,
@@ -16,17 +16,36 @@ class PPU;
 
 class SDLRenderer {
  private:
-  SDL_Window* window;
+  SDL_Window* window;  // nullptr when running headless
   SDL_Surface* screen;
   PPU* ppu;
+  bool present_frames;  // Fast-forward skips presenting most frames
+
+  // NES color index (0-63) of every pixel on the screen
+  byte framebuffer[kScreenHeight][kScreenWidth];
 
   byte color_index_for_pattern_bit(int x, dbyte pattern_start,
                                    int attr_high_bits, bool sprite);
+  void present();
 
  public:
-  SDLRenderer(PPU* ppu);
+  SDLRenderer(PPU* ppu, bool headless);
   ~SDLRenderer();
   void render_scanline(int scanline);
+
+  // render_scanline in pieces, for lines whose registers change partway
+  // through: spans from left to right, then finish_scanline
+  void render_span(int scanline, int start, int end);
+  void finish_scanline(int scanline);
+
+  void set_present_frames(bool present);
+
+  // For engines that draw their own pixels: a row of the framebuffer, and
+  // the call that shows the finished frame
+  byte* get_scanline(int scanline);
+  void end_frame();
+
+  const byte* get_framebuffer();
 };
 
 #endif
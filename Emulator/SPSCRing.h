@@ -0,0 +1,91 @@
+//
+//  SPSCRing.h
+//  Emulator
+//
+//  A fixed-size ring that hands items from one thread to another without
+//  locking. Exactly one thread may write and one may read. The head and tail
+//  count up forever and are masked into the storage, so a full ring needs no
+//  spare slot.
+//
+
+#ifndef __Emulator__SPSCRing__
+#define __Emulator__SPSCRing__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class SPSCRing {
+ private:
+  std::vector<T> items;
+  size_t mask;               // Capacity - 1; the capacity is a power of two
+  std::atomic<size_t> head;  // Next item to write, owned by the producer
+  std::atomic<size_t> tail;  // Next item to read, owned by the consumer
+
+ public:
+  // Rounds `capacity` up to a power of two
+  SPSCRing(size_t capacity) : head(0), tail(0) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+      rounded <<= 1;
+    }
+
+    items.resize(rounded);
+    mask = rounded - 1;
+  }
+
+  // Producer. Returns how many items were copied; those that don't fit are
+  // dropped.
+  size_t write(const T* source, size_t count) {
+    size_t write = head.load(std::memory_order_relaxed);
+    size_t free = items.size() - (write - tail.load(std::memory_order_acquire));
+    count = std::min(count, free);
+
+    // At most two copies: up to the end of the storage, then from the start
+    size_t start = write & mask;
+    size_t first = std::min(count, items.size() - start);
+    std::copy(source, source + first, items.begin() + start);
+    std::copy(source + first, source + count, items.begin());
+
+    head.store(write + count, std::memory_order_release);
+    return count;
+  }
+
+  // Consumer. Returns how many items were copied, stopping when the ring
+  // runs dry.
+  size_t read(T* destination, size_t count) {
+    size_t read = tail.load(std::memory_order_relaxed);
+    size_t available = head.load(std::memory_order_acquire) - read;
+    count = std::min(count, available);
+
+    size_t start = read & mask;
+    size_t first = std::min(count, items.size() - start);
+    std::copy(items.begin() + start, items.begin() + start + first,
+              destination);
+    std::copy(items.begin(), items.begin() + (count - first),
+              destination + first);
+
+    tail.store(read + count, std::memory_order_release);
+    return count;
+  }
+
+  // Consumer. The oldest item, left in the ring, or nullptr if it's empty.
+  const T* peek() const {
+    size_t read = tail.load(std::memory_order_relaxed);
+    if (read == head.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &items[read & mask];
+  }
+
+  size_t size() const {
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return items.size(); }
+};
+
+#endif /* defined(__Emulator__SPSCRing__) */
@@ -0,0 +1,76 @@
+//
+//  SaveState.h
+//  Emulator
+//
+//  Serializes emulator component state into a flat byte buffer. Values are
+//  copied in host byte order, so a snapshot is only valid on the host (and
+//  build) that produced it.
+//
+
+#ifndef Emulator_SaveState_h
+#define Emulator_SaveState_h
+
+#include <cstring>
+#include <vector>
+
+#include "defines.h"
+
+// Written at the start of every snapshot. Bump it whenever a component changes
+// what it saves, so stale snapshots (including those embedded in movies) are
+// rejected instead of loaded as garbage.
+//
+//   1  CPU, PPU and controller state
+//   2  Adds mapper bank registers
+//   3  Adds APU state
+//   4  Adds the CPU cycle count and controller 2
+static const byte kStateVersion = 4;
+
+class StateWriter {
+ private:
+  std::vector<byte>& data;
+
+ public:
+  StateWriter(std::vector<byte>& data) : data(data) {}
+
+  void write_bytes(const void* source, size_t length) {
+    const byte* bytes = static_cast<const byte*>(source);
+    data.insert(data.end(), bytes, bytes + length);
+  }
+
+  template <typename T>
+  void write(const T& value) {
+    write_bytes(&value, sizeof(T));
+  }
+};
+
+class StateReader {
+ private:
+  const std::vector<byte>& data;
+  size_t position;
+
+ public:
+  StateReader(const std::vector<byte>& data) : data(data), position(0) {}
+
+  void read_bytes(void* destination, size_t length) {
+    if (position + length > data.size()) {
+      throw "Save state is truncated.";
+    }
+
+    ::memcpy(destination, data.data() + position, length);
+    position += length;
+  }
+
+  template <typename T>
+  void read(T& value) {
+    read_bytes(&value, sizeof(T));
+  }
+
+  template <typename T>
+  T read() {
+    T value;
+    read(value);
+    return value;
+  }
+};
+
+#endif  // Emulator_SaveState_h
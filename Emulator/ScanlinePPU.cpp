@@ -0,0 +1,148 @@
+//
+//  ScanlinePPU.cpp
+//  Emulator
+//
+
+#include "ScanlinePPU.h"
+
+#include <algorithm>
+
+#include "Mapper.h"
+#include "PPU.h"
+
+static const int kDotsPerLine = 341;
+static const int kCyclesPerLine = 113;
+
+ScanlinePPU::ScanlinePPU(PPU* ppu) : ppu(ppu), frame_start_cycle(0) {}
+
+void ScanlinePPU::begin_frame(uint64_t cpu_cycle) {
+  frame_start_cycle = cpu_cycle;
+  ppu->log_writes = false;
+  ppu->write_log.clear();
+}
+
+bool ScanlinePPU::finish_scanline(int scanline) {
+  if (scanline == 0) {
+    ppu->reset_sprite_0_flag();
+  }
+
+  if (scanline == 20 && ppu->is_screen_enabled()) {
+    // This should happen at clock cycle 256!
+    ppu->update_scroll_counters_from_registers();
+  }
+
+  // These are the actual drawing scanlines
+  if (scanline >= 21 && scanline <= 260) {
+    ppu->log_writes = false;
+
+    if (!ppu->write_log.empty()) {
+      render_split_scanline(scanline);
+    } else if (ppu->is_screen_enabled()) {
+      ppu->renderer->render_scanline(scanline - 21);
+    }
+
+    if (ppu->is_screen_enabled()) {
+      // H & HT counters are updated at the end of hblank
+      ppu->cntH = ppu->regH;
+      ppu->cntHT = ppu->regHT;
+    }
+  }
+
+  // Log the writes made while the CPU runs the next line if it is visible
+  ppu->write_log.clear();
+  if (scanline >= 20 && scanline < 260) {
+    save_line_start();
+    ppu->log_writes = true;
+  }
+
+  // The MMC3 counts scanlines by watching the PPU fetch from the pattern
+  // tables, which happens on rendered lines and the pre-render line
+  if (ppu->mapper && scanline >= 20 && scanline <= 260 &&
+      ppu->is_screen_enabled()) {
+    ppu->mapper->clock_scanline();
+  }
+
+  if (scanline == 261) {
+    // Set the VBlank flag in the status register
+    ppu->set_vblank_flag();
+
+    // If VBlank interrupts are enabled, return true which will generate an
+    // interrupt
+    return ppu->vblank_interrupt_enabled();
+  }
+
+  return false;
+}
+
+// Register writes are logged by the PPU and replayed when the line is drawn
+void ScanlinePPU::catch_up(uint64_t cpu_cycle) {}
+
+void ScanlinePPU::save_line_start() {
+  line_start.control_1 = ppu->control_1;
+  line_start.control_2 = ppu->control_2;
+  line_start.regFV = ppu->regFV;
+  line_start.regV = ppu->regV;
+  line_start.regH = ppu->regH;
+  line_start.regVT = ppu->regVT;
+  line_start.regHT = ppu->regHT;
+  line_start.regFH = ppu->regFH;
+  line_start.regS = ppu->regS;
+  line_start.cntFV = ppu->cntFV;
+  line_start.cntV = ppu->cntV;
+  line_start.cntH = ppu->cntH;
+  line_start.cntVT = ppu->cntVT;
+  line_start.cntHT = ppu->cntHT;
+  line_start.first_write = ppu->first_write;
+}
+
+void ScanlinePPU::restore_line_start() {
+  ppu->control_1 = line_start.control_1;
+  ppu->control_2 = line_start.control_2;
+  ppu->regFV = line_start.regFV;
+  ppu->regV = line_start.regV;
+  ppu->regH = line_start.regH;
+  ppu->regVT = line_start.regVT;
+  ppu->regHT = line_start.regHT;
+  ppu->regFH = line_start.regFH;
+  ppu->regS = line_start.regS;
+  ppu->cntFV = line_start.cntFV;
+  ppu->cntV = line_start.cntV;
+  ppu->cntH = line_start.cntH;
+  ppu->cntVT = line_start.cntVT;
+  ppu->cntHT = line_start.cntHT;
+  ppu->first_write = line_start.first_write;
+}
+
+//
+// Draws a line the CPU wrote registers during. Replaying the log leaves the
+// registers as the CPU left them; the scroll counters additionally carry
+// the drawing's increments, as they would on the hardware.
+//
+void ScanlinePPU::render_split_scanline(int scanline) {
+  restore_line_start();
+
+  int line = scanline - 21;
+  int x = 0;
+
+  for (const PPURegisterWrite& write : ppu->write_log) {
+    // Pixel x is drawn at dot x + 1. Writes during hblank (or after the CPU
+    // ran past the end of the line) land after the last pixel.
+    int64_t dot = static_cast<int64_t>(write.cpu_cycle - frame_start_cycle) *
+                      kDotsPerLine / kCyclesPerLine -
+                  static_cast<int64_t>(scanline) * kDotsPerLine;
+    int end = static_cast<int>(
+        std::min<int64_t>(std::max<int64_t>(dot - 1, x), kScreenWidth));
+
+    if (end > x && ppu->is_screen_enabled()) {
+      ppu->renderer->render_span(line, x, end);
+    }
+    x = end;
+
+    ppu->replay_write(write);
+  }
+
+  if (ppu->is_screen_enabled()) {
+    ppu->renderer->render_span(line, x, kScreenWidth);
+    ppu->renderer->finish_scanline(line);
+  }
+}
@@ -0,0 +1,51 @@
+//
+//  ScanlinePPU.h
+//  Emulator
+//
+//  The fast PPU engine. Each scanline is drawn by SDLRenderer in one pass
+//  after the CPU has run it, and the scroll counters are updated at line
+//  boundaries rather than at the dots where the hardware updates them.
+//
+//  Register writes the CPU makes during a visible line are logged with their
+//  cycle. A line with writes is drawn in spans instead: the registers are
+//  rewound to their values at the start of the line and each write is
+//  replayed at the pixel the PPU was drawing when it happened, which keeps
+//  mid-line scroll and pattern table splits in place.
+//
+
+#ifndef __Emulator__ScanlinePPU__
+#define __Emulator__ScanlinePPU__
+
+#include "PPUEngine.h"
+#include "defines.h"
+
+class PPU;
+
+class ScanlinePPU : public PPUEngine {
+ private:
+  // The registers that drawing a line depends on
+  struct LineState {
+    byte control_1;
+    byte control_2;
+    byte regFV, regV, regH, regVT, regHT, regFH, regS;
+    byte cntFV, cntV, cntH, cntVT, cntHT;
+    bool first_write;
+  };
+
+  PPU* ppu;
+  uint64_t frame_start_cycle;
+  LineState line_start;  // When the CPU started the line being logged
+
+  void save_line_start();
+  void restore_line_start();
+  void render_split_scanline(int scanline);
+
+ public:
+  ScanlinePPU(PPU* ppu);
+
+  void begin_frame(uint64_t cpu_cycle) override;
+  bool finish_scanline(int scanline) override;
+  void catch_up(uint64_t cpu_cycle) override;
+};
+
+#endif /* defined(__Emulator__ScanlinePPU__) */
@@ -0,0 +1,170 @@
+//
+//  Tracer.cpp
+//  Emulator
+//
+
+#include "Tracer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+static const auto kFlushInterval = std::chrono::milliseconds(10);
+static const size_t kDrainBatch = 256;
+
+std::atomic<bool> Tracer::enabled(false);
+
+TraceBuffer::TraceBuffer(int thread_id)
+    : events(kCapacity), thread_id(thread_id), dropped(0) {}
+
+bool TraceBuffer::push(const TraceEvent& event) {
+  if (!events.write(&event, 1)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+size_t TraceBuffer::pop(TraceEvent* destination, size_t max_events) {
+  return events.read(destination, max_events);
+}
+
+Tracer::Tracer() : next_thread_id(1), first_event(true), stop_requested(false),
+                   origin(0) {}
+
+Tracer& Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+uint64_t Tracer::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Tracer::start(std::string filename) {
+  if (is_enabled()) {
+    stop();
+  }
+
+  file.open(filename, std::ios::out | std::ios::trunc);
+  if (!file.is_open()) {
+    throw "Could not open trace file for writing.";
+  }
+
+  // Discard anything left over from a previous session
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    TraceEvent events[kDrainBatch];
+    for (auto& buffer : buffers) {
+      while (buffer->pop(events, kDrainBatch)) {
+      }
+    }
+  }
+
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  first_event = true;
+  origin = now();
+  stop_requested = false;
+
+  enabled = true;
+  writer = std::thread(&Tracer::write_loop, this);
+}
+
+void Tracer::stop() {
+  if (!is_enabled()) {
+    return;
+  }
+
+  enabled = false;
+  stop_requested = true;
+  writer.join();
+
+  file << "\n]}\n";
+  file.close();
+
+  uint64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto& buffer : buffers) {
+      dropped += buffer->dropped.exchange(0);
+    }
+  }
+
+  if (dropped) {
+    std::cerr << "Tracer: dropped " << dropped
+              << " events because a buffer was full" << std::endl;
+  }
+}
+
+TraceBuffer* Tracer::buffer_for_current_thread() {
+  // The buffer is shared with the writer, so it outlives its thread
+  thread_local std::shared_ptr<TraceBuffer> buffer;
+
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffer = std::make_shared<TraceBuffer>(next_thread_id++);
+    buffers.push_back(buffer);
+  }
+
+  return buffer.get();
+}
+
+void Tracer::record(const char* name, char phase, uint64_t start,
+                    uint64_t end) {
+  if (start < origin) {
+    return;  // Started before tracing did
+  }
+
+  buffer_for_current_thread()->push(
+      {name, phase, start - origin, end - start});
+}
+
+void Tracer::write_loop() {
+  while (!stop_requested) {
+    std::this_thread::sleep_for(kFlushInterval);
+    drain();
+  }
+
+  drain();
+}
+
+void Tracer::drain() {
+  std::vector<std::shared_ptr<TraceBuffer>> current;
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    current = buffers;
+  }
+
+  TraceEvent events[kDrainBatch];
+  char line[256];
+
+  for (auto& buffer : current) {
+    size_t count;
+    while ((count = buffer->pop(events, kDrainBatch))) {
+      for (size_t i = 0; i < count; i++) {
+        const TraceEvent& event = events[i];
+
+        // Timestamps are in microseconds
+        if (event.phase == 'X') {
+          snprintf(line, sizeof(line),
+                   "{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                   "\"dur\": %.3f, \"pid\": 1, \"tid\": %d}",
+                   event.name, event.start / 1000.0, event.duration / 1000.0,
+                   buffer->thread_id);
+        } else {
+          snprintf(line, sizeof(line),
+                   "{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"g\", "
+                   "\"ts\": %.3f, \"pid\": 1, \"tid\": %d}",
+                   event.name, event.start / 1000.0, buffer->thread_id);
+        }
+
+        file << (first_event ? "" : ",\n") << line;
+        first_event = false;
+      }
+    }
+  }
+
+  file.flush();
+}
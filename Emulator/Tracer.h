@@ -0,0 +1,111 @@
+//
+//  Tracer.h
+//  Emulator
+//
+//  Records timeline events in the Chrome trace-event format, viewable in
+//  chrome://tracing or Perfetto. Each thread writes into its own lock-free
+//  buffer, which a background thread drains to the output file. When tracing
+//  is off, a trace point costs a single relaxed atomic load.
+//
+
+#ifndef __Emulator__Tracer__
+#define __Emulator__Tracer__
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SPSCRing.h"
+
+struct TraceEvent {
+  const char* name;  // Must be a string literal
+  char phase;        // 'X' (complete span) or 'i' (instant)
+  uint64_t start;    // Nanoseconds since the trace started
+  uint64_t duration;
+};
+
+// Single producer (the owning thread), single consumer (the writer thread)
+class TraceBuffer {
+ private:
+  static const size_t kCapacity = 1 << 14;
+
+  SPSCRing<TraceEvent> events;
+
+ public:
+  const int thread_id;
+  std::atomic<uint64_t> dropped;
+
+  TraceBuffer(int thread_id);
+
+  bool push(const TraceEvent& event);
+  size_t pop(TraceEvent* destination, size_t max_events);
+};
+
+class Tracer {
+ private:
+  static std::atomic<bool> enabled;
+
+  std::mutex buffers_mutex;  // Only taken when a thread first traces
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  int next_thread_id;
+
+  std::ofstream file;
+  bool first_event;
+  std::thread writer;
+  std::atomic<bool> stop_requested;
+  uint64_t origin;
+
+  Tracer();
+
+  TraceBuffer* buffer_for_current_thread();
+  void write_loop();
+  void drain();
+
+ public:
+  static Tracer& instance();
+
+  static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+  static uint64_t now();  // Monotonic nanoseconds
+
+  void start(std::string filename);
+  void stop();
+
+  void record(const char* name, char phase, uint64_t start, uint64_t end);
+};
+
+// Records a span covering the enclosing scope
+class TraceScope {
+ private:
+  const char* name;
+  uint64_t start;
+
+ public:
+  TraceScope(const char* name)
+      : name(name), start(Tracer::is_enabled() ? Tracer::now() : 0) {}
+
+  ~TraceScope() {
+    if (start && Tracer::is_enabled()) {
+      Tracer::instance().record(name, 'X', start, Tracer::now());
+    }
+  }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#define TRACE_INSTANT(name)                                        \
+  do {                                                             \
+    if (Tracer::is_enabled()) {                                    \
+      uint64_t trace_now = Tracer::now();                          \
+      Tracer::instance().record(name, 'i', trace_now, trace_now);  \
+    }                                                              \
+  } while (0)
+
+#endif /* defined(__Emulator__Tracer__) */
@@ -0,0 +1,29 @@
+//
+//  UxROM.cpp
+//  Emulator
+//
+
+#include "UxROM.h"
+
+void UxROM::reset() {
+  prg_bank = 0;
+  Mapper::reset();
+}
+
+void UxROM::update_banks() {
+  map_prg_bank(0x8000, 0x4000, prg_bank);
+  map_prg_bank(0xC000, 0x4000, -1);
+  map_chr_bank(0x0000, 0x2000, 0);
+}
+
+void UxROM::write_register(dbyte address, byte value) {
+  prg_bank = value;
+  map_prg_bank(0x8000, 0x4000, prg_bank);
+}
+
+void UxROM::save_state(StateWriter& writer) { writer.write(prg_bank); }
+
+void UxROM::load_state(StateReader& reader) {
+  reader.read(prg_bank);
+  Mapper::load_state(reader);
+}
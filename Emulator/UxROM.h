@@ -0,0 +1,30 @@
+//
+//  UxROM.h
+//  Emulator
+//
+//  Mapper 2: a switchable 16 KB PRG bank at $8000 and the last bank fixed at
+//  $C000. CHR is usually RAM.
+//
+
+#ifndef __Emulator__UxROM__
+#define __Emulator__UxROM__
+
+#include "Mapper.h"
+
+class UxROM : public Mapper {
+ private:
+  byte prg_bank;
+
+  void update_banks() override;
+
+ public:
+  using Mapper::Mapper;
+
+  void reset() override;
+  void write_register(dbyte address, byte value) override;
+
+  void save_state(StateWriter& writer) override;
+  void load_state(StateReader& reader) override;
+};
+
+#endif /* defined(__Emulator__UxROM__) */
@@ -0,0 +1,183 @@
+//
+//  VideoCapture.cpp
+//  Emulator
+//
+
+#include "VideoCapture.h"
+
+#include <cstring>
+
+#include "nes_palette.h"
+
+static const int kFrameSize = kScreenWidth * kScreenHeight;
+
+// The NTSC frame rate, 39375000 / 22 / 29780.5 Hz; pixels are 8:7
+static const char kY4MHeader[] =
+    "YUV4MPEG2 W256 H240 F39375000:655171 Ip A8:7";
+
+struct YUVTables {
+  byte y[64];
+  int u[64];
+  int v[64];
+
+  YUVTables() {
+    for (int i = 0; i < 64; i++) {
+      double r = NES_PALETTE[i].r, g = NES_PALETTE[i].g, b = NES_PALETTE[i].b;
+      y[i] = static_cast<byte>(16.5 + (65.481 * r + 128.553 * g + 24.966 * b) /
+                                          255);
+      u[i] = static_cast<int>(128.5 +
+                              (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+      v[i] = static_cast<int>(128.5 +
+                              (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+    }
+  }
+};
+
+static const YUVTables kYUV;
+
+VideoCapture::VideoCapture(std::string destination, VideoFormat format,
+                           bool y4m)
+    : format(format),
+      y4m(y4m),
+      closing(false),
+      frames_written(0),
+      frames_dropped(0) {
+  if (y4m && format == kVideoRGB24) {
+    throw "Y4M can't hold RGB video.";
+  }
+
+  is_pipe = !destination.empty() && destination[0] == '|';
+  file = is_pipe ? popen(destination.c_str() + 1, "w")
+                 : fopen(destination.c_str(), "wb");
+  if (!file) {
+    throw "Could not open video capture for writing.";
+  }
+
+  if (y4m) {
+    fprintf(file, "%s %s\n", kY4MHeader,
+            format == kVideoYUV420 ? "C420jpeg XYSCSS=420JPEG" : "Cmono");
+  }
+
+  for (int i = 0; i < kPoolFrames; i++) {
+    pool[i].resize(kFrameSize);
+    free_frames.push_back(i);
+  }
+
+  writer = std::make_unique<BackgroundWriter<int>>(
+      kPoolFrames, [this](int& index) { return write_pooled_frame(index); });
+}
+
+VideoCapture::~VideoCapture() {
+  try {
+    close();
+  } catch (const char* error) {
+    // Never throw from a destructor; the capture is left incomplete.
+  }
+}
+
+bool VideoCapture::write_frame(const byte* framebuffer) {
+  int index;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_frames.empty() || closing) {
+      frames_dropped++;
+      return false;
+    }
+    index = free_frames.back();
+    free_frames.pop_back();
+  }
+
+  // Copy outside the lock; no one else touches a frame that isn't queued
+  ::memcpy(pool[index].data(), framebuffer, kFrameSize);
+  writer->push(index);
+  return true;
+}
+
+void VideoCapture::convert(const byte* frame, std::vector<byte>& out) {
+  switch (format) {
+    case kVideoPaletteIndex:
+      out.resize(kFrameSize);
+      for (int i = 0; i < kFrameSize; i++) {
+        out[i] = frame[i] & 0x3F;
+      }
+      break;
+
+    case kVideoRGB24:
+      out.resize(kFrameSize * 3);
+      for (int i = 0; i < kFrameSize; i++) {
+        const color_t& color = NES_PALETTE[frame[i] & 0x3F];
+        out[i * 3] = color.r;
+        out[i * 3 + 1] = color.g;
+        out[i * 3 + 2] = color.b;
+      }
+      break;
+
+    case kVideoYUV420: {
+      const int chroma_size = kFrameSize / 4;
+      out.resize(kFrameSize + chroma_size * 2);
+      byte* y = out.data();
+      byte* u = y + kFrameSize;
+      byte* v = u + chroma_size;
+
+      for (int i = 0; i < kFrameSize; i++) {
+        y[i] = kYUV.y[frame[i] & 0x3F];
+      }
+
+      // Each chroma sample averages a 2x2 block
+      for (int row = 0; row < kScreenHeight; row += 2) {
+        const byte* top = frame + row * kScreenWidth;
+        const byte* bottom = top + kScreenWidth;
+        for (int x = 0; x < kScreenWidth; x += 2) {
+          int a = top[x] & 0x3F, b = top[x + 1] & 0x3F;
+          int c = bottom[x] & 0x3F, d = bottom[x + 1] & 0x3F;
+          *u++ = (kYUV.u[a] + kYUV.u[b] + kYUV.u[c] + kYUV.u[d] + 2) >> 2;
+          *v++ = (kYUV.v[a] + kYUV.v[b] + kYUV.v[c] + kYUV.v[d] + 2) >> 2;
+        }
+      }
+      break;
+    }
+  }
+}
+
+bool VideoCapture::write_pooled_frame(int index) {
+  convert(pool[index].data(), converted);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    free_frames.push_back(index);
+  }
+
+  bool written = (!y4m || fputs("FRAME\n", file) != EOF) &&
+                 fwrite(converted.data(), 1, converted.size(), file) ==
+                     converted.size();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  frames_written++;
+  return written;
+}
+
+void VideoCapture::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closing) {
+      return;
+    }
+    closing = true;
+  }
+
+  bool written = writer->close();
+  bool failed = is_pipe ? pclose(file) != 0 : fclose(file) != 0;
+  if (!written || failed) {
+    throw "Could not write video capture.";
+  }
+}
+
+VideoCaptureStats VideoCapture::get_stats() {
+  VideoCaptureStats stats;
+  stats.queued_frames = static_cast<int>(writer->get_queued());
+  stats.max_queued_frames = static_cast<int>(writer->get_max_queued());
+
+  std::lock_guard<std::mutex> lock(mutex);
+  stats.frames_written = frames_written;
+  stats.frames_dropped = frames_dropped;
+  return stats;
+}
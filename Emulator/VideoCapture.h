@@ -0,0 +1,81 @@
+//
+//  VideoCapture.h
+//  Emulator
+//
+//  Streams finished frames to a file or pipe. Each frame's color indices are
+//  copied into one of a fixed pool of buffers; a background thread converts
+//  and writes them. When the writer falls behind and the pool runs out,
+//  frames are dropped rather than making the emulator wait.
+//
+
+#ifndef __Emulator__VideoCapture__
+#define __Emulator__VideoCapture__
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BackgroundWriter.h"
+#include "defines.h"
+
+enum VideoFormat {
+  kVideoPaletteIndex,  // One byte per pixel, the NES color index
+  kVideoRGB24,
+  kVideoYUV420,  // BT.601 limited range, 4:2:0
+};
+
+struct VideoCaptureStats {
+  uint64_t frames_written;
+  uint64_t frames_dropped;
+  int queued_frames;  // Waiting for the writer right now
+  int max_queued_frames;
+};
+
+class VideoCapture {
+ private:
+  static const int kPoolFrames = 8;
+
+  FILE* file;
+  bool is_pipe;
+  VideoFormat format;
+  bool y4m;
+
+  std::vector<byte> pool[kPoolFrames];
+  std::vector<byte> converted;  // Only touched by the writer
+
+  std::mutex mutex;
+  std::vector<int> free_frames;  // Indexes into pool
+  bool closing;
+  uint64_t frames_written;
+  uint64_t frames_dropped;
+
+  // Queues indexes into pool. It never waits, as there are only
+  // kPoolFrames to queue.
+  std::unique_ptr<BackgroundWriter<int>> writer;
+
+  bool write_pooled_frame(int index);
+  void convert(const byte* frame, std::vector<byte>& out);
+
+ public:
+  // A destination starting with '|' is run as a shell command that reads
+  // the stream on stdin, e.g. "|ffmpeg -i - out.mp4". With `y4m`, a
+  // YUV4MPEG2 header and frame markers are written; palette indices go out
+  // as monochrome. RGB24 can only be written raw. Throws if the destination
+  // can't be opened.
+  VideoCapture(std::string destination, VideoFormat format, bool y4m);
+  ~VideoCapture();
+
+  // Queues a kScreenWidth * kScreenHeight frame of color indices. Returns
+  // false if the frame was dropped because every buffer is in use.
+  bool write_frame(const byte* framebuffer);
+
+  // Waits for queued frames to be written. Throws if any write failed.
+  void close();
+
+  VideoCaptureStats get_stats();
+};
+
+#endif /* defined(__Emulator__VideoCapture__) */
@@ -0,0 +1,123 @@
+//
+//  WavWriter.cpp
+//  Emulator
+//
+
+#include "WavWriter.h"
+
+#include <algorithm>
+
+static const size_t kBlockSamples = 1 << 16;
+
+// Blocks the caller may get ahead of the disk by before it waits
+static const size_t kMaxQueuedBlocks = 8;
+
+static const uint32_t kHeaderSize = 44;
+
+// RIFF sizes are 32 bits; longer files are truncated
+static const uint64_t kMaxSamples = (0xFFFFFFFFULL - kHeaderSize) / 2;
+
+// WAV fields are little-endian whatever the host is
+static void put_le(std::vector<char>& out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out.push_back(static_cast<char>(value >> (i * 8)));
+  }
+}
+
+WavWriter::WavWriter(std::string filename, int sample_rate)
+    : sample_rate(sample_rate), samples_written(0) {
+  file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw "Could not open WAV file for writing.";
+  }
+
+  // Sizes are filled in once the length is known
+  write_header(0);
+  block.reserve(kBlockSamples);
+  writer = std::make_unique<BackgroundWriter<std::vector<int16_t>>>(
+      kMaxQueuedBlocks,
+      [this](std::vector<int16_t>& samples) { return write_block(samples); });
+}
+
+WavWriter::~WavWriter() {
+  try {
+    close();
+  } catch (const char* error) {
+    // Never throw from a destructor; the file is left incomplete.
+  }
+}
+
+void WavWriter::write_header(uint64_t samples) {
+  uint32_t data_size = static_cast<uint32_t>(samples * 2);
+  std::vector<char> header;
+
+  header.insert(header.end(), {'R', 'I', 'F', 'F'});
+  put_le(header, kHeaderSize - 8 + data_size, 4);
+  header.insert(header.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+  put_le(header, 16, 4);               // Format chunk size
+  put_le(header, 1, 2);                // PCM
+  put_le(header, 1, 2);                // Mono
+  put_le(header, sample_rate, 4);
+  put_le(header, sample_rate * 2, 4);  // Bytes per second
+  put_le(header, 2, 2);                // Bytes per frame
+  put_le(header, 16, 2);               // Bits per sample
+  header.insert(header.end(), {'d', 'a', 't', 'a'});
+  put_le(header, data_size, 4);
+
+  file.seekp(0);
+  file.write(header.data(), header.size());
+}
+
+void WavWriter::write(const int16_t* samples, size_t count) {
+  count = static_cast<size_t>(
+      std::min<uint64_t>(count, kMaxSamples - samples_written));
+  samples_written += count;
+
+  while (count > 0) {
+    size_t copied = std::min(count, kBlockSamples - block.size());
+    block.insert(block.end(), samples, samples + copied);
+    samples += copied;
+    count -= copied;
+
+    if (block.size() == kBlockSamples) {
+      flush_block();
+    }
+  }
+}
+
+void WavWriter::flush_block() {
+  writer->push(std::move(block));
+  block = std::vector<int16_t>();
+  block.reserve(kBlockSamples);
+}
+
+bool WavWriter::write_block(std::vector<int16_t>& samples) {
+  bytes.clear();
+  for (int16_t sample : samples) {
+    put_le(bytes, static_cast<uint16_t>(sample), 2);
+  }
+  file.write(bytes.data(), bytes.size());
+  return !file.fail();
+}
+
+void WavWriter::close() {
+  if (!writer) {
+    return;
+  }
+
+  if (!block.empty()) {
+    flush_block();
+  }
+
+  bool written = writer->close();
+  writer.reset();
+
+  write_header(samples_written);
+  file.close();
+
+  if (!written || !file) {
+    throw "Could not write WAV file.";
+  }
+}
+
+uint64_t WavWriter::get_samples_written() { return samples_written; }
@@ -0,0 +1,51 @@
+//
+//  WavWriter.h
+//  Emulator
+//
+//  Writes mono 16-bit PCM to a WAV file. Samples are gathered into large
+//  blocks, and a background thread writes each full block, so the caller
+//  never waits on the disk unless it outruns it by several blocks.
+//
+
+#ifndef __Emulator__WavWriter__
+#define __Emulator__WavWriter__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BackgroundWriter.h"
+
+class WavWriter {
+ private:
+  std::ofstream file;
+  int sample_rate;
+  uint64_t samples_written;
+
+  std::vector<int16_t> block;  // Being filled by the caller
+  std::vector<char> bytes;     // The writer's little-endian copy of a block
+
+  std::unique_ptr<BackgroundWriter<std::vector<int16_t>>> writer;
+
+  bool write_block(std::vector<int16_t>& samples);
+  void write_header(uint64_t samples);
+  void flush_block();
+
+ public:
+  // Throws if the file can't be created
+  WavWriter(std::string filename, int sample_rate);
+  ~WavWriter();
+
+  void write(const int16_t* samples, size_t count);
+
+  // Waits for every block to be written and completes the header. Throws if
+  // any write failed.
+  void close();
+
+  uint64_t get_samples_written();
+};
+
+#endif /* defined(__Emulator__WavWriter__) */
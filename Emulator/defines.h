@@ -11,11 +11,19 @@
 
 #include <cstdint>
 
-const int kFPS = 60;
 const int kScreenWidth = 256;
 const int kScreenHeight = 240;
 
 typedef uint8_t byte;
 typedef uint16_t dbyte;
 
+// How the PPU's four logical name tables map onto physical VRAM
+enum Mirroring {
+  kMirroringHorizontal,
+  kMirroringVertical,
+  kMirroringSingleScreenLow,
+  kMirroringSingleScreenHigh,
+  kMirroringFourScreen,
+};
+
 #endif  // Emulator_defines_h
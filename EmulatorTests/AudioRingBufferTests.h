@@ -0,0 +1,10 @@
+//
+//  AudioRingBufferTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface AudioRingBufferTests : XCTestCase
+
+@end
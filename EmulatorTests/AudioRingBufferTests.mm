@@ -0,0 +1,88 @@
+//
+//  AudioRingBufferTests.mm
+//  EmulatorTests
+//
+
+#import "AudioRingBufferTests.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "AudioRingBuffer.h"
+
+@implementation AudioRingBufferTests
+
+- (void)testCapacityRoundsUpToPowerOfTwo {
+  XCTAssertEqual(AudioRingBuffer(1).capacity(), 1u);
+  XCTAssertEqual(AudioRingBuffer(1000).capacity(), 1024u);
+  XCTAssertEqual(AudioRingBuffer(1024).capacity(), 1024u);
+}
+
+- (void)testDropsWritesThatDontFit {
+  AudioRingBuffer buffer(8);
+  int16_t samples[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+  XCTAssertEqual(buffer.write(samples, 10), 8u);
+  XCTAssertEqual(buffer.size(), 8u);
+  XCTAssertEqual(buffer.write(samples, 1), 0u);
+
+  int16_t output[10] = {};
+  XCTAssertEqual(buffer.read(output, 10), 8u);
+  for (int i = 0; i < 8; i++) {
+    XCTAssertEqual(output[i], i);
+  }
+  XCTAssertEqual(buffer.read(output, 1), 0u);
+  XCTAssertEqual(buffer.size(), 0u);
+}
+
+- (void)testWrapsAroundTheEnd {
+  AudioRingBuffer buffer(8);
+  int16_t samples[6] = {10, 11, 12, 13, 14, 15};
+  int16_t output[6] = {};
+
+  // Move the indices to 5 so the next write is split in two copies
+  buffer.write(samples, 5);
+  buffer.read(output, 5);
+
+  XCTAssertEqual(buffer.write(samples, 6), 6u);
+  XCTAssertEqual(buffer.read(output, 6), 6u);
+  for (int i = 0; i < 6; i++) {
+    XCTAssertEqual(output[i], samples[i]);
+  }
+}
+
+// One producer and one consumer thread; every sample arrives once, in order
+- (void)testConcurrentProducerAndConsumer {
+  const int kSamples = 1 << 20;
+  AudioRingBuffer buffer(512);
+
+  std::thread producer([&]() {
+    int16_t chunk[100];
+    int next = 0;
+    while (next < kSamples) {
+      int count = std::min(100, kSamples - next);
+      for (int i = 0; i < count; i++) {
+        chunk[i] = static_cast<int16_t>(next + i);
+      }
+      next += buffer.write(chunk, count);
+    }
+  });
+
+  std::vector<int16_t> received;
+  received.reserve(kSamples);
+  int16_t chunk[64];
+  while (received.size() < static_cast<size_t>(kSamples)) {
+    size_t count = buffer.read(chunk, 64);
+    received.insert(received.end(), chunk, chunk + count);
+  }
+  producer.join();
+
+  int mismatches = 0;
+  for (int i = 0; i < kSamples; i++) {
+    mismatches += received[i] != static_cast<int16_t>(i);
+  }
+  XCTAssertEqual(mismatches, 0);
+}
+
+@end
@@ -0,0 +1,10 @@
+//
+//  CheatTableTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface CheatTableTests : XCTestCase
+
+@end
@@ -0,0 +1,106 @@
+//
+//  CheatTableTests.mm
+//  EmulatorTests
+//
+//  Game Genie decoding (examples from the nesdev wiki), raw patches, and
+//  the processor applying both kinds of cheat.
+//
+
+#import "CheatTableTests.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "CheatTable.h"
+#include "ControllerPad.h"
+#include "PPU.h"
+#include "Processor.h"
+
+static NSString* ParseError(const std::string& code) {
+  try {
+    CheatTable::parse(code);
+  } catch (const char* error) {
+    return @(error);
+  }
+  return @"";
+}
+
+@implementation CheatTableTests
+
+- (void)testSixLetterGameGenie {
+  Cheat cheat = CheatTable::parse("GOSSIP");
+  XCTAssertEqual(cheat.address, 0xD1DD);
+  XCTAssertEqual(cheat.value, 0x14);
+  XCTAssertEqual(cheat.compare, -1);
+  XCTAssertTrue(cheat.enabled);
+
+  // Letters are case-insensitive
+  XCTAssertEqual(CheatTable::parse("gossip").address, 0xD1DD);
+}
+
+- (void)testEightLetterGameGenie {
+  Cheat cheat = CheatTable::parse("ZEXPYGLA");
+  XCTAssertEqual(cheat.address, 0x94A7);
+  XCTAssertEqual(cheat.value, 0x02);
+  XCTAssertEqual(cheat.compare, 0x03);
+}
+
+- (void)testRawPatches {
+  Cheat ram = CheatTable::parse("0075:09");
+  XCTAssertEqual(ram.address, 0x0075);
+  XCTAssertEqual(ram.value, 0x09);
+  XCTAssertEqual(ram.compare, -1);
+
+  Cheat compared = CheatTable::parse("d1dd?14:EA");
+  XCTAssertEqual(compared.address, 0xD1DD);
+  XCTAssertEqual(compared.value, 0xEA);
+  XCTAssertEqual(compared.compare, 0x14);
+  XCTAssertEqualObjects(@(compared.code.c_str()), @"d1dd?14:EA");
+}
+
+- (void)testRejectsMalformedCodes {
+  for (const char* code : {"", "GOSSI", "GOSSIPP", "GOSSIB", "G0SSIP",
+                           "12345:00", "0075:100", "0075:", ":09",
+                           "0075?:09", "0075?100:09", "00x5:09"}) {
+    XCTAssertEqualObjects(ParseError(code), @"Invalid cheat code.", @"%s",
+                          code);
+  }
+}
+
+- (void)testProcessorAppliesCheats {
+  // LDA $9000; STA $0200; JMP $8006, reset vector $8000
+  std::vector<byte> prg(0x8000, 0);
+  const byte program[] = {0xAD, 0x00, 0x90, 0x8D, 0x00, 0x02,
+                          0x4C, 0x06, 0x80};
+  std::copy(program, program + sizeof(program), prg.begin());
+  prg[0x1000] = 0x77;
+  prg[0x7FFD] = 0x80;
+
+  PPU ppu(true);
+  ControllerPad pad;
+  Processor processor(&ppu, &pad);
+  processor.map_prg_rom(0x8000, prg.size(), prg.data());
+
+  CheatTable cheats;
+  cheats.add("9000?66:11");  // The ROM doesn't hold $66, so this is skipped
+  cheats.add("9000?77:5A");
+  cheats.add("0300:42");
+  processor.set_rom_cheats(cheats.get_cheats());
+
+  processor.power_on();
+  processor.apply_ram_cheats(cheats.get_cheats());
+  processor.run(100, nullptr);
+  XCTAssertEqual(processor.get_cpu_ram()[0x200], 0x5A);
+  XCTAssertEqual(processor.get_cpu_ram()[0x300], 0x42);
+  XCTAssertEqual(prg[0x1000], 0x77);  // The ROM itself is untouched
+
+  // Disabled cheats stop applying
+  cheats.set_enabled(1, false);
+  processor.set_rom_cheats(cheats.get_cheats());
+  processor.power_on();
+  processor.run(100, nullptr);
+  XCTAssertEqual(processor.get_cpu_ram()[0x200], 0x77);
+}
+
+@end
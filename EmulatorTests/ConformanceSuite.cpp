@@ -0,0 +1,304 @@
+//
+//  ConformanceSuite.cpp
+//  EmulatorTests
+//
+//  Manifest lines are tab separated:
+//
+//    <rom> <tab> nestest <tab> <log> [<tab> nocycles]
+//    <rom> <tab> blargg [<tab> <max frames>]
+//
+//  nestest logs are compared up to the first unofficial opcode (marked with
+//  '*'), which this CPU doesn't implement.
+//
+
+#include "ConformanceSuite.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "CpuTrace.h"
+#include "Emulator.h"
+#include "Processor.h"
+
+static const long kDefaultMaxFrames = 60 * 60;
+
+// blargg ROMs hold reset for this many frames when they ask for one
+static const int kResetDelayFrames = 10;
+
+static const byte kBlarggRunning = 0x80;
+static const byte kBlarggNeedsReset = 0x81;
+
+static std::vector<std::string> split_tabs(const std::string& line) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string field;
+
+  while (std::getline(stream, field, '\t')) {
+    if (!field.empty()) {
+      fields.push_back(field);
+    }
+  }
+
+  return fields;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Parses "<name>:<value>" from a nestest log line
+static bool log_field(const std::string& line, const char* name, int base,
+                      uint64_t* value) {
+  size_t position = line.find(name);
+  if (position == std::string::npos) {
+    return false;
+  }
+
+  *value = strtoull(line.c_str() + position + strlen(name), nullptr, base);
+  return true;
+}
+
+static bool parse_log_line(const std::string& line, CpuTraceRecord* record) {
+  uint64_t a, x, y, p, s, cycle = 0;
+  if (line.size() < 8 || !log_field(line, " A:", 16, &a) ||
+      !log_field(line, " X:", 16, &x) || !log_field(line, " Y:", 16, &y) ||
+      !log_field(line, " P:", 16, &p) || !log_field(line, " SP:", 16, &s)) {
+    return false;
+  }
+  log_field(line, "CYC:", 10, &cycle);
+
+  *record = CpuTraceRecord();
+  record->pc = std::stoul(line.substr(0, 4), nullptr, 16);
+  record->opcode = std::stoul(line.substr(6, 2), nullptr, 16);
+  record->a = a;
+  record->x = x;
+  record->y = y;
+  record->p = p;
+  record->s = s;
+  record->cycle = cycle;
+  return true;
+}
+
+static std::string describe(const CpuTraceRecord& record) {
+  char text[64];
+  snprintf(text, sizeof(text),
+           "%04X %02X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64,
+           record.pc, record.opcode, record.a, record.x, record.y, record.p,
+           record.s, record.cycle);
+  return text;
+}
+
+static std::string directory_of(const std::string& path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+ConformanceSuite::ConformanceSuite(std::string manifest_path,
+                                   std::string rom_directory)
+    : manifest_directory(directory_of(manifest_path)),
+      rom_directory(rom_directory) {
+  std::ifstream manifest(manifest_path);
+
+  if (!manifest.is_open()) {
+    throw "Could not open conformance manifest.";
+  }
+
+  std::string line;
+  while (std::getline(manifest, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::vector<std::string> fields = split_tabs(line);
+    bool bundled =
+        !fields.empty() &&
+        std::ifstream(manifest_directory + "/" + fields[0]).is_open();
+    if (fields.size() >= 3 && fields[1] == "nestest") {
+      cases.push_back({fields[0], kConformanceNestest, fields[2],
+                       !(fields.size() > 3 && fields[3] == "nocycles"), 0,
+                       bundled});
+    } else if (fields.size() >= 2 && fields[1] == "blargg") {
+      cases.push_back({fields[0], kConformanceBlargg, "", false,
+                       fields.size() > 2 ? std::stol(fields[2])
+                                         : kDefaultMaxFrames,
+                       bundled});
+    } else {
+      throw "Malformed conformance manifest line.";
+    }
+  }
+}
+
+std::string ConformanceSuite::case_directory(
+    const ConformanceCase& test_case) {
+  return test_case.bundled ? manifest_directory : rom_directory;
+}
+
+const std::vector<ConformanceCase>& ConformanceSuite::get_cases() {
+  return cases;
+}
+
+ConformanceResult ConformanceSuite::run(const ConformanceCase& test_case) {
+  try {
+    return test_case.kind == kConformanceNestest ? run_nestest(test_case)
+                                                 : run_blargg(test_case);
+  } catch (const char* error) {
+    ConformanceResult result = {false, -1, "", "", 0, 0, 0, ""};
+    result.message = test_case.rom + ": " + error;
+    return result;
+  }
+}
+
+ConformanceResult ConformanceSuite::run_nestest(
+    const ConformanceCase& test_case) {
+  ConformanceResult result = {false, -1, "", "", 0, 0, 0, ""};
+
+  std::ifstream log(case_directory(test_case) + "/" + test_case.log);
+  if (!log.is_open()) {
+    result.message = "Missing nestest log " + test_case.log;
+    return result;
+  }
+
+  // Parse the log up front so the timed loop only runs the CPU
+  std::vector<CpuTraceRecord> expected;
+  std::string line;
+  while (std::getline(log, line)) {
+    CpuTraceRecord record;
+    if (line.size() > 15 && line[15] == '*') {
+      break;  // Unofficial opcodes from here on
+    }
+    if (!parse_log_line(line, &record)) {
+      result.message = "Malformed nestest log line " +
+                       std::to_string(expected.size() + 1);
+      return result;
+    }
+    expected.push_back(record);
+  }
+
+  Emulator emulator(true);
+  emulator.load_rom(case_directory(test_case) + "/" + test_case.rom);
+
+  // Automation mode starts at $C000 in the state the log's first line shows
+  Processor& cpu = *emulator.processor;
+  if (!expected.empty()) {
+    cpu.pc = 0xC000;
+    cpu.p = expected[0].p;
+    cpu.s = expected[0].s;
+    cpu.cycle_count = expected[0].cycle;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < expected.size(); i++) {
+    CpuTraceRecord actual = cpu.trace_record();
+    const CpuTraceRecord& reference = expected[i];
+
+    bool matches = actual.pc == reference.pc &&
+                   actual.opcode == reference.opcode &&
+                   actual.a == reference.a && actual.x == reference.x &&
+                   actual.y == reference.y && actual.p == reference.p &&
+                   actual.s == reference.s &&
+                   (!test_case.compare_cycles ||
+                    actual.cycle == reference.cycle);
+
+    std::string error;
+    if (matches) {
+      try {
+        cpu.execute();
+      } catch (const char* message) {
+        error = message;
+      }
+    }
+
+    if (!matches || !error.empty()) {
+      result.seconds = seconds_since(start);
+      result.cycles = cpu.cycle_count;
+      result.first_divergence = i + 1;
+      result.expected = describe(reference);
+      result.actual = matches ? error : describe(actual);
+      result.message = test_case.rom + ": diverges from " + test_case.log +
+                       " at line " + std::to_string(i + 1);
+      return result;
+    }
+
+    result.instructions++;
+  }
+  result.seconds = seconds_since(start);
+  result.cycles = cpu.cycle_count;
+
+  // nestest leaves the number of the first failed official test at $02
+  byte error_code = cpu.peek_memory(0x0002);
+  if (error_code) {
+    char message[64];
+    snprintf(message, sizeof(message), ": nestest reported error $%02X",
+             error_code);
+    result.message = test_case.rom + message;
+    return result;
+  }
+
+  result.passed = true;
+  result.message = test_case.rom + ": " +
+                   std::to_string(result.instructions) +
+                   " instructions match " + test_case.log;
+  return result;
+}
+
+ConformanceResult ConformanceSuite::run_blargg(
+    const ConformanceCase& test_case) {
+  ConformanceResult result = {false, -1, "", "", 0, 0, 0, ""};
+
+  Emulator emulator(true);
+  emulator.load_rom(case_directory(test_case) + "/" + test_case.rom);
+  Processor& cpu = *emulator.processor;
+
+  auto start = std::chrono::steady_clock::now();
+  int reset_countdown = -1;
+  byte status = kBlarggRunning;
+
+  for (long frame = 0; frame < test_case.max_frames; frame++) {
+    emulator.emulate_frame();
+
+    // Results are only valid once the signature is written
+    if (cpu.peek_memory(0x6001) != 0xDE || cpu.peek_memory(0x6002) != 0xB0 ||
+        cpu.peek_memory(0x6003) != 0x61) {
+      continue;
+    }
+
+    status = cpu.peek_memory(0x6000);
+    if (status == kBlarggNeedsReset && reset_countdown < 0) {
+      reset_countdown = kResetDelayFrames;
+    } else if (reset_countdown > 0 && --reset_countdown == 0) {
+      cpu.reset();
+      reset_countdown = -1;
+    } else if (status < kBlarggRunning) {
+      break;
+    }
+  }
+  result.seconds = seconds_since(start);
+  result.cycles = cpu.cycle_count;
+
+  std::string text;
+  for (dbyte address = 0x6004; address < 0x7000; address++) {
+    byte c = cpu.peek_memory(address);
+    if (!c) {
+      break;
+    }
+    text += static_cast<char>(c);
+  }
+
+  if (status >= kBlarggRunning) {
+    result.message = test_case.rom + ": didn't finish in " +
+                     std::to_string(test_case.max_frames) + " frames";
+  } else {
+    result.passed = status == 0;
+    result.message = test_case.rom + ": result " + std::to_string(status);
+  }
+  if (!text.empty()) {
+    result.message += "\n" + text;
+  }
+
+  return result;
+}
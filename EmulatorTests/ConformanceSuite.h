@@ -0,0 +1,59 @@
+//
+//  ConformanceSuite.h
+//  EmulatorTests
+//
+//  Runs CPU and PPU test ROMs headlessly. nestest runs in its automation
+//  mode from $C000 and every instruction is compared against the reference
+//  log; blargg-style ROMs run until they report a result in SRAM at $6000.
+//
+
+#ifndef __EmulatorTests__ConformanceSuite__
+#define __EmulatorTests__ConformanceSuite__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum ConformanceKind { kConformanceNestest, kConformanceBlargg };
+
+struct ConformanceCase {
+  std::string rom;  // Relative to the manifest if checked in there,
+                    // otherwise to the ROM directory
+  ConformanceKind kind;
+  std::string log;      // nestest: the reference log, next to the ROM
+  bool compare_cycles;  // nestest
+  long max_frames;      // blargg
+  bool bundled;         // The ROM is checked in next to the manifest
+};
+
+struct ConformanceResult {
+  bool passed;
+  long first_divergence;  // The log line (from 1), or -1
+  std::string expected;
+  std::string actual;
+  uint64_t instructions;  // nestest; blargg ROMs report CPU cycles instead
+  uint64_t cycles;
+  double seconds;
+  std::string message;
+};
+
+class ConformanceSuite {
+ private:
+  std::string manifest_directory;
+  std::string rom_directory;
+  std::vector<ConformanceCase> cases;
+
+  std::string case_directory(const ConformanceCase& test_case);
+
+  ConformanceResult run_nestest(const ConformanceCase& test_case);
+  ConformanceResult run_blargg(const ConformanceCase& test_case);
+
+ public:
+  // rom_directory may be empty, in which case only bundled cases can run
+  ConformanceSuite(std::string manifest_path, std::string rom_directory);
+
+  const std::vector<ConformanceCase>& get_cases();
+  ConformanceResult run(const ConformanceCase& test_case);
+};
+
+#endif /* defined(__EmulatorTests__ConformanceSuite__) */
@@ -1,29 +0,0 @@
-//
-//  EmulatorTests.m
-//  EmulatorTests
-//
-//  Created by Tyler Kieft on 9/29/12.
-//
-//
-
-#import "EmulatorTests.h"
-
-@implementation EmulatorTests
-
-- (void)setUp {
-  [super setUp];
-
-  // Set-up code here.
-}
-
-- (void)tearDown {
-  // Tear-down code here.
-
-  [super tearDown];
-}
-
-- (void)testExample {
-  XCTFail(@"Unit tests are not implemented yet in EmulatorTests");
-}
-
-@end
@@ -0,0 +1,115 @@
+//
+//  EmulatorTests.mm
+//  EmulatorTests
+//
+//  Created by Tyler Kieft on 9/29/12.
+//
+//
+
+#import "EmulatorTests.h"
+
+#include <cinttypes>
+#include <cstdlib>
+#include <string>
+
+#include "ConformanceSuite.h"
+#include "FrameHashSuite.h"
+#include "TestHelpers.h"
+
+@implementation EmulatorTests
+
+- (void)setUp {
+  [super setUp];
+
+  // Set-up code here.
+}
+
+- (void)tearDown {
+  // Tear-down code here.
+
+  [super tearDown];
+}
+
+// Replays every ROM + movie pair in FrameHashes/manifest.txt and checks each
+// frame's hash against its golden file. Cases whose ROMs aren't checked in
+// only run when EMULATOR_TEST_ROMS is set.
+- (void)testFrameHashes {
+  const char* rom_directory = getenv("EMULATOR_TEST_ROMS");
+  bool update_golden = getenv("EMULATOR_UPDATE_GOLDEN") != nullptr;
+  NSString* manifest = [TestsDirectory()
+      stringByAppendingPathComponent:@"FrameHashes/manifest.txt"];
+
+  FrameHashSuite suite(manifest.UTF8String,
+                       rom_directory ? rom_directory : "");
+  int cases_run = 0;
+
+  for (const FrameHashCase& test_case : suite.get_cases()) {
+    if (!test_case.bundled && !rom_directory) {
+      NSLog(@"%s: skipped, set EMULATOR_TEST_ROMS to run it",
+            test_case.rom.c_str());
+      continue;
+    }
+
+    cases_run++;
+    NSDate* start = [NSDate date];
+    FrameHashResult result = suite.run(test_case, update_golden);
+    NSTimeInterval elapsed = -[start timeIntervalSinceNow];
+
+    if (result.first_diverging_frame >= 0) {
+      XCTFail(@"%s (expected %016" PRIx64 ", got %016" PRIx64 ")",
+              result.message.c_str(), result.expected_hash,
+              result.actual_hash);
+    } else {
+      XCTAssertTrue(result.passed, @"%s", result.message.c_str());
+    }
+
+    NSLog(@"%s: %zu frames in %.2fs", test_case.rom.c_str(), result.frames,
+          elapsed);
+  }
+
+  XCTAssertGreaterThan(cases_run, 0, @"No frame hash cases ran");
+}
+
+// Runs the CPU test ROMs in Conformance/manifest.txt. nestest failures
+// report the first log line that differs. Cases whose ROMs aren't checked in
+// only run when EMULATOR_TEST_ROMS is set.
+- (void)testConformance {
+  const char* rom_directory = getenv("EMULATOR_TEST_ROMS");
+  NSString* manifest = [TestsDirectory()
+      stringByAppendingPathComponent:@"Conformance/manifest.txt"];
+
+  ConformanceSuite suite(manifest.UTF8String,
+                         rom_directory ? rom_directory : "");
+  int cases_run = 0;
+
+  for (const ConformanceCase& test_case : suite.get_cases()) {
+    if (!test_case.bundled && !rom_directory) {
+      NSLog(@"%s: skipped, set EMULATOR_TEST_ROMS to run it",
+            test_case.rom.c_str());
+      continue;
+    }
+
+    cases_run++;
+    ConformanceResult result = suite.run(test_case);
+
+    if (result.first_divergence >= 0) {
+      XCTFail(@"%s\nexpected: %s\nactual:   %s", result.message.c_str(),
+              result.expected.c_str(), result.actual.c_str());
+    } else {
+      XCTAssertTrue(result.passed, @"%s", result.message.c_str());
+    }
+
+    if (test_case.kind == kConformanceNestest) {
+      NSLog(@"%s: %" PRIu64 " instructions in %.3fs (%.0f instructions/s)",
+            test_case.rom.c_str(), result.instructions, result.seconds,
+            result.seconds > 0 ? result.instructions / result.seconds : 0);
+    } else {
+      NSLog(@"%s: %" PRIu64 " cycles in %.2fs", test_case.rom.c_str(),
+            result.cycles, result.seconds);
+    }
+  }
+
+  XCTAssertGreaterThan(cases_run, 0, @"No conformance cases ran");
+}
+
+@end
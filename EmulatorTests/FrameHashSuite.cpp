@@ -0,0 +1,178 @@
+//
+//  FrameHashSuite.cpp
+//  EmulatorTests
+//
+//  Manifest lines are tab separated (ROM names often contain spaces):
+//
+//    <rom> <tab> <movie> <tab> <golden> [<tab> ram]
+//
+//  Golden files hold one 16 digit hex hash per frame.
+//
+
+#include "FrameHashSuite.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "Emulator.h"
+#include "InputMovie.h"
+
+static std::string directory_of(const std::string& path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+static std::vector<std::string> split_tabs(const std::string& line) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string field;
+
+  while (std::getline(stream, field, '\t')) {
+    if (!field.empty()) {
+      fields.push_back(field);
+    }
+  }
+
+  return fields;
+}
+
+FrameHashSuite::FrameHashSuite(std::string manifest_path,
+                               std::string rom_directory)
+    : manifest_directory(directory_of(manifest_path)),
+      rom_directory(rom_directory) {
+  std::ifstream manifest(manifest_path);
+
+  if (!manifest.is_open()) {
+    throw "Could not open frame hash manifest.";
+  }
+
+  std::string line;
+  while (std::getline(manifest, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::vector<std::string> fields = split_tabs(line);
+    if (fields.size() < 3) {
+      throw "Malformed frame hash manifest line.";
+    }
+
+    bool bundled =
+        std::ifstream(manifest_directory + "/" + fields[0]).is_open();
+    cases.push_back({fields[0], fields[1], fields[2],
+                     fields.size() > 3 && fields[3] == "ram", bundled});
+  }
+}
+
+const std::vector<FrameHashCase>& FrameHashSuite::get_cases() { return cases; }
+
+std::string FrameHashSuite::rom_path(const FrameHashCase& test_case) {
+  return (test_case.bundled ? manifest_directory : rom_directory) + "/" +
+         test_case.rom;
+}
+
+std::vector<uint64_t> FrameHashSuite::run_movie(
+    const FrameHashCase& test_case) {
+  std::string movie_path = manifest_directory + "/" + test_case.movie;
+  size_t frame_count = InputMovie(movie_path).frame_count();
+
+  Emulator emulator(true);
+  emulator.load_rom(rom_path(test_case));
+  emulator.start_playback(movie_path);
+
+  std::vector<uint64_t> hashes;
+  hashes.reserve(frame_count);
+
+  for (size_t frame = 0; frame < frame_count; frame++) {
+    emulator.emulate_frame();
+    hashes.push_back(emulator.frame_hash(test_case.include_cpu_ram));
+  }
+
+  return hashes;
+}
+
+FrameHashResult FrameHashSuite::run(const FrameHashCase& test_case,
+                                    bool update_golden) {
+  FrameHashResult result = {false, -1, 0, 0, 0, ""};
+  std::string golden_path = manifest_directory + "/" + test_case.golden;
+  std::vector<uint64_t> hashes;
+
+  try {
+    hashes = run_movie(test_case);
+  } catch (const char* error) {
+    result.message = test_case.rom + ": " + error;
+    return result;
+  }
+
+  result.frames = hashes.size();
+
+  if (update_golden) {
+    std::ofstream golden(golden_path, std::ios::out | std::ios::trunc);
+    char line[24];
+
+    for (uint64_t hash : hashes) {
+      snprintf(line, sizeof(line), "%016" PRIx64 "\n", hash);
+      golden << line;
+    }
+
+    result.passed = golden.good();
+    result.message = result.passed ? "Golden file updated."
+                                   : "Could not write golden file.";
+    return result;
+  }
+
+  std::ifstream golden(golden_path);
+  if (!golden.is_open()) {
+    result.message = "Missing golden file " + golden_path;
+    return result;
+  }
+
+  std::vector<uint64_t> expected_hashes;
+  std::string line;
+  while (std::getline(golden, line)) {
+    uint64_t hash = 0;
+    size_t parsed = 0;
+    try {
+      hash = std::stoull(line, &parsed, 16);
+    } catch (const std::exception&) {
+      parsed = 0;
+    }
+
+    if (parsed == 0 || parsed != line.size()) {
+      result.message = test_case.golden + ": line " +
+                       std::to_string(expected_hashes.size() + 1) +
+                       " is not a hash: \"" + line + "\"";
+      return result;
+    }
+    expected_hashes.push_back(hash);
+  }
+
+  size_t frames = std::min(expected_hashes.size(), hashes.size());
+  for (size_t frame = 0; frame < frames; frame++) {
+    uint64_t expected = expected_hashes[frame];
+
+    if (expected != hashes[frame]) {
+      result.first_diverging_frame = frame;
+      result.expected_hash = expected;
+      result.actual_hash = hashes[frame];
+      result.message = test_case.rom + ": frame " + std::to_string(frame) +
+                       " differs from " + test_case.golden;
+      return result;
+    }
+  }
+
+  if (expected_hashes.size() != hashes.size()) {
+    result.message = test_case.rom + ": " + test_case.golden + " has " +
+                     std::to_string(expected_hashes.size()) +
+                     " hashes but the movie ran " +
+                     std::to_string(hashes.size()) + " frames";
+    return result;
+  }
+
+  result.passed = true;
+  return result;
+}
@@ -0,0 +1,55 @@
+//
+//  FrameHashSuite.h
+//  EmulatorTests
+//
+//  Replays ROM + movie pairs headlessly and compares the hash of every
+//  frame against a golden file, so that changes to the CPU or renderer can
+//  be checked for bit-exact output.
+//
+
+#ifndef __EmulatorTests__FrameHashSuite__
+#define __EmulatorTests__FrameHashSuite__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FrameHashCase {
+  std::string rom;     // Relative to the manifest if checked in there,
+                       // otherwise to the ROM directory
+  std::string movie;   // Relative to the manifest
+  std::string golden;  // Relative to the manifest
+  bool include_cpu_ram;
+  bool bundled;  // The ROM is checked in next to the manifest
+};
+
+struct FrameHashResult {
+  bool passed;
+  long first_diverging_frame;  // -1 unless a frame's hash differed
+  uint64_t expected_hash;
+  uint64_t actual_hash;
+  size_t frames;
+  std::string message;
+};
+
+class FrameHashSuite {
+ private:
+  std::string manifest_directory;
+  std::string rom_directory;
+  std::vector<FrameHashCase> cases;
+
+  std::string rom_path(const FrameHashCase& test_case);
+  std::vector<uint64_t> run_movie(const FrameHashCase& test_case);
+
+ public:
+  // rom_directory may be empty, in which case only bundled cases can run
+  FrameHashSuite(std::string manifest_path, std::string rom_directory);
+
+  const std::vector<FrameHashCase>& get_cases();
+
+  // Runs one case. If update_golden is set, the golden file is rewritten from
+  // the current build instead of being compared.
+  FrameHashResult run(const FrameHashCase& test_case, bool update_golden);
+};
+
+#endif /* defined(__EmulatorTests__FrameHashSuite__) */
@@ -0,0 +1,10 @@
+//
+//  InputEventQueueTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface InputEventQueueTests : XCTestCase
+
+@end
@@ -0,0 +1,129 @@
+//
+//  InputEventQueueTests.mm
+//  EmulatorTests
+//
+//  The queue itself, and ControllerPad applying it when the game strobes
+//  the controller.
+//
+
+#import "InputEventQueueTests.h"
+
+#include <thread>
+
+#include "ControllerPad.h"
+#include "InputEventQueue.h"
+
+static const byte kButtonA = 0x01;
+static const byte kButtonStart = 0x08;
+
+@implementation InputEventQueueTests
+
+- (void)testPopsInOrderUpToTime {
+  InputEventQueue queue;
+  queue.push({100, 0, kButtonA, true});
+  queue.push({200, 0, kButtonA, false});
+
+  InputEvent event;
+  XCTAssertFalse(queue.pop(99, event));
+  XCTAssertTrue(queue.pop(150, event));
+  XCTAssertEqual(event.time, 100u);
+  XCTAssertTrue(event.pressed);
+
+  // Later events wait until their time has come
+  XCTAssertFalse(queue.pop(150, event));
+  XCTAssertTrue(queue.pop(200, event));
+  XCTAssertFalse(event.pressed);
+  XCTAssertFalse(queue.pop(UINT64_MAX, event));
+}
+
+- (void)testDropsEventsWhenFull {
+  InputEventQueue queue;
+  int pushed = 0;
+  for (int i = 0; i < 300; i++) {
+    pushed += queue.push({static_cast<uint64_t>(i), 0, kButtonA, true});
+  }
+
+  XCTAssertEqual(pushed, 256);
+  XCTAssertEqual(queue.dropped.load(), 300u - 256);
+
+  // Room frees up as events are popped
+  InputEvent event;
+  XCTAssertTrue(queue.pop(UINT64_MAX, event));
+  XCTAssertEqual(event.time, 0u);
+  XCTAssertTrue(queue.push({300, 0, kButtonA, true}));
+}
+
+// One producer and one consumer thread; no event is lost or reordered
+- (void)testConcurrentProducerAndConsumer {
+  const uint64_t kEvents = 200000;
+  InputEventQueue queue;
+
+  std::thread producer([&]() {
+    for (uint64_t i = 0; i < kEvents;) {
+      i += queue.push({i, static_cast<int>(i & 1), kButtonA, true});
+    }
+  });
+
+  uint64_t expected = 0;
+  uint64_t out_of_order = 0;
+  InputEvent event;
+  while (expected < kEvents) {
+    if (queue.pop(UINT64_MAX, event)) {
+      out_of_order += event.time != expected ||
+                      event.controller != static_cast<int>(expected & 1);
+      expected++;
+    }
+  }
+  producer.join();
+
+  XCTAssertEqual(out_of_order, 0u);
+}
+
+// Events that have happened are applied as the strobe falls, before the
+// game reads the buttons
+- (void)testControllerStrobeDrainsQueue {
+  InputEventQueue queue;
+  ControllerPad pad;
+  pad.set_input_queue(&queue);
+  pad.set_sub_frame_input(true);
+
+  uint64_t now = InputEventQueue::now();
+  queue.push({now, 0, kButtonA, true});
+  queue.push({now, 1, kButtonStart, true});
+  queue.push({now + 3600000000000ULL, 0, kButtonStart, true});  // An hour
+
+  pad.write_value(0x01);
+  pad.write_value(0x00);
+
+  XCTAssertEqual(pad.get_controller_1_buttons(), kButtonA);
+  XCTAssertEqual(pad.get_controller_2_buttons(), kButtonStart);
+  XCTAssertEqual(pad.read_controller_1_state(), 0x01);  // A
+  XCTAssertEqual(pad.read_controller_1_state(), 0x00);  // B
+  XCTAssertEqual(pad.get_input_latency().events, 2u);
+}
+
+// A single-threaded app pushes from the poll callback in the middle of a
+// frame
+- (void)testPollCallbackRunsBeforeDrain {
+  InputEventQueue queue;
+  ControllerPad pad;
+  pad.set_input_queue(&queue);
+
+  int polls = 0;
+  queue.set_poll_callback([&]() {
+    polls++;
+    queue.push({InputEventQueue::now(), 0, kButtonA, true});
+  });
+
+  pad.drain_input_events(true);
+  XCTAssertEqual(polls, 1);
+  XCTAssertEqual(pad.get_controller_1_buttons(), kButtonA);
+
+  // Draining without applying discards the events
+  pad.set_controller_1_buttons(0);
+  pad.drain_input_events(false);
+  XCTAssertEqual(polls, 2);
+  XCTAssertEqual(pad.get_controller_1_buttons(), 0);
+}
+
+@end
@@ -0,0 +1,10 @@
+//
+//  InputMovieTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface InputMovieTests : XCTestCase
+
+@end
@@ -0,0 +1,138 @@
+//
+//  InputMovieTests.mm
+//  EmulatorTests
+//
+//  The movie file format and the save-state version check that guards the
+//  snapshots movies embed.
+//
+
+#import "InputMovieTests.h"
+
+#include <string>
+#include <vector>
+
+#include "Emulator.h"
+#include "InputMovie.h"
+#include "SaveState.h"
+#include "TestHelpers.h"
+
+// The message a movie file fails to load with, or "" if it loads
+static NSString* LoadError(const std::string& path) {
+  try {
+    InputMovie movie(path);
+  } catch (const char* error) {
+    return @(error);
+  }
+  return @"";
+}
+
+@implementation InputMovieTests
+
+- (void)testRoundTripFromPowerOn {
+  std::string path = TemporaryPath(@"power_on.nmv");
+  InputMovie recorded;
+  recorded.record_frame(0x01);
+  recorded.record_frame(0x80);
+  recorded.record_frame(0x00);
+  recorded.save(path);
+
+  InputMovie movie(path);
+  XCTAssertFalse(movie.starts_from_snapshot());
+  XCTAssertEqual(movie.frame_count(), 3u);
+  XCTAssertEqual(movie.next_frame(), 0x01);
+  XCTAssertEqual(movie.next_frame(), 0x80);
+  XCTAssertEqual(movie.next_frame(), 0x00);
+  XCTAssertFalse(movie.has_next_frame());
+
+  movie.rewind();
+  XCTAssertTrue(movie.has_next_frame());
+  XCTAssertEqual(movie.next_frame(), 0x01);
+}
+
+- (void)testRoundTripFromSnapshot {
+  std::string path = TemporaryPath(@"snapshot.nmv");
+  std::vector<byte> snapshot = {kStateVersion, 0x12, 0x34, 0x56};
+  InputMovie recorded(snapshot);
+  recorded.record_frame(0x08);
+  recorded.save(path);
+
+  InputMovie movie(path);
+  XCTAssertTrue(movie.starts_from_snapshot());
+  XCTAssertTrue(movie.get_snapshot() == snapshot);
+  XCTAssertEqual(movie.frame_count(), 1u);
+  XCTAssertEqual(movie.next_frame(), 0x08);
+}
+
+- (void)testRejectsMalformedFiles {
+  std::string path = TemporaryPath(@"malformed.nmv");
+  InputMovie recorded;
+  recorded.record_frame(0x01);
+  recorded.record_frame(0x02);
+  recorded.save(path);
+  std::vector<byte> data = ReadFile(path);
+
+  std::vector<byte> bad_magic = data;
+  bad_magic[0] = 'X';
+  WriteFile(path, bad_magic);
+  XCTAssertEqualObjects(LoadError(path), @"This is not a valid movie file!");
+
+  WriteFile(path, std::vector<byte>(data.begin(), data.begin() + 10));
+  XCTAssertEqualObjects(LoadError(path), @"This is not a valid movie file!");
+
+  WriteFile(path, std::vector<byte>(data.begin(), data.end() - 1));
+  XCTAssertEqualObjects(LoadError(path), @"Movie file is truncated.");
+
+  // A corrupt frame count is caught before anything is allocated for it
+  std::vector<byte> huge_count = data;
+  huge_count[11] = 0xFF;
+  WriteFile(path, huge_count);
+  XCTAssertEqualObjects(LoadError(path), @"Movie file is truncated.");
+
+  std::vector<byte> future = data;
+  future[4] = 99;
+  WriteFile(path, future);
+  XCTAssertEqualObjects(LoadError(path), @"Unsupported movie version.");
+}
+
+// Version 1 movies predate the save-state version, so only those without a
+// snapshot can be trusted
+- (void)testVersion1Movies {
+  std::string path = TemporaryPath(@"version1.nmv");
+  InputMovie power_on;
+  power_on.record_frame(0x01);
+  power_on.save(path);
+  std::vector<byte> data = ReadFile(path);
+  data[4] = 1;
+  WriteFile(path, data);
+  XCTAssertEqualObjects(LoadError(path), @"");
+
+  InputMovie from_snapshot(std::vector<byte>{kStateVersion});
+  from_snapshot.save(path);
+  data = ReadFile(path);
+  data[4] = 1;
+  WriteFile(path, data);
+  XCTAssertEqualObjects(LoadError(path), @"Unsupported movie version.");
+}
+
+- (void)testRejectsStaleSaveStates {
+  NSString* rom = [TestsDirectory()
+      stringByAppendingPathComponent:@"FrameHashes/hash_test.nes"];
+  Emulator emulator(true);
+  emulator.load_rom(rom.UTF8String);
+  emulator.emulate_frame();
+
+  std::vector<byte> state = emulator.save_state();
+  XCTAssertEqual(state[0], kStateVersion);
+  XCTAssertNoThrow(emulator.load_state(state));
+
+  state[0]--;
+  NSString* error = @"";
+  try {
+    emulator.load_state(state);
+  } catch (const char* message) {
+    error = @(message);
+  }
+  XCTAssertEqualObjects(error, @"Save state is from an incompatible version.");
+}
+
+@end
@@ -0,0 +1,10 @@
+//
+//  NetplayTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface NetplayTests : XCTestCase
+
+@end
@@ -0,0 +1,229 @@
+//
+//  NetplayTests.mm
+//  EmulatorTests
+//
+//  Rollback sessions joined by a LoopbackNetwork, playing a generated ROM
+//  whose RAM records both controllers every frame, so any input that ends up
+//  on the wrong frame changes the final hash.
+//
+
+#import "NetplayTests.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Emulator.h"
+#include "NetplayTransport.h"
+#include "RollbackSession.h"
+#include "TestHelpers.h"
+
+static const double kFrameMilliseconds = 1000.0 / 60;
+
+// On each NMI: read both controllers into $10 and $11, fold them into
+// running sums at $12 and $13, and log them at $0200,X and $0300,X where X
+// counts frames
+static const byte kInputProgram[] = {
+    0x78, 0xD8, 0xA2, 0xFF, 0x9A,  // $8000 SEI; CLD; LDX #$FF; TXS
+    0xA9, 0x80, 0x8D, 0x00, 0x20,  // $8005 LDA #$80; STA $2000
+    0x4C, 0x0A, 0x80,              // $800A JMP $800A
+    0xA9, 0x01, 0x8D, 0x16, 0x40,  // $800D LDA #$01; STA $4016
+    0xA9, 0x00, 0x8D, 0x16, 0x40,  // $8012 LDA #$00; STA $4016
+    0xA2, 0x08,                    // $8017 LDX #$08
+    0xAD, 0x16, 0x40, 0x4A,        // $8019 LDA $4016; LSR A
+    0x26, 0x10,                    // $801D ROL $10
+    0xAD, 0x17, 0x40, 0x4A,        // $801F LDA $4017; LSR A
+    0x26, 0x11,                    // $8023 ROL $11
+    0xCA, 0xD0, 0xF1,              // $8025 DEX; BNE $8019
+    0xA5, 0x12, 0x0A, 0x65, 0x10,  // $8028 LDA $12; ASL A; ADC $10
+    0x85, 0x12,                    // $802D STA $12
+    0xA5, 0x13, 0x0A, 0x65, 0x11,  // $802F LDA $13; ASL A; ADC $11
+    0x85, 0x13,                    // $8034 STA $13
+    0xE6, 0x14, 0xA6, 0x14,        // $8036 INC $14; LDX $14
+    0xA5, 0x10, 0x9D, 0x00, 0x02,  // $803A LDA $10; STA $0200,X
+    0xA5, 0x11, 0x9D, 0x00, 0x03,  // $803F LDA $11; STA $0300,X
+    0x40,                          // $8044 RTI
+};
+static const dbyte kNMIHandler = 0x800D;
+
+static std::string WriteInputRom() {
+  std::vector<byte> rom = {'N', 'E', 'S', 0x1A, 1, 1};
+  rom.resize(16 + 0x4000 + 0x2000);
+
+  byte* prg = &rom[16];
+  std::copy(kInputProgram, kInputProgram + sizeof(kInputProgram), prg);
+  prg[0x3FFA] = kNMIHandler & 0xFF;
+  prg[0x3FFB] = kNMIHandler >> 8;
+  prg[0x3FFD] = 0x80;  // Reset at $8000
+  prg[0x3FFF] = 0x80;  // IRQ
+
+  std::string path = TemporaryPath(@"netplay_input.nes");
+  WriteFile(path, rom);
+  return path;
+}
+
+// Buttons held for a few frames at a time, as in NetplayHarness
+static std::vector<byte> RandomInputs(size_t frames, unsigned seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<int> buttons(0, 255), hold(1, 20);
+  std::vector<byte> inputs;
+  while (inputs.size() < frames) {
+    inputs.insert(inputs.end(), hold(random), buttons(random));
+  }
+  inputs.resize(frames);
+  return inputs;
+}
+
+// What the sessions should end up with: each player's input lands
+// `input_delay` frames after it was given
+static uint64_t OfflineHash(const std::string& rom,
+                            const std::vector<byte> (&inputs)[2],
+                            int input_delay) {
+  Emulator emulator(true);
+  emulator.load_rom(rom);
+  for (size_t frame = 0; frame < inputs[0].size(); frame++) {
+    bool delayed = frame < static_cast<size_t>(input_delay);
+    emulator.set_controller_buttons(
+        delayed ? 0 : inputs[0][frame - input_delay],
+        delayed ? 0 : inputs[1][frame - input_delay]);
+    emulator.emulate_frame();
+  }
+  return emulator.frame_hash(true);
+}
+
+struct NetplayRun {
+  bool finished;  // Every frame was confirmed on both peers
+  uint64_t hashes[2];
+  NetplayStats stats[2];
+};
+
+// Plays both peers to the end over `network`, ticking it once per frame as
+// NetplayHarness does
+static NetplayRun PlaySessions(const std::string& rom,
+                               const std::vector<byte> (&inputs)[2],
+                               LoopbackNetwork& network, int input_delay) {
+  uint32_t frames = static_cast<uint32_t>(inputs[0].size());
+  Emulator first(true), second(true);
+  Emulator* emulators[2] = {&first, &second};
+  std::unique_ptr<RollbackSession> sessions[2];
+  for (int player = 0; player < 2; player++) {
+    emulators[player]->load_rom(rom);
+    sessions[player] = std::make_unique<RollbackSession>(
+        emulators[player], network.get_endpoint(player), player, input_delay);
+  }
+
+  NetplayRun run = {};
+  for (long ticks = 0; ticks < 100 * static_cast<long>(frames); ticks++) {
+    if (sessions[0]->get_confirmed_frame() >= frames &&
+        sessions[1]->get_confirmed_frame() >= frames) {
+      run.finished = true;
+      break;
+    }
+
+    network.set_time(ticks * kFrameMilliseconds);
+    for (int player = 0; player < 2; player++) {
+      RollbackSession* session = sessions[player].get();
+      if (session->get_frame() < frames) {
+        session->advance_frame(inputs[player][session->get_frame()]);
+      } else {
+        session->poll();
+      }
+    }
+  }
+
+  for (int player = 0; player < 2; player++) {
+    run.hashes[player] = emulators[player]->frame_hash(true);
+    run.stats[player] = sessions[player]->get_stats();
+  }
+  return run;
+}
+
+@implementation NetplayTests {
+  std::string rom;
+}
+
+- (void)setUp {
+  [super setUp];
+  rom = WriteInputRom();
+}
+
+- (void)tearDown {
+  ::unlink(rom.c_str());
+  [super tearDown];
+}
+
+// The loopback sync check from NetplayHarness, with latency, jitter and
+// loss. Both peers must end in the state an offline run reaches.
+- (void)testLoopbackSessionsStayInSync {
+  std::vector<byte> inputs[2] = {RandomInputs(600, 1), RandomInputs(600, 2)};
+  LoopbackNetwork network(50, 10, 0.05, 1);
+
+  NetplayRun run = PlaySessions(rom, inputs, network, 2);
+  uint64_t expected = OfflineHash(rom, inputs, 2);
+
+  XCTAssertTrue(run.finished);
+  XCTAssertEqual(run.hashes[0], expected);
+  XCTAssertEqual(run.hashes[1], expected);
+  XCTAssertGreaterThan(network.get_lost(), 0u);
+
+  // 50 ms is three frames, more than the input delay hides
+  for (int player = 0; player < 2; player++) {
+    XCTAssertEqual(run.stats[player].frames, 600u);
+    XCTAssertGreaterThan(run.stats[player].rollbacks, 0u);
+    XCTAssertLessThanOrEqual(run.stats[player].max_rollback_depth, 8);
+  }
+
+  // The ROM really does depend on the input
+  std::vector<byte> idle[2] = {std::vector<byte>(600),
+                               std::vector<byte>(600)};
+  XCTAssertNotEqual(OfflineHash(rom, idle, 2), expected);
+}
+
+// Remote input is predicted to repeat, so a player who never changes their
+// buttons never causes the other peer to roll back
+- (void)testCorrectPredictionsDontRollBack {
+  std::vector<byte> inputs[2] = {RandomInputs(300, 3),
+                                 std::vector<byte>(300, 0)};
+  LoopbackNetwork network(50, 0, 0, 1);
+
+  NetplayRun run = PlaySessions(rom, inputs, network, 1);
+
+  XCTAssertTrue(run.finished);
+  XCTAssertEqual(run.hashes[0], run.hashes[1]);
+  XCTAssertEqual(run.hashes[0], OfflineHash(rom, inputs, 1));
+  XCTAssertEqual(run.stats[0].rollbacks, 0u);
+  XCTAssertGreaterThan(run.stats[1].rollbacks, 0u);
+}
+
+// A peer runs at most eight frames past the remote input it has, then
+// waits, and catches up once the remote player's input arrives
+- (void)testStallsWithoutRemoteInput {
+  LoopbackNetwork network(0, 0, 0, 1);
+  Emulator first(true), second(true);
+  first.load_rom(rom);
+  second.load_rom(rom);
+  RollbackSession local(&first, network.get_endpoint(0), 0, 2);
+  RollbackSession remote(&second, network.get_endpoint(1), 1, 2);
+
+  int advanced = 0;
+  for (int tick = 0; tick < 20; tick++) {
+    advanced += local.advance_frame(0x01);
+  }
+  XCTAssertEqual(advanced, 2 + 8);  // The delay frames plus the prediction
+  XCTAssertEqual(local.get_stats().stalled_frames, 10u);
+  XCTAssertEqual(local.get_confirmed_frame(), 2u);
+
+  for (int tick = 0; tick < 10; tick++) {
+    remote.advance_frame(0x02);
+  }
+  // The remote inputs now reach frame 12, past the frame local runs next
+  XCTAssertTrue(local.advance_frame(0x01));
+  XCTAssertEqual(local.get_frame(), 11u);
+  XCTAssertEqual(local.get_confirmed_frame(), 11u);
+}
+
+@end
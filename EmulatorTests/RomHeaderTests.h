@@ -0,0 +1,10 @@
+//
+//  RomHeaderTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface RomHeaderTests : XCTestCase
+
+@end
@@ -0,0 +1,154 @@
+//
+//  RomHeaderTests.mm
+//  EmulatorTests
+//
+//  iNES and NES 2.0 header parsing, and the checksums ROMs are identified by.
+//
+
+#import "RomHeaderTests.h"
+
+#include <string>
+
+#include "Checksums.h"
+#include "RomHeader.h"
+
+static const byte* Bytes(const char* text) {
+  return reinterpret_cast<const byte*>(text);
+}
+
+@implementation RomHeaderTests
+
+- (void)testINES {
+  // 2 x 16 KB PRG, 1 x 8 KB CHR, mapper $13, vertical mirroring, battery
+  byte data[RomHeader::kSize] = {'N', 'E', 'S', 0x1A, 2, 1, 0x33, 0x10};
+  RomHeader header(data);
+
+  XCTAssertEqual(header.format, kFormatINES);
+  XCTAssertEqual(header.mapper, 0x13);
+  XCTAssertEqual(header.prg_rom_size, 0x8000u);
+  XCTAssertEqual(header.chr_rom_size, 0x2000u);
+  XCTAssertEqual(header.prg_ram_size, 0x2000u);  // 0 means 8 KB
+  XCTAssertEqual(header.chr_ram_size, 0u);
+  XCTAssertEqual(header.mirroring, kMirroringVertical);
+  XCTAssertTrue(header.battery);
+  XCTAssertFalse(header.trainer);
+  XCTAssertEqual(header.timing, kTimingNTSC);
+  XCTAssertEqual(header.rom_size(), 16u + 0x8000 + 0x2000);
+}
+
+- (void)testINESTrainerAndCHRRAM {
+  byte data[RomHeader::kSize] = {'N', 'E', 'S', 0x1A, 1, 0, 0x0C, 0, 2, 1};
+  RomHeader header(data);
+
+  XCTAssertTrue(header.trainer);
+  XCTAssertEqual(header.mirroring, kMirroringFourScreen);
+  XCTAssertEqual(header.chr_rom_size, 0u);
+  XCTAssertEqual(header.chr_ram_size, 0x2000u);
+  XCTAssertEqual(header.prg_ram_size, 0x4000u);
+  XCTAssertEqual(header.timing, kTimingPAL);
+  XCTAssertEqual(header.rom_size(), 16u + 512 + 0x4000);
+}
+
+// Dumps with junk in bytes 12-15 only have a trustworthy low mapper nibble
+- (void)testArchaicINES {
+  byte data[RomHeader::kSize] = {'N', 'E', 'S', 0x1A, 1, 1, 0x40, 0x20,
+                                 0,   0,   0,   0,    'D', 'u', 'd', 'e'};
+  RomHeader header(data);
+
+  XCTAssertEqual(header.format, kFormatArchaicINES);
+  XCTAssertEqual(header.mapper, 4);
+  XCTAssertEqual(header.console_type, kConsoleNES);
+}
+
+- (void)testNES20 {
+  byte data[RomHeader::kSize] = {
+      'N', 'E', 'S', 0x1A,
+      4,     // PRG ROM pages, low byte
+      0x10,  // CHR ROM pages, low byte
+      0x41,  // Mapper bits 0-3, vertical mirroring
+      0x28,  // Mapper bits 4-7, NES 2.0
+      0x21,  // Submapper 2, mapper bits 8-11
+      0x10,  // CHR ROM pages, high nibble
+      0x70,  // No PRG RAM, 8 KB PRG NVRAM
+      0x07,  // 8 KB CHR RAM
+      0x03,  // Dendy
+      0,
+      0x01,  // One miscellaneous ROM
+      0x2A,  // Expansion device
+  };
+  RomHeader header(data);
+
+  XCTAssertEqual(header.format, kFormatNES20);
+  XCTAssertEqual(header.mapper, 0x124);
+  XCTAssertEqual(header.submapper, 2);
+  XCTAssertEqual(header.prg_rom_size, 4u * 0x4000);
+  XCTAssertEqual(header.chr_rom_size, 0x110u * 0x2000);
+  XCTAssertEqual(header.prg_ram_size, 0u);
+  XCTAssertEqual(header.prg_nvram_size, 0x2000u);
+  XCTAssertEqual(header.chr_ram_size, 0x2000u);
+  XCTAssertEqual(header.chr_nvram_size, 0u);
+  XCTAssertEqual(header.timing, kTimingDendy);
+  XCTAssertEqual(header.misc_roms, 1);
+  XCTAssertEqual(header.expansion_device, 0x2A);
+}
+
+// A high nibble of $F gives sizes as 2^E * (MM * 2 + 1) bytes
+- (void)testNES20ExponentSizes {
+  byte data[RomHeader::kSize] = {'N', 'E', 'S', 0x1A, (13 << 2) | 1,
+                                 (10 << 2), 0, 0x08, 0, 0xFF};
+  RomHeader header(data);
+
+  XCTAssertEqual(header.prg_rom_size, 3u * 8192);
+  XCTAssertEqual(header.chr_rom_size, 1024u);
+}
+
+// 2^63 + 2^63 + 16 would wrap to 16 and match a header-only file
+- (void)testNES20HugeSizesDontWrap {
+  byte data[RomHeader::kSize] = {'N',  'E', 'S',  0x1A, 0xFC,
+                                 0xFC, 0,   0x08, 0,    0xFF};
+  RomHeader header(data);
+
+  XCTAssertEqual(header.prg_rom_size, UINT64_MAX);
+  XCTAssertEqual(header.chr_rom_size, UINT64_MAX);
+  XCTAssertEqual(header.rom_size(), UINT64_MAX);
+}
+
+- (void)testRejectsBadMagic {
+  byte data[RomHeader::kSize] = {'N', 'E', 'Z', 0x1A, 1, 1};
+  NSString* error = @"";
+  try {
+    RomHeader header(data);
+  } catch (const char* message) {
+    error = @(message);
+  }
+  XCTAssertEqualObjects(error, @"This is not a valid NES ROM!");
+}
+
+- (void)testCRC32 {
+  XCTAssertEqual(crc32(Bytes(""), 0), 0u);
+  XCTAssertEqual(crc32(Bytes("123456789"), 9), 0xCBF43926u);
+
+  // Continuing across buffers gives the same result
+  XCTAssertEqual(crc32(Bytes("6789"), 4, crc32(Bytes("12345"), 5)),
+                 0xCBF43926u);
+}
+
+- (void)testSHA1 {
+  XCTAssertEqualObjects(@(to_hex(sha1(Bytes(""), 0)).c_str()),
+                        @"da39a3ee5e6b4b0d3255bfef95601890afd80709");
+  XCTAssertEqualObjects(@(to_hex(sha1(Bytes("abc"), 3)).c_str()),
+                        @"a9993e364706816aba3e25717850c26c9cd0d89d");
+
+  // Two blocks once the padding is added
+  const char* two_blocks =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  XCTAssertEqualObjects(@(to_hex(sha1(Bytes(two_blocks), 56)).c_str()),
+                        @"84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+
+  std::string million(1000000, 'a');
+  XCTAssertEqualObjects(
+      @(to_hex(sha1(Bytes(million.data()), million.size())).c_str()),
+      @"34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
+
+@end
@@ -0,0 +1,10 @@
+//
+//  RomLibraryTests.h
+//  EmulatorTests
+//
+
+#import <XCTest/XCTest.h>
+
+@interface RomLibraryTests : XCTestCase
+
+@end
@@ -0,0 +1,171 @@
+//
+//  RomLibraryTests.mm
+//  EmulatorTests
+//
+//  Scans a directory of generated ROMs and round trips the index through
+//  its file format.
+//
+
+#import "RomLibraryTests.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Checksums.h"
+#include "RomLibrary.h"
+#include "TestHelpers.h"
+
+// An NROM image whose PRG ROM is filled with `fill`, so every ROM hashes
+// differently
+static std::vector<byte> MakeRom(byte fill) {
+  std::vector<byte> rom = {'N', 'E', 'S', 0x1A, 1, 1};
+  rom.resize(RomHeader::kSize);
+  rom.resize(RomHeader::kSize + 0x4000, fill);
+  rom.resize(RomHeader::kSize + 0x4000 + 0x2000, 0);
+  return rom;
+}
+
+@implementation RomLibraryTests {
+  std::string directory;
+}
+
+- (void)setUp {
+  [super setUp];
+
+  std::string path = TemporaryPath(@"RomLibraryTests.XXXXXX");
+  XCTAssertTrue(::mkdtemp(&path[0]) != nullptr);
+  directory = path;
+
+  ::mkdir((directory + "/sub").c_str(), 0755);
+  WriteFile(directory + "/a.nes", MakeRom(0x01));
+  WriteFile(directory + "/sub/b.NES", MakeRom(0x02));
+  WriteFile(directory + "/sub/c.nes", MakeRom(0x02));  // Same data as b
+  WriteFile(directory + "/broken.nes", {'N', 'O', 'P', 'E'});
+  WriteFile(directory + "/readme.txt", {'h', 'i'});
+}
+
+- (void)tearDown {
+  for (const char* name : {"/a.nes", "/sub/b.NES", "/sub/c.nes",
+                           "/broken.nes", "/readme.txt", "/index"}) {
+    ::unlink((directory + name).c_str());
+  }
+  ::rmdir((directory + "/sub").c_str());
+  ::rmdir(directory.c_str());
+
+  [super tearDown];
+}
+
+- (void)testScan {
+  RomLibrary library;
+  RomScanStats stats = library.scan({directory}, 2);
+
+  XCTAssertEqual(stats.files, 4u);
+  XCTAssertEqual(stats.hashed, 4u);
+  XCTAssertEqual(stats.invalid, 1u);
+  XCTAssertEqual(stats.removed, 0u);
+  XCTAssertEqual(library.get_entries().size(), 4u);
+
+  const RomLibraryEntry* a = library.find_by_path(directory + "/a.nes");
+  XCTAssertTrue(a && a->valid);
+  if (a) {
+    std::vector<byte> prg(0x4000 + 0x2000, 0);
+    std::fill(prg.begin(), prg.begin() + 0x4000, 0x01);
+    XCTAssertEqual(a->crc32, crc32(prg.data(), prg.size()));
+    XCTAssertTrue(a->sha1 == sha1(prg.data(), prg.size()));
+    XCTAssertEqual(a->get_header().prg_rom_size, 0x4000u);
+  }
+
+  const RomLibraryEntry* broken =
+      library.find_by_path(directory + "/broken.nes");
+  XCTAssertTrue(broken && !broken->valid);
+
+  const RomLibraryEntry* b = library.find_by_path(directory + "/sub/b.NES");
+  XCTAssertTrue(b != nullptr);
+  if (b) {
+    XCTAssertEqual(library.find_by_crc32(b->crc32).size(), 2u);
+    XCTAssertEqual(library.find_by_sha1(b->sha1).size(), 2u);
+  }
+  XCTAssertTrue(library.find_by_path(directory + "/readme.txt") == nullptr);
+}
+
+- (void)testRescanOnlyRereadsChangedFiles {
+  RomLibrary library;
+  library.scan({directory}, 1);
+
+  // Repeated and overlapping directories don't list files twice
+  RomScanStats stats = library.scan({directory, directory + "/sub"}, 1);
+  XCTAssertEqual(stats.files, 4u);
+  XCTAssertEqual(stats.unchanged, 4u);
+  XCTAssertEqual(stats.hashed, 0u);
+
+  std::vector<byte> grown = MakeRom(0x03);
+  grown.push_back(0);
+  WriteFile(directory + "/a.nes", grown);
+  ::unlink((directory + "/sub/c.nes").c_str());
+
+  stats = library.scan({directory}, 1);
+  XCTAssertEqual(stats.files, 3u);
+  XCTAssertEqual(stats.hashed, 1u);
+  XCTAssertEqual(stats.unchanged, 2u);
+  XCTAssertEqual(stats.removed, 1u);
+  XCTAssertEqual(library.get_entries().size(), 3u);
+}
+
+- (void)testIndexRoundTrip {
+  std::string index = directory + "/index";
+  RomLibrary library;
+  XCTAssertFalse(library.load(index));
+  library.scan({directory}, 0);
+  library.save(index);
+
+  RomLibrary loaded;
+  XCTAssertTrue(loaded.load(index));
+  const std::vector<RomLibraryEntry>& expected = library.get_entries();
+  const std::vector<RomLibraryEntry>& actual = loaded.get_entries();
+  XCTAssertEqual(actual.size(), expected.size());
+
+  for (size_t i = 0; i < actual.size() && i < expected.size(); i++) {
+    XCTAssertEqualObjects(@(actual[i].path.c_str()),
+                          @(expected[i].path.c_str()));
+    XCTAssertEqual(actual[i].file_size, expected[i].file_size);
+    XCTAssertEqual(actual[i].modified_time, expected[i].modified_time);
+    XCTAssertEqual(actual[i].valid, expected[i].valid);
+    XCTAssertEqual(actual[i].crc32, expected[i].crc32);
+    XCTAssertTrue(actual[i].sha1 == expected[i].sha1);
+    XCTAssertEqual(::memcmp(actual[i].header, expected[i].header,
+                          RomHeader::kSize),
+                   0);
+  }
+
+  // Loading the index means nothing has to be hashed again
+  XCTAssertEqual(loaded.scan({directory}, 1).hashed, 0u);
+}
+
+- (void)testRejectsCorruptIndex {
+  std::string index = directory + "/index";
+  RomLibrary library;
+  library.scan({directory}, 1);
+  library.save(index);
+
+  // Drop the last byte, which leaves the final entry incomplete
+  std::vector<byte> data = ReadFile(index);
+  data.pop_back();
+  WriteFile(index, data);
+
+  NSString* error = @"";
+  try {
+    RomLibrary loaded;
+    loaded.load(index);
+  } catch (const char* message) {
+    error = @(message);
+  }
+  XCTAssertEqualObjects(error, @"ROM library index is corrupt.");
+}
+
+@end
@@ -0,0 +1,30 @@
+//
+//  TestHelpers.h
+//  EmulatorTests
+//
+//  File helpers shared by the test cases.
+//
+
+#ifndef __EmulatorTests__TestHelpers__
+#define __EmulatorTests__TestHelpers__
+
+#import <Foundation/Foundation.h>
+
+#include <string>
+#include <vector>
+
+#include "defines.h"
+
+// The EmulatorTests source directory, which holds the checked-in fixtures
+NSString* TestsDirectory();
+
+// `name` inside the temporary directory
+std::string TemporaryPath(NSString* name);
+
+// The whole of `path`, or nothing if it can't be read
+std::vector<byte> ReadFile(const std::string& path);
+
+// Replaces the contents of `path` with `data`
+void WriteFile(const std::string& path, const std::vector<byte>& data);
+
+#endif /* defined(__EmulatorTests__TestHelpers__) */
@@ -0,0 +1,30 @@
+//
+//  TestHelpers.mm
+//  EmulatorTests
+//
+
+#import "TestHelpers.h"
+
+#include <fstream>
+#include <iterator>
+
+NSString* TestsDirectory() {
+  return [[NSString stringWithUTF8String:__FILE__]
+      stringByDeletingLastPathComponent];
+}
+
+std::string TemporaryPath(NSString* name) {
+  return [NSTemporaryDirectory() stringByAppendingPathComponent:name]
+      .UTF8String;
+}
+
+std::vector<byte> ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  return std::vector<byte>(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& path, const std::vector<byte>& data) {
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
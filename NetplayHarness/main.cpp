@@ -0,0 +1,164 @@
+//
+//  main.cpp
+//  NetplayHarness
+//
+//  Plays a ROM with two rollback netplay sessions joined by a simulated
+//  network, each fed its own random input, then checks that both ended in
+//  the same state. Reports how much re-simulation the network conditions
+//  caused and how fast it ran.
+//
+//  Usage: NetplayHarness [--frames <n>] [--latency <ms>] [--jitter <ms>]
+//                        [--loss <fraction>] [--input-delay <frames>]
+//                        [--seed <n>] <rom>
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Emulator.h"
+#include "NetplayTransport.h"
+#include "RollbackSession.h"
+
+static const double kFrameMilliseconds = 1000.0 / 60;
+
+// Buttons held for a few frames at a time, like a person pressing them
+static std::vector<byte> random_inputs(long frames, std::mt19937& random) {
+  std::vector<byte> inputs(frames);
+  std::uniform_int_distribution<int> buttons(0, 255), hold(1, 20);
+
+  long frame = 0;
+  while (frame < frames) {
+    byte value = buttons(random);
+    for (int i = hold(random); i > 0 && frame < frames; i--) {
+      inputs[frame++] = value;
+    }
+  }
+
+  return inputs;
+}
+
+static void print_stats(int player, const NetplayStats& stats) {
+  printf("Player %d: %llu frames, %llu rollbacks, %llu re-simulated (max "
+         "depth %d), %llu stalled ticks, %.1f re-simulated/s (max %d)\n",
+         player + 1, static_cast<unsigned long long>(stats.frames),
+         static_cast<unsigned long long>(stats.rollbacks),
+         static_cast<unsigned long long>(stats.resimulated_frames),
+         stats.max_rollback_depth,
+         static_cast<unsigned long long>(stats.stalled_frames),
+         stats.resimulated_per_second, stats.max_resimulated_per_second);
+}
+
+int main(int argc, const char* argv[]) {
+  std::string rom;
+  long frames = 3600;
+  double latency = 50, jitter = 10, loss = 0.05;
+  int input_delay = 2;
+  unsigned seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--frames") && has_value) {
+      frames = atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--latency") && has_value) {
+      latency = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--jitter") && has_value) {
+      jitter = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--loss") && has_value) {
+      loss = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--input-delay") && has_value) {
+      input_delay = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && has_value) {
+      seed = static_cast<unsigned>(atol(argv[++i]));
+    } else if (argv[i][0] == '-' || !rom.empty()) {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    } else {
+      rom = argv[i];
+    }
+  }
+
+  if (rom.empty() || frames <= 0 || loss < 0 || loss >= 1) {
+    std::cerr << "Usage: NetplayHarness [--frames <n>] [--latency <ms>] "
+                 "[--jitter <ms>] [--loss <fraction>] [--input-delay <frames>] "
+                 "[--seed <n>] <rom>"
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    std::mt19937 random(seed);
+    LoopbackNetwork network(latency, jitter, loss, seed);
+
+    Emulator first(true), second(true);
+    Emulator* emulators[2] = {&first, &second};
+    std::vector<byte> inputs[2];
+    RollbackSession* sessions[2];
+    for (int player = 0; player < 2; player++) {
+      emulators[player]->load_rom(rom);
+      inputs[player] = random_inputs(frames, random);
+      sessions[player] =
+          new RollbackSession(emulators[player], network.get_endpoint(player),
+                              player, input_delay);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long ticks = 0;
+    while (sessions[0]->get_confirmed_frame() < frames ||
+           sessions[1]->get_confirmed_frame() < frames) {
+      network.set_time(ticks++ * kFrameMilliseconds);
+
+      for (int player = 0; player < 2; player++) {
+        RollbackSession* session = sessions[player];
+        if (session->get_frame() < frames) {
+          session->advance_frame(inputs[player][session->get_frame()]);
+        } else {
+          session->poll();
+        }
+      }
+    }
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    uint64_t resimulated = 0;
+    for (int player = 0; player < 2; player++) {
+      NetplayStats stats = sessions[player]->get_stats();
+      print_stats(player, stats);
+      resimulated += stats.resimulated_frames;
+    }
+
+    uint64_t emulated = 2 * frames + resimulated;
+    printf("%llu packets sent, %llu lost; %ld ticks, %llu frames emulated in "
+           "%.2fs (%.0f frames/s)\n",
+           static_cast<unsigned long long>(network.get_sent()),
+           static_cast<unsigned long long>(network.get_lost()), ticks,
+           static_cast<unsigned long long>(emulated), elapsed,
+           elapsed > 0 ? emulated / elapsed : 0);
+
+    uint64_t hashes[2] = {first.frame_hash(true),
+                          second.frame_hash(true)};
+    for (int player = 0; player < 2; player++) {
+      delete sessions[player];
+    }
+
+    if (hashes[0] != hashes[1]) {
+      printf("Desynced: %016llx != %016llx\n",
+             static_cast<unsigned long long>(hashes[0]),
+             static_cast<unsigned long long>(hashes[1]));
+      return 1;
+    }
+
+    printf("In sync: %016llx\n", static_cast<unsigned long long>(hashes[0]));
+  } catch (const char* error) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+//
+//  main.cpp
+//  RomIndexer
+//
+//  Builds and queries a ROM library index.
+//
+//  Usage: RomIndexer --index <file> [--threads <n>] [--list]
+//                    [--crc32 <hex>] [--sha1 <hex>] [directory...]
+//
+//  Directories are scanned (incrementally, if the index already exists) and
+//  the index is saved before any queries run.
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "RomLibrary.h"
+
+static void print_entry(const RomLibraryEntry& entry) {
+  if (!entry.valid) {
+    printf("%-8s %-40s %-9s %s\n", "-", "-", "invalid", entry.path.c_str());
+    return;
+  }
+
+  RomHeader header = entry.get_header();
+  char mapper[16];
+  snprintf(mapper, sizeof(mapper), "%d.%d", header.mapper, header.submapper);
+  printf("%08" PRIx32 " %s %-9s %s\n", entry.crc32, to_hex(entry.sha1).c_str(),
+         mapper, entry.path.c_str());
+}
+
+int main(int argc, const char* argv[]) {
+  std::string index, crc32_query, sha1_query;
+  std::vector<std::string> directories;
+  int threads = 0;
+  bool list = false;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--index") && has_value) {
+      index = argv[++i];
+    } else if (!strcmp(argv[i], "--threads") && has_value) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--crc32") && has_value) {
+      crc32_query = argv[++i];
+    } else if (!strcmp(argv[i], "--sha1") && has_value) {
+      sha1_query = argv[++i];
+    } else if (!strcmp(argv[i], "--list")) {
+      list = true;
+    } else if (argv[i][0] == '-') {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    } else {
+      std::string directory = argv[i];
+      while (directory.size() > 1 && directory.back() == '/') {
+        directory.pop_back();
+      }
+      directories.push_back(directory);
+    }
+  }
+
+  if (index.empty()) {
+    std::cerr << "Usage: RomIndexer --index <file> [--threads <n>] [--list] "
+                 "[--crc32 <hex>] [--sha1 <hex>] [directory...]"
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    RomLibrary library;
+    library.load(index);
+
+    if (!directories.empty()) {
+      RomScanStats stats = library.scan(directories, threads);
+      library.save(index);
+
+      printf("%zu files: %zu hashed, %zu unchanged, %zu removed, %zu invalid "
+             "in %.2fs\n",
+             stats.files, stats.hashed, stats.unchanged, stats.removed,
+             stats.invalid, stats.seconds);
+    }
+
+    if (list) {
+      for (const RomLibraryEntry& entry : library.get_entries()) {
+        print_entry(entry);
+      }
+    }
+
+    if (!crc32_query.empty()) {
+      uint32_t crc32 =
+          static_cast<uint32_t>(strtoul(crc32_query.c_str(), nullptr, 16));
+      for (const RomLibraryEntry* entry : library.find_by_crc32(crc32)) {
+        print_entry(*entry);
+      }
+    }
+
+    if (!sha1_query.empty()) {
+      SHA1Digest sha1 = {};
+      for (size_t i = 0; i < sha1.size() && i * 2 + 1 < sha1_query.size();
+           i++) {
+        sha1[i] = static_cast<byte>(
+            strtoul(sha1_query.substr(i * 2, 2).c_str(), nullptr, 16));
+      }
+      for (const RomLibraryEntry* entry : library.find_by_sha1(sha1)) {
+        print_entry(*entry);
+      }
+    }
+  } catch (const char* error) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
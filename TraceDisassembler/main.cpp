@@ -0,0 +1,195 @@
+//
+//  main.cpp
+//  TraceDisassembler
+//
+//  Turns a binary CPU trace (see CpuTrace.h) into text in the style of the
+//  nestest log: one line per instruction with its bytes, disassembly,
+//  registers and cycle count.
+//
+//  Usage: TraceDisassembler [--thread <id>] <trace file> [<output file>]
+//
+//  Without --thread, every thread's instructions are written, a block at a
+//  time in the order they were flushed. The output goes to stdout if no
+//  output file is given.
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CpuTrace.h"
+#include "Instructions.h"
+
+static std::string disassemble(const CpuTraceRecord& record, int* length) {
+  if (!is_valid_opcode(record.opcode)) {
+    *length = 1;
+    return "???";
+  }
+
+  Instruction instruction = get_instruction(record.opcode);
+  *length = get_instruction_length(instruction.address_type);
+
+  byte low = record.operands[0];
+  unsigned absolute = record.operands[0] | record.operands[1] << 8;
+  const char* name = get_function_name(instruction.function);
+  char text[32];
+
+  switch (instruction.address_type) {
+    case Immediate:
+      snprintf(text, sizeof(text), "%s #$%02X", name, low);
+      break;
+    case ZeroPage:
+      snprintf(text, sizeof(text), "%s $%02X", name, low);
+      break;
+    case ZeroPageX:
+      snprintf(text, sizeof(text), "%s $%02X,X", name, low);
+      break;
+    case ZeroPageY:
+      snprintf(text, sizeof(text), "%s $%02X,Y", name, low);
+      break;
+    case Implied:
+      snprintf(text, sizeof(text), "%s", name);
+      break;
+    case Accumulator:
+      snprintf(text, sizeof(text), "%s A", name);
+      break;
+    case Absolute:
+      snprintf(text, sizeof(text), "%s $%04X", name, absolute);
+      break;
+    case AbsoluteX:
+      snprintf(text, sizeof(text), "%s $%04X,X", name, absolute);
+      break;
+    case AbsoluteY:
+      snprintf(text, sizeof(text), "%s $%04X,Y", name, absolute);
+      break;
+    case Indirect:
+      snprintf(text, sizeof(text), "%s ($%04X)", name, absolute);
+      break;
+    case IndirectPreX:
+      snprintf(text, sizeof(text), "%s ($%02X,X)", name, low);
+      break;
+    case IndirectPostY:
+      snprintf(text, sizeof(text), "%s ($%02X),Y", name, low);
+      break;
+    case Relative:
+      snprintf(text, sizeof(text), "%s $%04X", name,
+               (record.pc + 2 + static_cast<int8_t>(low)) & 0xFFFF);
+      break;
+  }
+
+  return text;
+}
+
+static void write_line(FILE* out, const CpuTraceRecord& record) {
+  int length;
+  std::string text = disassemble(record, &length);
+
+  char bytes[12];
+  snprintf(bytes, sizeof(bytes), "%02X", record.opcode);
+  for (int i = 1; i < length; i++) {
+    snprintf(bytes + 3 * i - 1, sizeof(bytes) - 3 * i + 1, " %02X",
+             record.operands[i - 1]);
+  }
+
+  fprintf(out,
+          "%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64
+          "\n",
+          record.pc, bytes, text.c_str(), record.a, record.x, record.y,
+          record.p, record.s, record.cycle);
+}
+
+int main(int argc, const char* argv[]) {
+  std::string input, output;
+  long thread = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--thread") && i + 1 < argc) {
+      thread = atol(argv[++i]);
+    } else if (argv[i][0] == '-' || !output.empty()) {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    } else if (input.empty()) {
+      input = argv[i];
+    } else {
+      output = argv[i];
+    }
+  }
+
+  if (input.empty()) {
+    std::cerr << "Usage: TraceDisassembler [--thread <id>] <trace file> "
+                 "[<output file>]"
+              << std::endl;
+    return 1;
+  }
+
+  FILE* in = fopen(input.c_str(), "rb");
+  if (!in) {
+    std::cerr << "Error: Could not open " << input << std::endl;
+    return 1;
+  }
+
+  char magic[sizeof(kCpuTraceMagic)];
+  uint32_t version, record_size;
+  if (fread(magic, sizeof(magic), 1, in) != 1 ||
+      fread(&version, sizeof(version), 1, in) != 1 ||
+      fread(&record_size, sizeof(record_size), 1, in) != 1 ||
+      memcmp(magic, kCpuTraceMagic, sizeof(magic)) ||
+      version != kCpuTraceVersion || record_size != sizeof(CpuTraceRecord)) {
+    std::cerr << "Error: " << input << " is not a CPU trace from this build"
+              << std::endl;
+    fclose(in);
+    return 1;
+  }
+
+  FILE* out = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (!out) {
+    std::cerr << "Error: Could not open " << output << std::endl;
+    fclose(in);
+    return 1;
+  }
+
+  // A corrupt count mustn't allocate more records than the file could hold
+  long position = ftell(in);
+  fseek(in, 0, SEEK_END);
+  long file_size = ftell(in);
+  fseek(in, position, SEEK_SET);
+
+  std::vector<CpuTraceRecord> records;
+  uint64_t lines = 0;
+  uint32_t header[2];  // Thread id and record count
+  while (fread(header, sizeof(header), 1, in) == 1) {
+    uint64_t remaining = static_cast<uint64_t>(file_size - ftell(in));
+    if (header[1] > remaining / sizeof(CpuTraceRecord)) {
+      std::cerr << "Warning: the trace is truncated" << std::endl;
+      break;
+    }
+
+    records.resize(header[1]);
+    if (fread(records.data(), sizeof(CpuTraceRecord), records.size(), in) !=
+        records.size()) {
+      std::cerr << "Warning: the trace is truncated" << std::endl;
+      break;
+    }
+
+    if (thread >= 0 && header[0] != static_cast<uint32_t>(thread)) {
+      continue;
+    }
+
+    for (const CpuTraceRecord& record : records) {
+      write_line(out, record);
+    }
+    lines += records.size();
+  }
+
+  fclose(in);
+  if (out != stdout) {
+    fclose(out);
+    std::cerr << lines << " instructions" << std::endl;
+  }
+
+  return 0;
+}